@@ -0,0 +1,41 @@
+#ifndef COLORCORRECTION_H
+#define COLORCORRECTION_H
+
+#include <stdint.h>
+#include "config.h"
+#include "LEDFrame.h"
+
+/**
+ * @brief Final pixel stage: gamma correction, per-channel balance and global brightness
+ *
+ * The three factors are folded into one 256-entry table per channel, so correcting a frame is a single pass
+ * of table lookups. Tables are only rebuilt when the brightness changes. Like the transition engine, this
+ * has no Arduino dependency and builds in the native PlatformIO environment.
+ */
+class ColorCorrection {
+public:
+  ColorCorrection();
+
+  // Rebuilds the tables for a brightness of 0-255. Returns false, without rebuilding, if it hasn't changed.
+  bool setBrightness(uint8_t value);
+  uint8_t getBrightness() const { return brightness; }
+
+  // Corrects the first count pixels in place
+  void apply(LEDFrame& frame, uint16_t count) const;
+
+  // The smallest input that gamma correction turns into at least value, for colors picked for an uncorrected strip
+  static uint8_t inverseGamma(uint8_t value);
+
+  // Corrects one color, for tests and anything drawing outside a frame
+  RgbColor apply(const RgbColor& color) const {
+    return RgbColor(tables[0][color.R], tables[1][color.G], tables[2][color.B]);
+  }
+
+private:
+  void buildTables();
+
+  uint8_t brightness = 255;
+  uint8_t tables[3][256];  // Red, green, blue
+};
+
+#endif // COLORCORRECTION_H
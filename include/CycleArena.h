@@ -0,0 +1,152 @@
+#ifndef CYCLEARENA_H
+#define CYCLEARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "PSRAMJsonAllocator.h"
+#endif
+
+/**
+ * @brief Bump allocator for memory that only lives for one update cycle
+ *
+ * Everything parsed during a poll (JSON documents, staged trains and their strings) is carved
+ * from one PSRAM block allocated at first use. Freeing individual allocations does nothing;
+ * reset() releases the whole cycle at once after the results are published, so the heaps
+ * never see the per-cycle churn that fragments them over days of uptime.
+ *
+ * If a cycle needs more than the block holds, allocations fall back to the PSRAM heap and are
+ * freed normally. Not thread safe, owned by the train update task.
+ */
+class CycleArena {
+public:
+  explicit CycleArena(size_t capacity) : capacity(capacity) {}
+
+  // fellBack, when given, is set to whether an overflow block landed in internal SRAM
+  void* allocate(size_t size, bool* fellBack = nullptr);
+  void deallocate(void* ptr);
+  void* reallocate(void* ptr, size_t newSize, bool* fellBack = nullptr);
+
+  // Size of a block returned by allocate() or reallocate()
+  size_t allocationSize(void* ptr) const;
+
+  // Copies a string into the arena, returning "" for null
+  const char* copyString(const char* str);
+
+  // Releases every allocation made since the last reset. Callers must have dropped all pointers into the arena.
+  void reset();
+
+  size_t getCapacity() const { return capacity; }
+  size_t getUsed() const { return offset; }
+  size_t getHighWater() const { return highWater; }
+  uint32_t getOverflowCount() const { return overflowCount; }
+
+private:
+  bool owns(const void* ptr) const {
+    return base != nullptr && ptr >= base && ptr < base + capacity;
+  }
+
+  uint8_t* base = nullptr;
+  size_t capacity;
+  size_t offset = 0;
+  size_t lastOffset = SIZE_MAX;  // Offset of the most recent allocation, which can be resized in place
+  size_t highWater = 0;
+  size_t liveOverflows = 0;
+  uint32_t overflowCount = 0;
+};
+
+// Host builds (the arena_replay PlatformIO environment) only need the arena itself
+#ifdef ARDUINO
+/**
+ * @brief ArduinoJson allocator backed by a CycleArena
+ *
+ * Documents using this allocator must be destroyed before the arena is reset.
+ * Allocations are counted in PSRAMJsonAllocator's statistics under the given purpose.
+ */
+class ArenaJsonAllocator : public ArduinoJson::Allocator {
+public:
+  explicit ArenaJsonAllocator(CycleArena* arena, JsonPurpose purpose = JsonPurpose::INGEST)
+    : arena(arena), purpose(purpose) {}
+
+  void* allocate(size_t size) override {
+    bool fellBack = false;
+    void* ptr = arena->allocate(size, &fellBack);
+    if (ptr != nullptr) {
+      PSRAMJsonAllocator::recordAllocate(purpose, arena->allocationSize(ptr), fellBack);
+    }
+    return ptr;
+  }
+
+  void deallocate(void* ptr) override {
+    if (ptr != nullptr) {
+      PSRAMJsonAllocator::recordDeallocate(purpose, arena->allocationSize(ptr));
+    }
+    arena->deallocate(ptr);
+  }
+
+  void* reallocate(void* ptr, size_t new_size) override {
+    size_t oldSize = ptr != nullptr ? arena->allocationSize(ptr) : 0;
+    bool fellBack = false;
+    void* newPtr = arena->reallocate(ptr, new_size, &fellBack);
+    if (newPtr != nullptr) {
+      PSRAMJsonAllocator::recordReallocate(purpose, oldSize, arena->allocationSize(newPtr), fellBack);
+    }
+    return newPtr;
+  }
+
+private:
+  CycleArena* arena;
+  JsonPurpose purpose;
+};
+#endif // ARDUINO
+
+/**
+ * @brief STL allocator backed by a CycleArena, in the style of esp32_psram::AllocatorPSRAM
+ * @tparam T Type of elements to allocate
+ *
+ * Containers using this allocator must be emptied and have released their storage (e.g. by
+ * swapping with an empty container) before the arena is reset.
+ */
+template <typename T>
+class AllocatorArena {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  explicit AllocatorArena(CycleArena* arena) noexcept : arena(arena) {}
+
+  template <typename U>
+  AllocatorArena(const AllocatorArena<U>& other) noexcept : arena(other.arena) {}
+
+  pointer allocate(size_type n) {
+    return static_cast<pointer>(arena->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(pointer p, size_type) noexcept { arena->deallocate(p); }
+
+  template <typename U>
+  struct rebind {
+    using other = AllocatorArena<U>;
+  };
+
+  template <typename U>
+  bool operator==(const AllocatorArena<U>& other) const noexcept { return arena == other.arena; }
+
+  template <typename U>
+  bool operator!=(const AllocatorArena<U>& other) const noexcept { return arena != other.arena; }
+
+  CycleArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, AllocatorArena<T>>;
+
+#endif // CYCLEARENA_H
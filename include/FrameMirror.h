@@ -0,0 +1,56 @@
+#ifndef FRAMEMIRROR_H
+#define FRAMEMIRROR_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "LEDFrame.h"
+
+// A frame as sent to the strip, with room in front for a WebSocket header so it can be sent as is
+struct MirrorBuffer {
+  uint8_t header[FRAME_MIRROR_HEADER_ROOM];
+  LEDFrame frame;
+};
+
+/**
+ * @brief The corrected frames the render task sends to the strip, shared with the loop task without copying
+ *
+ * Three buffers rotate between the render task and the loop task. The render pipeline corrects each frame
+ * straight into the buffer from beginWrite() and publish() makes it the latest. The loop task pins the latest
+ * with acquire() while it sends it to WebSocket clients, and the render task never writes the latest or the
+ * pinned buffer, so neither side waits or copies a frame. Only the buffer indexes change under the lock.
+ */
+class FrameMirror {
+public:
+  // Render task: the buffer to correct the next frame into, neither the latest nor the one being sent
+  LEDFrame& beginWrite();
+
+  // Render task: the frame from beginWrite() is on the strip, with ledCount LEDs
+  void publish(uint16_t ledCount);
+
+  // Loop task: pins the latest frame until release(), nullptr if none has been shown yet
+  MirrorBuffer* acquire(uint16_t& ledCount, uint32_t& seq);
+  void release();
+
+  // Frames published since boot, to tell clients that already have the latest one
+  uint32_t getSeq() const { return seq; }
+
+  // Set by the web server while clients are subscribed, so the render task only wakes the loop when needed
+  void setWanted(bool value) { wanted = value; }
+  bool isWanted() const { return wanted; }
+
+private:
+  MirrorBuffer buffers[3];
+  int writing = 0;    // Render task only
+  int latest = -1;    // Guarded by lock
+  int reading = -1;   // Guarded by lock
+  uint16_t latestLedCount = 0;  // Guarded by lock
+  std::atomic<uint32_t> seq{0};
+  std::atomic<bool> wanted{false};
+  portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+extern FrameMirror frameMirror;
+
+#endif // FRAMEMIRROR_H
@@ -0,0 +1,104 @@
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+#include "config.h"
+#include "LEDFrame.h"
+#include "TransitionEngine.h"
+#include "ColorCorrection.h"
+
+#ifdef ARDUINO
+#include "PerfMonitor.h"
+#include "TraceRecorder.h"
+#else
+// Host builds have no perf monitor or trace recorder
+#define PERF_SCOPE(stage) do {} while (0)
+#define TRACE_SCOPE(name) do {} while (0)
+#endif
+
+/**
+ * @brief Everything between a target frame and the LEDs: transitions, color correction and the output
+ *
+ * Output is a pixel output backend (see PixelOutput.h), fixed at compile time so the hardware path has no
+ * virtual calls. LEDRenderer runs this with the strip, and with RecordingPixelOutput the same code runs on a
+ * host, where tools/transition_profile checks and times it.
+ *
+ * Output time is the ledShow perf stage and correction is ledCorrect.
+ */
+template <typename Output>
+class FramePipeline {
+public:
+  // Arguments go to the output backend's constructor
+  template <typename... Args>
+  explicit FramePipeline(Args&&... args) : output(std::forward<Args>(args)...) {}
+
+  bool begin(uint16_t count) {
+    ledCount = count > MAX_LED_COUNT ? MAX_LED_COUNT : count;
+    transitions.setLedCount(ledCount);
+    return output.begin(ledCount);
+  }
+
+  // Starts transitions to a new target frame
+  void setTarget(const LEDFrame& target) { transitions.setTarget(target); }
+
+  bool isAnimating() const { return transitions.isAnimating(); }
+
+  // Brightness for the correction stage, 0-255. Returns true if it changed.
+  bool setBrightness(uint8_t value) { return correction.setBrightness(value); }
+  uint8_t getBrightness() const { return correction.getBrightness(); }
+
+  // Advances the transitions by elapsedMs and shows the result, unless it matches what's already on the
+  // LEDs and force is false. Returns true if a frame was shown.
+  bool render(uint32_t elapsedMs, bool force) {
+    transitions.render(elapsedMs, blendedFrame);
+    if (!force && memcmp(blendedFrame.pixels, shownFrame.pixels, ledCount * sizeof(RgbColor)) == 0) {
+      return false;
+    }
+    shownFrame = blendedFrame;
+    show(shownFrame);
+    return true;
+  }
+
+  // Corrects and shows a frame as is, skipping the transitions
+  void show(const LEDFrame& frame) {
+    *correctedFrame = frame;
+    {
+      PERF_SCOPE(PerfStage::LED_CORRECT);
+      correction.apply(*correctedFrame, ledCount);
+    }
+
+    PERF_SCOPE(PerfStage::LED_SHOW);
+    TRACE_SCOPE("ledShow");
+    output.show(*correctedFrame);
+  }
+
+  // Corrects into frame from now on rather than the pipeline's own buffer, so another task can read what's
+  // on the LEDs without a copy (see FrameMirror)
+  void setOutputBuffer(LEDFrame& frame) { correctedFrame = &frame; }
+
+  uint16_t getLedCount() const { return ledCount; }
+
+  // The last frame rendered, before correction
+  const LEDFrame& getShownFrame() const { return shownFrame; }
+
+  // The last frame sent to the output, after correction
+  const LEDFrame& getOutputFrame() const { return *correctedFrame; }
+
+  Output& getOutput() { return output; }
+
+private:
+  Output output;
+  TransitionEngine transitions;
+  ColorCorrection correction;
+  uint16_t ledCount = 0;
+
+  // Working frames are members rather than locals since a full frame is too big for the render task's stack
+  LEDFrame shownFrame;      // Before correction, to skip frames that didn't change
+  LEDFrame blendedFrame;
+  LEDFrame ownCorrectedFrame;
+  LEDFrame* correctedFrame = &ownCorrectedFrame;
+};
+
+#endif // FRAMEPIPELINE_H
@@ -0,0 +1,73 @@
+#ifndef FRESHNESSMONITOR_H
+#define FRESHNESSMONITOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+
+// Timestamps of one published snapshot as it moves from upstream to the LEDs and browsers. Times are local millis().
+struct FreshnessStamps {
+  uint32_t mergeSeq = 0;              // Vehicle table merge that published the snapshot
+  int64_t upstreamTime = 0;           // Upstream currentTime of the response (Unix ms), 0 if unknown
+  bool feedRefreshKnown = false;
+  uint32_t feedRefreshMillis = 0;     // Newest upstream vehicle update
+  uint32_t fetchCompleteMillis = 0;   // Snapshot merged into the vehicle table
+  uint32_t ledShownMillis = 0;        // LEDs updated from the snapshot, 0 until then
+  uint32_t broadcastMillis = 0;       // Snapshot sent to WebSocket clients, 0 until then
+};
+
+// Rolling data-age statistics, in milliseconds
+struct FreshnessSummary {
+  size_t samples = 0;
+  uint32_t p50Ms = 0;
+  uint32_t p95Ms = 0;
+  uint32_t maxMs = 0;
+};
+
+/**
+ * @brief Tracks how old train data is by the time it reaches the LEDs and WebSocket clients
+ *
+ * Each published snapshot is stamped as it passes through the pipeline. The age of the data
+ * at display (LED update time minus the newest upstream vehicle update) is kept in a rolling
+ * window, and a warning is logged when its p95 crosses the configured freshness target.
+ * Stamps come from both cores, so updates are short critical sections.
+ */
+class FreshnessMonitor {
+public:
+  // Called by the train update task when a merge publishes a new snapshot
+  void recordPublished(uint32_t mergeSeq, int64_t upstreamTime, bool feedRefreshKnown, uint32_t feedRefreshMillis);
+
+  // Called when the LEDs are updated from the latest snapshot
+  void recordDisplayed();
+
+  // Called when the latest snapshot is broadcast to WebSocket clients
+  void recordBroadcast();
+
+  FreshnessStamps getLatestStamps() const;
+  FreshnessSummary getDisplayAgeSummary() const;
+  FreshnessSummary getBroadcastAgeSummary() const;
+
+  // True while the p95 data age at display is above the freshness target
+  bool isTargetBreached() const { return targetBreached; }
+
+private:
+  struct AgeWindow {
+    uint32_t agesMs[FRESHNESS_WINDOW_SIZE] = {};
+    size_t count = 0;
+    size_t next = 0;
+  };
+
+  void addAge(AgeWindow& window, uint32_t ageMs);
+  FreshnessSummary summarize(const AgeWindow& window) const;
+  void checkTarget();
+
+  FreshnessStamps latest;
+  AgeWindow displayAges;
+  AgeWindow broadcastAges;
+  bool targetBreached = false;
+  mutable portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+extern FreshnessMonitor freshnessMonitor;
+
+#endif // FRESHNESSMONITOR_H
@@ -2,50 +2,92 @@
 #define LEDCONTROLLER_H
 
 #include <NeoPixelBus.h>
-#include <map>
 #include "config.h"
+#include "LEDLayout.h"
 #include "LEDTrainTracker.h"
+#include "LEDRenderer.h"
+#include "TimelapseRecorder.h"
 
 // Forward declaration
 struct TrainData;
 
-// Station LED mapping structure
-struct StationLEDMapping {
-  int northboundIndex; // LED index for northbound trains at the station
-  int northboundEnrouteIndex; // LED index for northbound trains heading to this station
-  int southboundIndex; // LED index for southbound trains at the station
-  int southboundEnrouteIndex; // LED index for southbound trains heading to this station
-};
-
 class LEDController {
 public:
   void setup();
   void startupAnimation();
-  void displayTrainPositions();
+  // Renders the latest polled positions. Returns true if the LEDs changed.
+  bool displayTrainPositions();
+
+  // Re-renders train positions aged by the time since the last poll, without logging.
+  // Returns true if the LEDs changed.
+  bool refreshPredictedPositions();
+
+  // Repaints the current train positions with the latest palette, e.g. after the line colors change
+  void refreshColors();
+
   void testStationLEDs(const String& stationName);
-  const std::map<String, StationLEDMapping>& getStationMap() const;
-  int getTrainLEDIndex(const TrainData& train) const;
 
-  // Log train counts across all four LED rows (moved here from LEDTrainTracker)
+  // Returns the LED index for a train as of its last poll, or -1 if its station isn't in the layout. Warnings
+  // about unmapped stations are only logged when logMissing is set, once per poll rather than on every tick.
+  int getTrainLEDIndex(const TrainData& train, bool logMissing) const;
+
+  // Returns the LED index for a train after dead-reckoning its offsets forward to the given time, or -1 to skip it
+  int getPredictedLEDIndex(const TrainData& train, uint32_t nowMillis, bool logMissing) const;
+
+  // Log train counts across the LED rows of the layout (moved here from LEDTrainTracker)
   void logTrainCounts() const;
 
   // Serialize current LED state to JSON string for WebSocket broadcasting
   void getLEDStateAsJson(String& output) const;
 
+  // Age of the upstream data when the LEDs were last updated, or -1 if unknown
+  int32_t getDisplayedDataAgeMs() const { return displayedDataAgeMs; }
+
+  // Replays the trains recorded over the last hours on the strip at speed times real time. Polling and
+  // recording carry on meanwhile, and the strip goes back to the live trains when playback ends or stops.
+  // Returns false if nothing has been recorded yet.
+  bool startPlayback(float hours, uint16_t speed);
+  void stopPlayback();
+  bool isPlaying() const { return playing; }
+  // Recorded time being shown, as seconds before playback started
+  uint32_t getPlaybackSecondsAgo() const;
+
+  // Shows any recorded changes that are due. Called from the loop, returns milliseconds until it's next
+  // due or UINT32_MAX when not playing.
+  uint32_t updatePlayback();
+
+  // Time to rebuild the tracker and publish it as a frame, for the last frame and as a running average
+  uint32_t getLastRenderMicros() const { return lastRenderMicros; }
+  uint32_t getAverageRenderMicros() const { return averageRenderMicros; }
+
 private:
-// Setup for WS2815 LEDs. Yes, it's using Apa106 method, but according to https://github.com/Makuna/NeoPixelBus/pull/795#issuecomment-2466545330
-// that's the one that's closest in timing and works. I've also tried the NeoEsp32Rmt0Ws2811Method and while it worked I was seeing
-// the occasional LED displayed in the wrong position.
-NeoPixelBus<NeoGrbFeature, NeoEsp32Rmt0Apa106Method> strip{LED_COUNT, LED_PIN};
-  
-  // Station to LED mappings
-  std::map<String, StationLEDMapping> stationMap;
-  
   // Train tracker for handling multiple trains at same LED
   LEDTrainTracker trainTracker;
+
+  int32_t displayedDataAgeMs = -1;
+  uint32_t lastRenderMicros = 0;
+  uint32_t averageRenderMicros = 0;
+
+  // Signature of the trains shown on each LED, used to skip redraws when predictions don't move anything
+  uint32_t displayedSignature = 0;
+
+  // Timelapse playback. Recording times are millis() when recorded.
+  bool playing = false;
+  TimelapseCursor playbackCursor;
+  uint8_t playbackMasks[MAX_LED_COUNT] = {};
+  uint32_t playbackStartMillis = 0;  // When playback started
+  uint32_t playbackFromMillis = 0;   // Recording time shown when playback started
+  uint32_t playbackShownMillis = 0;  // Recording time now being shown
+  uint16_t playbackSpeed = 1;
+
+  // Predictions are paused while a station test pattern is on the strip
+  unsigned long stationTestStartMillis = 0;
+  bool stationTestActive = false;
   
-  void initializeStationMaps();
-  void setAllLEDs(const RgbColor& color);
+  void publishTrainTracker();
+  void publishFrame(LEDFrame& frame);
+  uint32_t updateTrainTracker(bool logDetails);
+  void recordRenderTime(uint32_t startMicros);
 };
 
 extern LEDController ledController;
@@ -0,0 +1,36 @@
+#ifndef LEDFRAME_H
+#define LEDFRAME_H
+
+#include <stdint.h>
+#include "config.h"
+
+#ifdef ARDUINO
+#include <NeoPixelBus.h>
+#else
+// Host builds (the native PlatformIO environment) only need the color channels
+struct RgbColor {
+  uint8_t R, G, B;
+  RgbColor() : R(0), G(0), B(0) {}
+  RgbColor(uint8_t r, uint8_t g, uint8_t b) : R(r), G(g), B(b) {}
+  bool operator==(const RgbColor& other) const { return R == other.R && G == other.G && B == other.B; }
+  bool operator!=(const RgbColor& other) const { return !(*this == other); }
+};
+#endif
+
+// Per-LED hints for the transition engine
+#define LED_FLAG_STATION 0x01  // A station LED, trains arriving here pulse
+
+// One full set of pixel colors for the strip. Sized for the longest strip a layout can describe, LEDs past
+// the end of the actual strip stay black.
+struct LEDFrame {
+  RgbColor pixels[MAX_LED_COUNT];
+  uint8_t flags[MAX_LED_COUNT] = {};
+
+  void fill(const RgbColor& color) {
+    for (int i = 0; i < MAX_LED_COUNT; i++) {
+      pixels[i] = color;
+    }
+  }
+};
+
+#endif // LEDFRAME_H
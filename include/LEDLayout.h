@@ -0,0 +1,138 @@
+#ifndef LEDLAYOUT_H
+#define LEDLAYOUT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <map>
+#include "config.h"
+#include "MemoryPools.h"
+#include "TrainData.h"
+
+// One physical row of LEDs, walked from start to end
+struct LayoutRow {
+  String label;
+  String logPrefix;  // Label padded so the logged rows line up like the physical strip
+  int start;
+  int end;
+  bool descending;
+};
+
+// Station LED mapping structure
+struct StationLEDMapping {
+  int northboundIndex; // LED index for northbound trains at the station
+  int northboundEnrouteIndex; // LED index for northbound trains heading to this station
+  int southboundIndex; // LED index for southbound trains at the station
+  int southboundEnrouteIndex; // LED index for southbound trains heading to this station
+};
+
+struct LayoutStation {
+  String name;
+  StationLEDMapping leds;
+};
+
+// One data line of the strip, on its own RMT channel and pin
+struct LayoutOutput {
+  uint8_t pin;
+  uint16_t first;  // Where its LEDs start in the output map
+  uint16_t count;
+};
+
+// Station name to ordinal in the layout. Only used when a poll is parsed, per-frame lookups go by ordinal.
+using StationOrdinalMap = std::map<String, int, std::less<String>, HotAllocator<std::pair<const String, int>>>;
+
+/**
+ * @brief The physical LED layout, loaded from LAYOUT_FILE on LittleFS at boot
+ *
+ * The file describes the strip length, the rows, each station's four LEDs, any special-case en-route LEDs,
+ * the order each line serves its stations in and how the LEDs are wired to data pins. It's validated as a whole and compiled into dense arrays: station
+ * and en-route LEDs indexed by station ordinal, line and direction, the row and station flags of every LED,
+ * and the LED each output pixel shows, so every per-frame lookup is a single array read. Trains carry the
+ * ordinals of their stops from the poll that parsed them.
+ *
+ * If the file is missing or invalid the layout is empty, with DEFAULT_LED_COUNT LEDs and no stations, and
+ * the reason is logged. It's never modified after load(), so any task can read it without locking.
+ */
+class LEDLayout {
+public:
+  // Loads and validates the layout. Call once, after LittleFS is mounted and before the LEDs are set up.
+  bool load();
+
+  bool isLoaded() const { return loaded; }
+  uint16_t getLedCount() const { return ledCount; }
+
+  size_t getRowCount() const { return rowCount; }
+  const LayoutRow& getRow(size_t row) const { return rows[row]; }
+
+  // Which row contains the LED, or -1 if none does
+  int getRowIndex(int ledIndex) const {
+    return ledIndex >= 0 && ledIndex < ledCount ? ledRows[ledIndex] : -1;
+  }
+
+  size_t getStationCount() const { return stationCount; }
+  const LayoutStation& getStation(int ordinal) const { return stations[ordinal]; }
+
+  // Ordinal of the named station, or -1 if it isn't in the layout
+  int findStation(const char* name) const;
+
+  // LED for a train at the station, or -1 if the ordinal is -1
+  int getStationLED(int ordinal, bool northbound) const {
+    return ordinal >= 0 ? stationLEDs[ordinal][northbound ? 1 : 0] : -1;
+  }
+
+  // LED for a train heading to the station, with any en-route overrides for the line applied
+  int getEnrouteLED(int ordinal, Line line, bool northbound) const {
+    return ordinal >= 0 ? enrouteLEDs[ordinal][static_cast<int>(line) - 1][northbound ? 1 : 0] : -1;
+  }
+
+  // Ordinal of the stop after this one on the line in the direction of travel, or -1 at the end of the line or
+  // if the layout doesn't list the line's stops
+  int getFollowingStop(int ordinal, Line line, bool northbound) const {
+    return ordinal >= 0 ? followingStops[ordinal][static_cast<int>(line) - 1][northbound ? 1 : 0] : -1;
+  }
+
+  // Per-LED LED_FLAG_* hints for the transition engine, ledCount entries
+  const uint8_t* getLEDFlags() const { return ledFlags; }
+
+  // Data lines, each sent on its own RMT channel. A layout without outputs is one line on LED_PIN.
+  size_t getOutputCount() const { return outputCount; }
+  const LayoutOutput& getOutput(size_t output) const { return outputs[output]; }
+
+  // LED shown by each output pixel in wiring order, the outputs back to back
+  const uint16_t* getOutputMap() const { return outputMap; }
+
+private:
+  bool compile(JsonDocument& doc);
+  bool compileRows(JsonArrayConst source);
+  bool compileStations(JsonArrayConst source);
+  bool compileOverrides(JsonArrayConst source);
+  bool compileLines(JsonArrayConst source);
+  bool compileOutputs(JsonArrayConst source);
+  void setSingleOutput();
+  bool isValidLED(int ledIndex) const { return ledIndex >= 0 && ledIndex < ledCount; }
+  void clear();
+
+  bool loaded = false;
+  uint16_t ledCount = DEFAULT_LED_COUNT;
+
+  LayoutRow rows[MAX_LAYOUT_ROWS];
+  size_t rowCount = 0;
+
+  LayoutStation stations[MAX_LAYOUT_STATIONS];
+  size_t stationCount = 0;
+  StationOrdinalMap stationOrdinals;
+
+  // Compiled lookup tables
+  int16_t stationLEDs[MAX_LAYOUT_STATIONS][2];                     // [ordinal][northbound]
+  int16_t enrouteLEDs[MAX_LAYOUT_STATIONS][LAYOUT_LINE_COUNT][2];  // [ordinal][line - 1][northbound]
+  int16_t followingStops[MAX_LAYOUT_STATIONS][LAYOUT_LINE_COUNT][2];  // [ordinal][line - 1][northbound]
+  int8_t ledRows[MAX_LED_COUNT];
+  uint8_t ledFlags[MAX_LED_COUNT];
+
+  LayoutOutput outputs[LED_MAX_OUTPUTS];
+  size_t outputCount = 0;
+  uint16_t outputMap[MAX_LED_COUNT];
+};
+
+extern LEDLayout ledLayout;
+
+#endif // LEDLAYOUT_H
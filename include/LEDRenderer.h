@@ -0,0 +1,81 @@
+#ifndef LEDRENDERER_H
+#define LEDRENDERER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "LEDFrame.h"
+#include "FramePipeline.h"
+#include "PixelOutput.h"
+#include "PixelStreamer.h"
+
+/**
+ * @brief Owns the strip and pushes frames to it from a dedicated task at a fixed rate
+ *
+ * Producers build a complete LEDFrame and publish() it. Three published buffers rotate as in FrameMirror:
+ * publish() copies the frame into one that is neither the latest nor the one the render task is reading, and
+ * only the indexes change under the lock. On each tick the render task pins the latest buffer, copies it to
+ * its front buffer as the transition engine's next target if it differs, then shows the engine's blended
+ * frame. Show() is skipped when nothing new was published, no transition is running and the frame matches
+ * what's already on the strip. Web handling and LED output no longer wait on each other.
+ *
+ * Frames are gamma-corrected and scaled to the scheduled brightness on the way out, see ColorCorrection.
+ * The transitions, correction and output backend (LEDOutput) are a FramePipeline, which also builds on a host.
+ *
+ * Each corrected frame is written straight into a FrameMirror buffer, which the web server sends to clients
+ * mirroring the strip. After each tick the frame is handed to pixelStreamer, which mirrors it to any network
+ * stream targets.
+ *
+ * Show() time is the ledShow perf stage, and the deviation of each tick from the frame period is renderJitter.
+ */
+class LEDRenderer {
+public:
+  // Initializes a strip of ledCount LEDs, all off
+  void setup(uint16_t ledCount);
+
+  // Starts the render task. Until then, frames go straight to the strip with showImmediately().
+  void start();
+
+  // Copies a frame into a free published buffer for the next tick. Safe from any task.
+  void publish(const LEDFrame& frame);
+
+  // Blocking show for the startup animation, only valid before start()
+  void showImmediately(const LEDFrame& frame);
+
+  uint8_t getBrightness() const { return pipeline.getBrightness(); }
+
+  uint32_t getFramesShown() const { return framesShown; }
+  uint32_t getFramesSkipped() const { return framesSkipped; }
+  uint32_t getLateFrames() const { return lateFrames; }
+
+private:
+  static void renderTaskEntry(void* parameter);
+  void renderLoop();
+  void renderFrame(uint32_t elapsedMs);
+  bool updateBrightness();
+
+  TaskHandle_t renderTask = nullptr;
+
+  // Published buffers written by publish(), front buffer and pipeline only touched by the render task
+  LEDFrame publishedFrames[3];
+  LEDFrame frontFrame;
+  FramePipeline<LEDOutput> pipeline;
+  uint32_t lastBrightnessCheck = 0;
+  int latest = -1;            // Guarded by lock
+  int reading = -1;           // Guarded by lock
+  uint32_t publishedSeq = 0;  // Guarded by lock
+  uint32_t shownSeq = 0;      // Render task only
+  portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+  SemaphoreHandle_t publishMutex = nullptr;  // Producers take turns, so one published buffer is always free
+
+  std::atomic<uint32_t> framesShown{0};
+  std::atomic<uint32_t> framesSkipped{0};
+  std::atomic<uint32_t> lateFrames{0};  // Ticks that started more than a whole period late
+};
+
+extern LEDRenderer ledRenderer;
+
+#endif // LEDRENDERER_H
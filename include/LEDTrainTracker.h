@@ -5,16 +5,25 @@
 #include <vector>
 #include "config.h"
 #include "colors.h"
+#include "MemoryPools.h"
+#include "LEDRenderer.h"
 
 // Forward declaration of Line enum from TrainDataManager.h
 enum class Line;
 
+// Lines with a train at an LED
+#define LINE_MASK_1 0x01
+#define LINE_MASK_2 0x02
+
 // Structure to represent a single train at an LED position
 struct TrainAtLED {
   String vehicleId;
   Line line;
 };
 
+// Trains at one LED. Read on every frame, so it goes in the hot pool.
+using TrainsAtLED = std::vector<TrainAtLED, HotAllocator<TrainAtLED>>;
+
 // Class to track trains at each LED position
 class LEDTrainTracker {
 public:
@@ -26,16 +35,24 @@ public:
   // Reset all trains for all LEDs
   void reset();
   
-  // Display the trains on the LED strip based on current state
+  // Draw the trains into a frame based on current state
   // Yellow for both lines, line color for single line, black for no trains
-  void display(NeoPixelBus<NeoGrbFeature, NeoEsp32Rmt0Apa106Method>& strip);
+  void render(LEDFrame& frame) const;
+
+  // LINE_MASK_* bits for the lines with a train at the LED
+  uint8_t getLineMask(int ledIndex) const;
+
+  // Draws a frame from per-LED line masks the same way render() draws the trains, e.g. for timelapse playback
+  static void renderLineMasks(const uint8_t* masks, LEDFrame& frame);
 
   // Get read-only access to the trains at a specific LED
-  const std::vector<TrainAtLED>& getTrainsAtLED(int ledIndex) const;
+  const TrainsAtLED& getTrainsAtLED(int ledIndex) const;
   
 private:
-  // Array of train lists, one per LED
-  std::vector<TrainAtLED> ledTrains[LED_COUNT];
+  static RgbColor colorForMask(uint8_t mask, const LinePalette& palette);
+
+  // Array of train lists, one per LED. Only the layout's LED count are used.
+  TrainsAtLED ledTrains[MAX_LED_COUNT];
 };
 
 #endif // LEDTRAINTRACKER_H
@@ -0,0 +1,71 @@
+#ifndef LOOPEVENTS_H
+#define LOOPEVENTS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+
+// Events that wake the loop task, sent as task notification bits
+#define LOOP_EVENT_TRAIN_DATA (1UL << 0)  // The train update task published new data
+#define LOOP_EVENT_NETWORK (1UL << 1)     // A web server, WebSocket or OTA socket has something to read
+#define LOOP_EVENT_FRAME (1UL << 2)       // The render task showed a new frame and clients are mirroring the strip
+#define LOOP_EVENT_COUNT 3
+
+/**
+ * @brief The single wait the loop task blocks on between passes
+ *
+ * Other tasks set event bits on the loop task's notification value, and the loop sleeps in wait() until a bit
+ * is set or its next timed job is due. A watcher task blocks in select() on the server sockets and raises
+ * LOOP_EVENT_NETWORK when one is readable, then waits for the loop to finish reading before selecting again.
+ *
+ * Wakeups and time spent awake are counted over LOOP_STATS_WINDOW so idle CPU use can be compared, and the
+ * delay from an event being raised to the loop handling it is recorded as the loopDispatch perf stage.
+ */
+class LoopEvents {
+public:
+  // Called from the loop task. Starts the network watcher.
+  void begin();
+
+  // Raises events on the loop task, from any task
+  void signal(uint32_t events);
+
+  // Blocks the loop task until an event is raised or timeoutMs passes. Returns the events, 0 on timeout.
+  uint32_t wait(uint32_t timeoutMs);
+
+  // The loop has serviced the sockets, so the watcher can wait for the next readable one
+  void networkHandled();
+
+  // Loop task statistics over the last complete window
+  float getWakeupsPerSecond() const { return wakeupsPerSecond; }
+  float getBusyPercent() const { return busyPercent; }
+
+  // Wakeups since boot for one LOOP_EVENT_ bit, and with no event (timeouts)
+  uint32_t getEventCount(uint32_t event) const { return eventCounts[__builtin_ctz(event)]; }
+  uint32_t getTimeoutCount() const { return timeoutCount; }
+
+private:
+  static void watcherTaskEntry(void* parameter);
+  void watchNetwork();
+
+  TaskHandle_t loopTask = nullptr;
+  TaskHandle_t watcherTask = nullptr;
+
+  // Low 32 bits of esp_timer when each event was first raised since the loop last handled it, 0 if not pending
+  std::atomic<uint32_t> signalMicros[LOOP_EVENT_COUNT] = {};
+
+  // Only touched by the loop task
+  int64_t lastWakeMicros = 0;
+  int64_t windowStartMicros = 0;
+  int64_t windowBusyMicros = 0;
+  uint32_t windowWakeups = 0;
+  float wakeupsPerSecond = 0;
+  float busyPercent = 0;
+  uint32_t eventCounts[LOOP_EVENT_COUNT] = {};
+  uint32_t timeoutCount = 0;
+};
+
+extern LoopEvents loopEvents;
+
+#endif // LOOPEVENTS_H
@@ -0,0 +1,66 @@
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_log.h>
+// Only include the PSRAM components we need to avoid compilation issues with InMemoryFS
+#include "esp32-psram/VectorPSRAM.h"
+#include "esp32-psram/TypedRingBuffer.h"
+#include "config.h"
+
+// One snapshot of heap and stack usage. Sizes are in bytes.
+struct MemorySample {
+  uint32_t uptimeSeconds = 0;
+  uint32_t freeInternal = 0;
+  uint32_t minFreeInternal = 0;    // Lowest free internal heap since boot
+  uint32_t largestInternal = 0;    // Largest free internal block, shrinks as the heap fragments
+  uint32_t freePsram = 0;
+  uint32_t minFreePsram = 0;
+  uint32_t largestPsram = 0;
+  uint32_t largestDma = 0;
+  uint32_t jsonAllocations = 0;    // JSON document allocations since boot, across every purpose
+  uint32_t jsonLiveBytes = 0;      // Bytes currently held by JSON documents
+  uint32_t stackFree[MEMORY_MAX_TASKS] = {};  // Stack high-water mark of each registered task
+};
+
+/**
+ * @brief Samples heap and stack usage into a fixed-size PSRAM history
+ *
+ * A sample is taken every MEMORY_SAMPLE_INTERVAL and kept in a ring of MEMORY_HISTORY_SIZE entries,
+ * enough to show leaks and fragmentation trends over weeks of uptime. Live samples are produced
+ * more often for the WebSocket "memory" topic but aren't stored. Called from loop() only.
+ */
+class MemoryMonitor {
+public:
+  // Adds a task whose stack high-water mark is recorded in every sample
+  void registerTask(const char* name, TaskHandle_t task);
+
+  // Takes a history sample when one is due. Returns true when a live sample should be broadcast.
+  bool handle();
+
+  // Current heap and stack usage
+  MemorySample takeSample() const;
+
+  // Serializes the history as one array per field, downsampled to at most maxPoints entries
+  void getHistoryAsJson(String& output, size_t maxPoints) const;
+
+  // Serializes a fresh sample as a "memory" WebSocket message
+  void getLiveAsJson(String& output) const;
+
+private:
+  void addSampleFields(JsonObject obj, const MemorySample& sample) const;
+  static void mergeSample(MemorySample& into, const MemorySample& next);
+
+  esp32_psram::TypedRingBufferPSRAM<MemorySample> history{MEMORY_HISTORY_SIZE};
+  const char* taskNames[MEMORY_MAX_TASKS] = {};
+  TaskHandle_t tasks[MEMORY_MAX_TASKS] = {};
+  size_t taskCount = 0;
+  unsigned long lastSampleMillis = 0;
+  unsigned long lastLiveMillis = 0;
+  bool sampled = false;
+};
+
+extern MemoryMonitor memoryMonitor;
+
+#endif // MEMORYMONITOR_H
@@ -0,0 +1,93 @@
+#ifndef MEMORYPOOLS_H
+#define MEMORYPOOLS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <cstddef>
+
+// Where an allocation should live. Pick by how the data is used, not how big it is.
+enum class MemoryPool {
+  HOT_INTERNAL,  // Touched on every frame (LED tracker, station lookups). Internal SRAM, falls back to PSRAM.
+  BULK_PSRAM,    // Large or rarely touched data (JSON documents, tables). PSRAM, only small blocks fall back to internal.
+  DMA,           // Buffers handed to peripherals. DMA-capable internal SRAM, no fallback.
+  COUNT
+};
+
+// Per-pool allocation statistics
+struct MemoryPoolStats {
+  std::atomic<uint32_t> liveBytes{0};
+  std::atomic<uint32_t> peakBytes{0};
+  std::atomic<uint32_t> allocations{0};
+  std::atomic<uint32_t> fallbacks{0};  // Allocations placed outside the pool's preferred memory
+  std::atomic<uint32_t> failures{0};
+};
+
+/**
+ * @brief Placement-aware allocation layer over heap_caps
+ *
+ * Every allocation names the pool it belongs to, so placement is an explicit decision instead of
+ * whatever malloc picks. Statistics are kept per pool and are safe to update from both cores. Hot data is
+ * placed by how often it's read; the effect on render time hasn't been measured (see averageRenderTimeUs in
+ * /api/status).
+ */
+class MemoryPools {
+public:
+  // fellBack, when given, is set to whether the block landed outside the pool's preferred memory
+  static void* allocate(MemoryPool pool, size_t size, bool* fellBack = nullptr);
+  static void* reallocate(MemoryPool pool, void* ptr, size_t newSize, bool* fellBack = nullptr);
+  static void deallocate(MemoryPool pool, void* ptr);
+
+  static const MemoryPoolStats& getStats(MemoryPool pool) { return stats[static_cast<int>(pool)]; }
+  static const char* poolToString(MemoryPool pool);
+
+private:
+  static void addLiveBytes(MemoryPool pool, size_t size);
+  static MemoryPoolStats stats[static_cast<int>(MemoryPool::COUNT)];
+};
+
+/**
+ * @brief STL allocator that places elements in a named pool, in the style of esp32_psram::AllocatorPSRAM
+ * @tparam T Type of elements to allocate
+ * @tparam Pool Pool to allocate from
+ */
+template <typename T, MemoryPool Pool>
+class PoolAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  PoolAllocator() noexcept {}
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U, Pool>&) noexcept {}
+
+  pointer allocate(size_type n) {
+    pointer p = static_cast<pointer>(MemoryPools::allocate(Pool, n * sizeof(T)));
+    // in Arduino exceptions are disabled!
+    assert(p);
+    return p;
+  }
+
+  void deallocate(pointer p, size_type) noexcept { MemoryPools::deallocate(Pool, p); }
+
+  template <typename U>
+  struct rebind {
+    using other = PoolAllocator<U, Pool>;
+  };
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U, Pool>&) const noexcept { return true; }
+
+  template <typename U>
+  bool operator!=(const PoolAllocator<U, Pool>&) const noexcept { return false; }
+};
+
+template <typename T>
+using HotAllocator = PoolAllocator<T, MemoryPool::HOT_INTERNAL>;
+
+#endif // MEMORYPOOLS_H
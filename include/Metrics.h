@@ -0,0 +1,56 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <atomic>
+
+#define METRICS_HTTP_CODE_SLOTS 8  // Distinct API response codes counted separately, the rest are lumped together
+#define METRICS_LOG_LEVELS 5       // E, W, I, D, V
+
+/**
+ * @brief Counters for the Prometheus /metrics endpoint
+ *
+ * Counters are lock-free atomics updated on the hot paths from either core. Gauges (heap, trains,
+ * clients) are read when the endpoint is scraped.
+ */
+class Metrics {
+public:
+  // One update cycle finished, failed if any request or parse in it failed
+  void recordPoll(bool failed);
+
+  // One API request finished with an HTTP status code, or a negative HTTPClient error
+  void recordApiResponse(int httpCode);
+
+  void recordBytesDownloaded(size_t bytes);
+  void recordParseTime(uint32_t micros);
+
+  // A WebSocket message of the given size went to this many clients
+  void recordWebSocketSend(size_t bytes, size_t clients);
+
+  void recordLog(const char* level);
+
+  // Writes every metric in the Prometheus text format straight to the response, one small chunk at a time
+  void writePrometheus(WebServer& server) const;
+
+private:
+  struct HttpCodeCount {
+    std::atomic<int> code{0};  // 0 while the slot is unused
+    std::atomic<uint32_t> count{0};
+  };
+
+  std::atomic<uint32_t> pollsTotal{0};
+  std::atomic<uint32_t> pollFailuresTotal{0};
+  HttpCodeCount httpCodes[METRICS_HTTP_CODE_SLOTS];
+  std::atomic<uint32_t> otherHttpCodes{0};
+  std::atomic<uint32_t> bytesDownloaded{0};
+  std::atomic<uint32_t> parseMicrosTotal{0};  // Wraps after about 71 minutes of parsing, which Prometheus treats as a reset
+  std::atomic<uint32_t> parsesTotal{0};
+  std::atomic<uint32_t> webSocketMessagesSent{0};
+  std::atomic<uint32_t> webSocketBytesSent{0};
+  std::atomic<uint32_t> logMessages[METRICS_LOG_LEVELS] = {};
+};
+
+extern Metrics metrics;
+
+#endif // METRICS_H
@@ -2,54 +2,64 @@
 #define PSRAMJSONALLOCATOR_H
 
 #include <ArduinoJson.h>
-#include <esp_heap_caps.h>
+#include <atomic>
+#include "MemoryPools.h"
+
+// What a JSON document is for, so allocation statistics can be kept separately for each use
+enum class JsonPurpose {
+  INGEST,      // API responses parsed during a poll
+  TRAINS,      // Train list and delta messages
+  LEDS,        // LED state messages
+  LOGS,        // Log messages
+  WS_INBOUND,  // Messages received from WebSocket clients
+  API,         // Other HTTP API responses
+  COUNT
+};
+
+// Allocation statistics for one document purpose. Sizes are in bytes.
+struct JsonAllocatorStats {
+  std::atomic<uint32_t> liveBytes{0};
+  std::atomic<uint32_t> peakBytes{0};
+  std::atomic<uint32_t> allocations{0};
+  std::atomic<uint32_t> reallocations{0};
+  std::atomic<uint32_t> fallbacks{0};  // Blocks that landed in internal SRAM because PSRAM was full
+};
 
 /**
  * @brief Custom ArduinoJson allocator that uses ESP32's PSRAM
- * 
+ *
  * This allocator ensures that all JSON document memory is allocated
  * from PSRAM instead of regular heap, helping to prevent out-of-memory
  * crashes when processing large JSON documents (e.g., 73KB API responses).
+ * Allocations go through the bulk PSRAM pool so they show up in its statistics.
+ *
+ * There is one instance per document purpose, each keeping its own allocation
+ * statistics so buffers can be sized from what documents actually use.
  */
 class PSRAMJsonAllocator : public ArduinoJson::Allocator {
 public:
-  void* allocate(size_t size) override {
-    // Try to allocate from PSRAM first
-    void* ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
-    
-    // Fall back to regular heap if PSRAM allocation fails
-    if (ptr == nullptr) {
-      ptr = malloc(size);
-    }
-    
-    return ptr;
-  }
-
-  void deallocate(void* ptr) override {
-    // heap_caps_free works for both PSRAM and regular heap
-    heap_caps_free(ptr);
-  }
-
-  void* reallocate(void* ptr, size_t new_size) override {
-    // Try to reallocate in PSRAM first
-    void* new_ptr = heap_caps_realloc(ptr, new_size, MALLOC_CAP_SPIRAM);
-    
-    // Fall back to regular heap if PSRAM reallocation fails
-    if (new_ptr == nullptr && new_size > 0) {
-      new_ptr = realloc(ptr, new_size);
-    }
-    
-    return new_ptr;
-  }
-
-  static PSRAMJsonAllocator* instance() {
-    static PSRAMJsonAllocator allocator;
-    return &allocator;
-  }
+  void* allocate(size_t size) override;
+  void deallocate(void* ptr) override;
+  void* reallocate(void* ptr, size_t new_size) override;
+
+  static PSRAMJsonAllocator* instance(JsonPurpose purpose = JsonPurpose::API);
+
+  // Records allocations made by other JSON allocators (e.g. the cycle arena) against a purpose
+  static void recordAllocate(JsonPurpose purpose, size_t size, bool fellBack);
+  static void recordReallocate(JsonPurpose purpose, size_t oldSize, size_t newSize, bool fellBack);
+  static void recordDeallocate(JsonPurpose purpose, size_t size);
+
+  static const JsonAllocatorStats& getStats(JsonPurpose purpose) { return stats[static_cast<int>(purpose)]; }
+  static const char* purposeToString(JsonPurpose purpose);
 
 private:
-  PSRAMJsonAllocator() = default;
+  explicit PSRAMJsonAllocator(JsonPurpose purpose) : purpose(purpose) {}
   ~PSRAMJsonAllocator() = default;
+
+  static void addLiveBytes(JsonPurpose purpose, size_t size);
+
+  JsonPurpose purpose;
+  static JsonAllocatorStats stats[static_cast<int>(JsonPurpose::COUNT)];
 };
 
 #endif // PSRAMJSONALLOCATOR_H
@@ -0,0 +1,85 @@
+#ifndef PERFMONITOR_H
+#define PERFMONITOR_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+// Stages of the update and display pipeline that are timed
+enum class PerfStage {
+  UPDATE_CYCLE,     // Whole train update, from the first request to the released arena
+  HTTP_REQUEST,     // DNS, connect, TLS, sending the request and waiting for the response headers
+  DOWNLOAD_PARSE,   // Reading the body off the network while deserializing it
+  TRAIN_PARSE,      // Walking a parsed response into staged trains
+  TRIP_JOIN,        // Adding a response's referenced trips to the trip cache
+  STATION_MAPPING,  // Mapping the cycle's staged trains from stop IDs to station names and layout ordinals
+  MUTEX_WAIT,       // Waiting for the train data mutex, on either core
+  MERGE,            // Merging staged trains into the vehicle table under the mutex
+  LED_UPDATE,       // Rebuilding the LED tracker from the vehicle table
+  LED_SHOW,         // Pushing pixels out to the strip
+  WS_BROADCAST,     // Serializing and broadcasting a WebSocket message
+  LOOP_DISPATCH,    // From an event being raised to the loop task waking to handle it
+  RENDER_JITTER,    // How far each render tick is from the frame period
+  LED_CORRECT,      // Gamma, channel balance and brightness pass over a frame
+  COUNT
+};
+
+// Bucket i counts samples from 2^i up to 2^(i+1) microseconds (bucket 0 also holds 0). The last bucket holds
+// everything from about 16 seconds up.
+#define PERF_BUCKET_COUNT 25
+
+struct PerfHistogram {
+  uint32_t count = 0;
+  uint32_t minMicros = 0;
+  uint32_t maxMicros = 0;
+  uint64_t totalMicros = 0;
+  uint32_t buckets[PERF_BUCKET_COUNT] = {};
+};
+
+/**
+ * @brief Fixed-bucket latency histograms for each pipeline stage
+ *
+ * Recording is a short critical section, so stages can be timed from either core.
+ * Timers are only compiled in when LINKLIGHT_PERF is defined; see PERF_SCOPE.
+ */
+class PerfMonitor {
+public:
+  void record(PerfStage stage, uint32_t elapsedMicros);
+  void reset();
+
+  // Copy of a stage's histogram, taken under the lock
+  PerfHistogram getHistogram(PerfStage stage) const;
+
+  // Estimates a percentile (0-100) by interpolating inside the bucket that holds it
+  static uint32_t percentile(const PerfHistogram& histogram, unsigned int percent);
+
+  void getPerfAsJson(String& output) const;
+  static const char* stageToString(PerfStage stage);
+
+private:
+  PerfHistogram histograms[static_cast<int>(PerfStage::COUNT)];
+  mutable portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+extern PerfMonitor perfMonitor;
+
+// Times the enclosing scope and records it against a stage when it ends
+class PerfScope {
+public:
+  explicit PerfScope(PerfStage stage) : stage(stage), start(esp_timer_get_time()) {}
+  ~PerfScope() { perfMonitor.record(stage, (uint32_t)(esp_timer_get_time() - start)); }
+
+private:
+  PerfStage stage;
+  int64_t start;
+};
+
+#ifdef LINKLIGHT_PERF
+#define PERF_CONCAT_INNER(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_INNER(a, b)
+#define PERF_SCOPE(stage) PerfScope PERF_CONCAT(perfScope, __LINE__)(stage)
+#else
+#define PERF_SCOPE(stage) do {} while (0)
+#endif
+
+#endif // PERFMONITOR_H
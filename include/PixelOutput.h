@@ -0,0 +1,106 @@
+#ifndef PIXELOUTPUT_H
+#define PIXELOUTPUT_H
+
+#include <Arduino.h>
+#include <NeoPixelBus.h>
+#include "config.h"
+#include "LEDFrame.h"
+#include "LEDLayout.h"
+
+/**
+ * Pixel output backends. A backend is any class with
+ *
+ *   bool begin(uint16_t ledCount);      // Sets up the output, all off
+ *   void show(const LEDFrame& frame);   // Sends the first ledCount pixels of a finished frame
+ *
+ * and is picked at compile time as FramePipeline's template argument, so the hardware path has no virtual
+ * calls. LEDOutput below is the one the firmware uses. RecordingPixelOutput keeps frames on a host instead.
+ */
+
+// Setup for WS2815 LEDs. Yes, it's using Apa106 method, but according to https://github.com/Makuna/NeoPixelBus/pull/795#issuecomment-2466545330
+// that's the one that's closest in timing and works. I've also tried the NeoEsp32Rmt0Ws2811Method and while it worked I was seeing
+// the occasional LED displayed in the wrong position.
+using LEDStrip = NeoPixelBus<NeoGrbFeature, NeoEsp32Rmt0Apa106Method>;
+
+// The same timing on a channel picked at runtime, for driving several outputs
+using LEDChannelStrip = NeoPixelBus<NeoGrbFeature, NeoEsp32RmtNApa106Method>;
+
+// The whole strip on one RMT channel and LED_PIN
+class RmtPixelOutput {
+public:
+  bool begin(uint16_t ledCount) {
+    count = ledCount;
+    strip = new LEDStrip(ledCount, LED_PIN);
+    strip->Begin();
+    strip->Show();  // Initialize all pixels to 'off'
+    return true;
+  }
+
+  void show(const LEDFrame& frame) {
+    for (uint16_t i = 0; i < count; i++) {
+      strip->SetPixelColor(i, frame.pixels[i]);
+    }
+    strip->Show();
+  }
+
+private:
+  LEDStrip* strip = nullptr;
+  uint16_t count = 0;
+};
+
+/**
+ * @brief The outputs described in the layout, each on its own RMT channel and pin
+ *
+ * Each output has its own strip object and maps its pixels to LEDs in wiring order through the layout's output
+ * map, so a row can be wired from either end. The RMT peripheral sends in the background, so Show() on each
+ * output only starts it and they go out in parallel: a frame takes as long as the longest output rather than
+ * the whole strip. With no outputs in the layout this is the whole strip on LED_PIN.
+ */
+class LayoutPixelOutput {
+public:
+  // The layout gives the length of each output, which together cover up to ledCount LEDs
+  bool begin(uint16_t ledCount) {
+    segmentCount = ledLayout.getOutputCount();
+    for (size_t i = 0; i < segmentCount; i++) {
+      const LayoutOutput& output = ledLayout.getOutput(i);
+      Segment& segment = segments[i];
+      segment.leds = ledLayout.getOutputMap() + output.first;
+      segment.count = output.count;
+      segment.strip = new LEDChannelStrip(output.count, output.pin, (NeoBusChannel)i);
+      segment.strip->Begin();
+      segment.strip->Show();  // Initialize all pixels to 'off'
+    }
+    return true;
+  }
+
+  void show(const LEDFrame& frame) {
+    for (size_t i = 0; i < segmentCount; i++) {
+      Segment& segment = segments[i];
+      for (uint16_t pixel = 0; pixel < segment.count; pixel++) {
+        segment.strip->SetPixelColor(pixel, frame.pixels[segment.leds[pixel]]);
+      }
+    }
+    // Only waits for an output's previous frame to finish, so these overlap
+    for (size_t i = 0; i < segmentCount; i++) {
+      segments[i].strip->Show();
+    }
+  }
+
+private:
+  struct Segment {
+    LEDChannelStrip* strip = nullptr;
+    const uint16_t* leds = nullptr;  // LED for each pixel, in wiring order
+    uint16_t count = 0;
+  };
+
+  Segment segments[LED_MAX_OUTPUTS];
+  size_t segmentCount = 0;
+};
+
+#if LED_OUTPUT_FROM_LAYOUT
+using LEDOutput = LayoutPixelOutput;
+#else
+using LEDOutput = RmtPixelOutput;
+#endif
+
+#endif // PIXELOUTPUT_H
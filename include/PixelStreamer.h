@@ -0,0 +1,93 @@
+#ifndef PIXELSTREAMER_H
+#define PIXELSTREAMER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+#include "LEDFrame.h"
+#include "StreamProtocol.h"
+
+enum class StreamProtocol {
+  OFF,
+  DDP,
+  E131
+};
+
+struct StreamTarget {
+  uint32_t address;  // IPv4, network byte order
+  uint16_t port;
+};
+
+/**
+ * @brief Mirrors the rendered frames to other pixel controllers over UDP, as DDP or E1.31
+ *
+ * The render task hands over each tick's frame after it's shown. A frame goes out at most streamRate times a
+ * second and only when it changed, plus a keepalive resend every STREAM_KEEPALIVE_MS so receivers don't fall
+ * back to their own effects. Packets are sent from a non-blocking socket with the header and the frame's
+ * pixels as separate buffers, so the frame is never copied into a packet buffer and a slow network drops
+ * frames rather than holding up the strip.
+ *
+ * The frame is the one before gamma and brightness correction, so receivers apply their own. Settings are
+ * parsed on the loop task by configure() and picked up by the render task on its next tick.
+ * tools/stream_listener receives and checks the stream on a host.
+ */
+class PixelStreamer {
+public:
+  // Reads the stream preferences. Call after they're loaded and again whenever they're saved.
+  void configure();
+
+  // Called by the render task every tick with the frame now on the strip
+  void update(const LEDFrame& frame, uint16_t ledCount);
+
+  // Configured settings, for the loop task
+  bool isEnabled() const { return enabled; }
+  StreamProtocol getProtocol() const { return pending.protocol; }
+  size_t getTargetCount() const { return pending.targetCount; }
+
+  uint32_t getFramesSent() const { return framesSent; }
+  uint32_t getPacketsSent() const { return packetsSent; }
+  uint32_t getSendErrors() const { return sendErrors; }
+
+  static const char* protocolToString(StreamProtocol protocol);
+
+private:
+  struct StreamConfig {
+    StreamProtocol protocol = StreamProtocol::OFF;
+    StreamTarget targets[STREAM_MAX_TARGETS];
+    size_t targetCount = 0;
+    uint32_t intervalMs = 1000 / DEFAULT_STREAM_RATE;
+    char sourceName[E131_SOURCE_NAME_SIZE] = {};
+  };
+
+  void openSocket();
+  void sendDdp(const uint8_t* data, size_t length);
+  void sendE131(const uint8_t* data, size_t length);
+  void sendToTargets(const uint8_t* header, size_t headerLength, const uint8_t* data, size_t length);
+
+  // Written by configure() under lock, copied to active by the render task when configSeq changes
+  StreamConfig pending;
+  std::atomic<uint32_t> configSeq{0};
+  portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+  std::atomic<bool> enabled{false};
+
+  // Render task only
+  StreamConfig active;
+  uint32_t activeSeq = 0;
+  int sock = -1;
+  uint32_t lastSendMillis = 0;
+  uint32_t lastFrameHash = 0;
+  bool resend = false;  // Send the next frame even if unchanged
+  uint8_t ddpSequence = 0;
+  uint8_t e131Sequence[MAX_LED_COUNT / E131_UNIVERSE_PIXELS + 1] = {};
+  uint8_t cid[16] = {};
+  uint8_t packetHeader[E131_HEADER_SIZE];
+
+  std::atomic<uint32_t> framesSent{0};
+  std::atomic<uint32_t> packetsSent{0};
+  std::atomic<uint32_t> sendErrors{0};
+};
+
+extern PixelStreamer pixelStreamer;
+
+#endif // PIXELSTREAMER_H
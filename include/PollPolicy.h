@@ -0,0 +1,68 @@
+#ifndef POLLPOLICY_H
+#define POLLPOLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Summary of the most recent update cycle, used to pick the next poll time
+struct PollSnapshot {
+  size_t trainCount = 0;              // Trains parsed across all routes
+  int soonestArrivalSeconds = -1;     // Seconds until the next MOVING train crosses the at-station threshold, -1 if none
+  unsigned int apiCalls = 0;          // API requests issued during the cycle
+  bool fetchFailed = false;           // True if any API request failed during the cycle
+  bool feedRefreshKnown = false;      // True if any response carried vehicle update timestamps
+  uint32_t feedRefreshMillis = 0;     // Local millis() of the newest upstream vehicle update
+  int64_t upstreamTime = 0;           // Newest upstream currentTime across the cycle's responses (Unix ms)
+};
+
+// Reason the scheduler picked the current poll delay, used for logging
+enum class PollReason {
+  BASE_INTERVAL,
+  TRAIN_ARRIVING,
+  IDLE_BACKOFF,
+  DAILY_BUDGET
+};
+
+// Settings and clock readings the policy needs for one decision
+struct PollLimits {
+  uint32_t baseIntervalSeconds = 0;   // Regular poll interval
+  unsigned int dailyApiBudget = 0;    // API calls allowed per day, 0 for unlimited
+  uint32_t secondsLeftInDay = 0;      // Until the daily call count resets
+};
+
+/**
+ * @brief Picks the delay until the next poll from the latest snapshot
+ *
+ * The decision logic of PollScheduler, kept free of Arduino and FreeRTOS calls so the poll_replay environment
+ * can run it on a host against a simulated day (see tools/poll_replay/main.cpp). The caller passes in the
+ * current millis() and settings, and calls startDay() when the daily budget resets.
+ */
+class PollPolicy {
+public:
+  uint32_t nextDelayMs(const PollSnapshot& snapshot, const PollLimits& limits, uint32_t nowMillis);
+
+  // Resets the daily API call count
+  void startDay() { apiCallsToday = 0; }
+
+  // Drops any idle back-off so the next delay is the regular one again
+  void resetIdleBackoff() { consecutiveIdlePolls = 0; }
+
+  // Learned upstream feed refresh period, 0 until enough polls have been seen
+  uint32_t getFeedPeriodMs() const { return feedPeriodMs; }
+
+  unsigned int getApiCallsToday() const { return apiCallsToday; }
+  PollReason getLastReason() const { return lastReason; }
+
+private:
+  void learnFeedPeriod(uint32_t refreshMillis);
+  uint32_t alignToFeedRefresh(uint32_t desiredMs, bool roundUp, uint32_t nowMillis) const;
+
+  unsigned int apiCallsToday = 0;
+  unsigned int consecutiveIdlePolls = 0;
+  bool feedAnchorValid = false;
+  uint32_t feedAnchorMillis = 0;  // Local millis() of the most recent upstream refresh seen
+  uint32_t feedPeriodMs = 0;
+  PollReason lastReason = PollReason::BASE_INTERVAL;
+};
+
+#endif // POLLPOLICY_H
@@ -0,0 +1,44 @@
+#ifndef POLLSCHEDULER_H
+#define POLLSCHEDULER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "PollPolicy.h"
+
+class PollScheduler {
+public:
+  // Register the task that waits for polls so wake() can interrupt a long delay
+  void setTask(TaskHandle_t task) { pollTask = task; }
+
+  // Picks the delay until the next poll from the latest snapshot, staying inside the daily API budget
+  uint32_t nextPollDelayMs(const PollSnapshot& snapshot);
+
+  // Blocks the calling task until the delay elapses or wake() is called
+  void waitForNextPoll(uint32_t delayMs);
+
+  // Interrupts the current wait so the next poll happens immediately (e.g. after a config change)
+  void wake();
+
+  // Learned upstream feed refresh period, 0 until enough polls have been seen
+  uint32_t getFeedPeriodMs() const { return policy.getFeedPeriodMs(); }
+
+  unsigned int getApiCallsToday() const { return policy.getApiCallsToday(); }
+  uint32_t getLastDelayMs() const { return lastDelayMs; }
+  PollReason getLastReason() const { return policy.getLastReason(); }
+  static const char* reasonToString(PollReason reason);
+
+private:
+  void rollOverDay();
+  uint32_t secondsLeftInDay() const;
+  long currentDayIndex() const;
+
+  PollPolicy policy;  // Only the poll task updates it
+  TaskHandle_t pollTask = nullptr;
+  long dayIndex = -1;
+  uint32_t lastDelayMs = 0;
+  std::atomic<bool> wakeRequested{false};  // Set by wake() from other tasks, consumed by the poll task
+};
+
+extern PollScheduler pollScheduler;
+
+#endif // POLLSCHEDULER_H
@@ -15,6 +15,19 @@ public:
   String getFocusedVehicleId() const { return focusedVehicleId; }
   unsigned int getUpdateInterval() const { return updateInterval; }
   unsigned int getAtStationThreshold() const { return atStationThreshold; }
+  unsigned int getDailyApiBudget() const { return dailyApiBudget; }
+  unsigned int getFreshnessTarget() const { return freshnessTarget; }
+  unsigned int getRenderRate() const { return renderRate; }
+  unsigned int getBrightness() const { return brightness; }
+  unsigned int getNightBrightness() const { return nightBrightness; }
+  unsigned int getNightStart() const { return nightStart; }
+  unsigned int getNightEnd() const { return nightEnd; }
+  String getStreamProtocol() const { return streamProtocol; }
+  String getStreamTargets() const { return streamTargets; }
+  unsigned int getStreamRate() const { return streamRate; }
+  String getIngestMode() const { return ingestMode; }
+  String getRouteLines() const { return routeLines; }
+  String getApiBaseUrl() const { return apiBaseUrl; }
   String getLine1Color() const { return line1Color; }
   String getLine2Color() const { return line2Color; }
   String getSharedColor() const { return sharedColor; }
@@ -25,11 +38,27 @@ public:
   void setFocusedVehicleId(const String& value) { focusedVehicleId = value; }
   void setUpdateInterval(unsigned int value) { updateInterval = value; }
   void setAtStationThreshold(unsigned int value) { atStationThreshold = value; }
+  void setDailyApiBudget(unsigned int value) { dailyApiBudget = value; }
+  void setFreshnessTarget(unsigned int value) { freshnessTarget = value; }
+  void setRenderRate(unsigned int value) { renderRate = value; }
+  void setBrightness(unsigned int value) { brightness = value; }
+  void setNightBrightness(unsigned int value) { nightBrightness = value; }
+  void setNightStart(unsigned int value) { nightStart = value; }
+  void setNightEnd(unsigned int value) { nightEnd = value; }
+  void setStreamProtocol(const String& value) { streamProtocol = value; }
+  void setStreamTargets(const String& value) { streamTargets = value; }
+  void setStreamRate(unsigned int value) { streamRate = value; }
+  void setIngestMode(const String& value) { ingestMode = value; }
+  void setRouteLines(const String& value) { routeLines = value; }
+  void setApiBaseUrl(const String& value) { apiBaseUrl = value; }
   void setLine1Color(const String& value) { line1Color = value; }
   void setLine2Color(const String& value) { line2Color = value; }
   void setSharedColor(const String& value) { sharedColor = value; }
   
 private:
+  void migrateColorSpace();
+  void migrateColor(const char* key, String& color);
+
   Preferences preferences;
   String apiKey;
   String hostname;
@@ -37,6 +66,19 @@ private:
   String focusedVehicleId;  // Not persisted, runtime only
   unsigned int updateInterval;  // Update interval in seconds
   unsigned int atStationThreshold;  // At-station threshold in seconds
+  unsigned int dailyApiBudget;  // Maximum API calls per day, 0 for unlimited
+  unsigned int freshnessTarget;  // p95 data age at display to warn above, in seconds, 0 to disable
+  unsigned int renderRate;  // LED frames per second
+  unsigned int brightness;  // LED brightness in percent
+  unsigned int nightBrightness;  // LED brightness in percent during night hours
+  unsigned int nightStart;  // Local hour (0-23) night brightness starts
+  unsigned int nightEnd;  // Local hour (0-23) night brightness ends
+  String streamProtocol;  // "off", "ddp" or "e131" to stream frames to other controllers
+  String streamTargets;  // Stream target addresses (e.g., "192.168.1.50,192.168.1.51:4049")
+  unsigned int streamRate;  // Most streamed frames per second
+  String ingestMode;  // "route" for one request per route, "agency" for a single agency-wide request
+  String routeLines;  // Route ID to line mapping (e.g., "40_100479:1,40_2LINE:2")
+  String apiBaseUrl;  // OneBusAway API base URL, without a trailing slash
   String line1Color;  // Hex color for Line 1 (e.g., "#00ff00")
   String line2Color;  // Hex color for Line 2 (e.g., "#0000ff")
   String sharedColor;  // Hex color for shared/overlap (e.g., "#ffff00")
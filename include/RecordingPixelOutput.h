@@ -0,0 +1,52 @@
+#ifndef RECORDINGPIXELOUTPUT_H
+#define RECORDINGPIXELOUTPUT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "LEDFrame.h"
+
+/**
+ * @brief Pixel output backend that records frames instead of driving a strip
+ *
+ * Keeps the most recent frames in memory and optionally appends every frame to a file as raw RGB
+ * (ledCount * 3 bytes per frame), so rendering can be checked and timed on a host. See PixelOutput.h for the
+ * backend interface.
+ */
+class RecordingPixelOutput {
+public:
+  // Keeps up to maxFrames frames in memory and, if file isn't null, writes every frame to it
+  explicit RecordingPixelOutput(size_t maxFrames = 1, FILE* file = nullptr) : maxFrames(maxFrames), file(file) {}
+
+  bool begin(uint16_t ledCount);
+  void show(const LEDFrame& frame);
+
+  uint16_t getLedCount() const { return count; }
+
+  // Frames shown since begin(), including ones no longer kept in memory
+  uint32_t getShowCount() const { return showCount; }
+
+  // Frames kept in memory
+  size_t getFrameCount() const { return kept; }
+
+  // RGB bytes of a kept frame, 0 is the oldest
+  const uint8_t* getFrame(size_t index) const {
+    return &frames[((next + maxFrames - kept + index) % maxFrames) * frameSize()];
+  }
+
+  // Color of one LED in the most recent frame
+  RgbColor getPixel(uint16_t led) const;
+
+private:
+  size_t frameSize() const { return (size_t)count * 3; }
+
+  size_t maxFrames;
+  FILE* file;
+  uint16_t count = 0;
+  uint32_t showCount = 0;
+  std::vector<uint8_t> frames;  // Ring of maxFrames frames
+  size_t next = 0;              // Slot the next frame goes in
+  size_t kept = 0;
+};
+
+#endif // RECORDINGPIXELOUTPUT_H
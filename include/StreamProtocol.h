@@ -0,0 +1,78 @@
+#ifndef STREAMPROTOCOL_H
+#define STREAMPROTOCOL_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Packet headers for streaming pixels to other controllers over UDP. Only the headers are built here: the
+// pixel data goes out straight from the frame as the packet's second buffer. No Arduino dependency, so the
+// host listener in tools/stream_listener shares the layout.
+
+// DDP (Distributed Display Protocol, http://www.3waylabs.com/ddp/)
+#define DDP_HEADER_SIZE 10
+#define DDP_MAX_DATA 1440        // Bytes per packet, 480 RGB pixels
+#define DDP_FLAGS_VERSION1 0x40
+#define DDP_FLAGS_PUSH 0x01      // Last packet of a frame, display it
+#define DDP_TYPE_RGB24 0x0B      // RGB, 8 bits per channel
+#define DDP_ID_DISPLAY 1
+
+// E1.31 (streaming ACN, ANSI E1.31-2018) data packets carrying DMX512 universes
+#define E131_HEADER_SIZE 126     // Up to and including the DMX start code
+#define E131_UNIVERSE_PIXELS 170 // 510 of the 512 slots, so no pixel straddles two universes
+#define E131_PRIORITY 100
+#define E131_SOURCE_NAME_SIZE 64
+
+inline void writeBigEndian16(uint8_t* out, uint16_t value) {
+  out[0] = (uint8_t)(value >> 8);
+  out[1] = (uint8_t)value;
+}
+
+inline void writeBigEndian32(uint8_t* out, uint32_t value) {
+  out[0] = (uint8_t)(value >> 24);
+  out[1] = (uint8_t)(value >> 16);
+  out[2] = (uint8_t)(value >> 8);
+  out[3] = (uint8_t)value;
+}
+
+// Header for dataLength bytes at dataOffset in the frame. Sequence is 1-15, 0 tells receivers not to check it.
+inline void writeDdpHeader(uint8_t* header, uint8_t sequence, uint32_t dataOffset, uint16_t dataLength, bool push) {
+  header[0] = DDP_FLAGS_VERSION1 | (push ? DDP_FLAGS_PUSH : 0);
+  header[1] = sequence & 0x0F;
+  header[2] = DDP_TYPE_RGB24;
+  header[3] = DDP_ID_DISPLAY;
+  writeBigEndian32(header + 4, dataOffset);
+  writeBigEndian16(header + 8, dataLength);
+}
+
+// Header for one universe of slotCount DMX slots (3 per pixel). cid identifies the sender and should stay the
+// same across restarts.
+inline void writeE131Header(uint8_t* header, const uint8_t cid[16], const char* sourceName, uint8_t sequence,
+                            uint16_t universe, uint16_t slotCount) {
+  static const uint8_t ACN_PACKET_IDENTIFIER[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+  uint16_t packetLength = E131_HEADER_SIZE + slotCount;
+  memset(header, 0, E131_HEADER_SIZE);
+
+  // Root layer
+  writeBigEndian16(header, 0x0010);  // Preamble size
+  memcpy(header + 4, ACN_PACKET_IDENTIFIER, sizeof(ACN_PACKET_IDENTIFIER));
+  writeBigEndian16(header + 16, 0x7000 | (packetLength - 16));
+  writeBigEndian32(header + 18, 0x00000004);  // VECTOR_ROOT_E131_DATA
+  memcpy(header + 22, cid, 16);
+
+  // Framing layer
+  writeBigEndian16(header + 38, 0x7000 | (packetLength - 38));
+  writeBigEndian32(header + 40, 0x00000002);  // VECTOR_E131_DATA_PACKET
+  strncpy((char*)header + 44, sourceName, E131_SOURCE_NAME_SIZE - 1);
+  header[108] = E131_PRIORITY;
+  header[111] = sequence;
+  writeBigEndian16(header + 113, universe);
+
+  // DMP layer, ending with the DMX start code (0) as the first property value
+  writeBigEndian16(header + 115, 0x7000 | (packetLength - 115));
+  header[117] = 0x02;  // VECTOR_DMP_SET_PROPERTY
+  header[118] = 0xA1;  // Address and data type
+  writeBigEndian16(header + 121, 0x0001);  // Address increment
+  writeBigEndian16(header + 123, slotCount + 1);
+}
+
+#endif // STREAMPROTOCOL_H
@@ -0,0 +1,94 @@
+#ifndef TIMELAPSERECORDER_H
+#define TIMELAPSERECORDER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Position in the recording during playback
+struct TimelapseCursor {
+  uint32_t position = 0;  // Next record, counted in bytes written since boot
+  uint32_t millis = 0;    // When the last record read was recorded
+};
+
+// Recorded size and span, for /api/timelapse
+struct TimelapseStats {
+  uint32_t capacity = 0;
+  uint32_t bytesUsed = 0;
+  uint32_t bytesWritten = 0;   // Since boot, including records since overwritten
+  uint32_t records = 0;        // Since boot
+  uint32_t keyframes = 0;      // Since boot
+  uint32_t spanSeconds = 0;    // From the oldest keyframe still kept to the newest record
+  uint32_t bytesPerDay = 0;    // At the rate recorded since boot
+  uint32_t averageRecordMicros = 0;
+};
+
+/**
+ * @brief Records which lines have a train on each LED, compactly enough to keep days of it in PSRAM
+ *
+ * LEDController hands over the line mask of every LED (LINE_MASK_* bits) whenever it publishes the trains, and
+ * only the LEDs that changed since the last call are stored, with the time since the previous record. Every
+ * TIMELAPSE_KEYFRAME_INTERVAL the whole state is stored instead, with an absolute time, so playback can start
+ * at any keyframe. Records go into a TIMELAPSE_BUFFER_SIZE byte ring allocated from the bulk PSRAM pool on
+ * first use, and the oldest whole records are dropped to make room.
+ *
+ * A record is its body length, then a varint of the milliseconds since the previous record shifted left one,
+ * or 1 followed by four bytes of millis() for a keyframe. Each LED entry is a varint of the number of LEDs
+ * skipped since the previous entry, shifted left two, with the LED's mask in the low bits, so a train moving
+ * one LED usually costs under 10 bytes. Calls with nothing changed store nothing.
+ *
+ * Only used from the loop task, so there's no locking.
+ */
+class TimelapseRecorder {
+public:
+  // Records the masks of the first ledCount LEDs as they are at nowMillis
+  void record(const uint8_t* masks, uint16_t ledCount, uint32_t nowMillis);
+
+  // Points cursor at the newest keyframe recorded at or before startMillis, or the oldest keyframe if all are
+  // later. Returns false if there's no keyframe.
+  bool seek(uint32_t startMillis, TimelapseCursor& cursor) const;
+
+  // Applies every record up to untilMillis to masks and advances the cursor past them. Returns how many were
+  // applied, or -1 if the recording has moved on and overwritten the cursor.
+  int replay(TimelapseCursor& cursor, uint32_t untilMillis, uint8_t* masks, uint16_t ledCount) const;
+
+  // True once the cursor has reached the newest record
+  bool atEnd(const TimelapseCursor& cursor) const { return cursor.position == head; }
+
+  TimelapseStats getStats(uint32_t nowMillis) const;
+
+private:
+  struct RecordHeader {
+    uint32_t bodyStart;   // Position of the body
+    uint32_t end;         // Position of the next record
+    uint32_t millis;      // When it was recorded
+    bool keyframe;
+  };
+
+  bool readHeader(uint32_t position, uint32_t previousMillis, RecordHeader& header) const;
+  uint8_t readByte(uint32_t position) const { return buffer[position % TIMELAPSE_BUFFER_SIZE]; }
+  uint32_t readVarint(uint32_t& position) const;
+  void append(const uint8_t* data, size_t length);
+  void dropOldest();
+
+  uint8_t* buffer = nullptr;
+  bool allocationFailed = false;
+
+  // Positions count bytes written since boot and wrap into the ring, overflowing only after 4 GB
+  uint32_t head = 0;  // Where the next record goes
+  uint32_t tail = 0;  // Oldest record kept
+
+  uint8_t lastMasks[MAX_LED_COUNT] = {};
+  uint32_t lastRecordMillis = 0;
+  uint32_t lastKeyframeMillis = 0;
+  uint32_t firstRecordMillis = 0;
+  uint32_t recordCount = 0;
+  uint32_t keyframeCount = 0;
+  uint32_t averageRecordMicros = 0;
+
+  // The record being encoded: length, time and an entry of at most 2 bytes per LED
+  uint8_t scratch[3 + 5 + 4 + MAX_LED_COUNT * 2];
+};
+
+extern TimelapseRecorder timelapseRecorder;
+
+#endif // TIMELAPSERECORDER_H
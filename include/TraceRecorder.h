@@ -0,0 +1,105 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+
+// One begin or end event. Names must be string literals, since only the pointer is stored.
+struct TraceEvent {
+  uint32_t timestampMicros;  // Low 32 bits of esp_timer, unwrapped on export
+  const char* name;
+  TaskHandle_t task;
+  uint8_t core;
+  char phase;                // 'B' for begin, 'E' for end
+};
+
+/**
+ * @brief Bounded ring of begin/end events exported as Chrome trace JSON
+ *
+ * Recording is off until enabled at runtime. When off, a TRACE_SCOPE costs one atomic load. When on,
+ * it costs a timer read and an atomic increment, with no locks or allocation, so both cores can
+ * record at once. The ring is allocated from internal SRAM the first time tracing is enabled and
+ * the newest TRACE_BUFFER_SIZE events are kept.
+ *
+ * Only tasks that live for the whole uptime (loop and TrainUpdate) are traced, since task names are
+ * looked up from their handles when the trace is exported.
+ */
+class TraceRecorder {
+public:
+  void setEnabled(bool enable);
+  bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+  void record(const char* name, char phase) {
+    if (!enabled.load(std::memory_order_relaxed)) {
+      return;
+    }
+    record(name, phase, (uint32_t)esp_timer_get_time());
+  }
+
+  void record(const char* name, char phase, uint32_t timestampMicros) {
+    if (!enabled.load(std::memory_order_relaxed)) {
+      return;
+    }
+    uint32_t index = writeIndex.fetch_add(1, std::memory_order_relaxed) & (TRACE_BUFFER_SIZE - 1);
+    TraceEvent& event = events[index];
+    event.timestampMicros = timestampMicros;
+    event.name = name;
+    event.task = xTaskGetCurrentTaskHandle();
+    event.core = (uint8_t)xPortGetCoreID();
+    event.phase = phase;
+  }
+
+  // Serializes the recorded events in the Chrome trace event format, pausing recording while copying them
+  void getTraceAsJson(String& output);
+
+private:
+  TraceEvent* events = nullptr;
+  std::atomic<bool> enabled{false};
+  std::atomic<uint32_t> writeIndex{0};
+};
+
+extern TraceRecorder traceRecorder;
+
+// Records a begin event now and the matching end event when the enclosing scope exits
+class TraceScope {
+public:
+  explicit TraceScope(const char* name) : name(name) { traceRecorder.record(name, 'B'); }
+  ~TraceScope() { traceRecorder.record(name, 'E'); }
+
+private:
+  const char* name;
+};
+
+// Records a scope only if it lasted at least minMicros, for calls made every loop that are usually idle.
+// Both events are written when the scope exits, so they land in the ring after anything nested inside.
+class TraceSlowScope {
+public:
+  TraceSlowScope(const char* name, uint32_t minMicros)
+    : name(name), minMicros(minMicros), start(traceRecorder.isEnabled() ? (uint32_t)esp_timer_get_time() : 0) {}
+  ~TraceSlowScope() {
+    if (start == 0 || !traceRecorder.isEnabled()) {
+      return;
+    }
+    uint32_t end = (uint32_t)esp_timer_get_time();
+    if (end - start >= minMicros) {
+      traceRecorder.record(name, 'B', start);
+      traceRecorder.record(name, 'E', end);
+    }
+  }
+
+private:
+  const char* name;
+  uint32_t minMicros;
+  uint32_t start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SLOW_SCOPE(name) TraceSlowScope TRACE_CONCAT(traceScope, __LINE__)(name, TRACE_SLOW_THRESHOLD)
+
+#endif // TRACERECORDER_H
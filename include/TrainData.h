@@ -0,0 +1,65 @@
+#ifndef TRAINDATA_H
+#define TRAINDATA_H
+
+#include <Arduino.h>
+
+// Train state enum
+enum class TrainState {
+  AT_STATION,
+  MOVING
+};
+
+// Train direction enum
+enum class TrainDirection {
+  SOUTHBOUND = 0,
+  NORTHBOUND = 1
+};
+
+// Line identifier enum
+enum class Line {
+  LINE_1 = 1,
+  LINE_2 = 2
+};
+
+// Train data structure
+struct TrainData {
+  String closestStop;
+  String closestStopName;
+  int closestStopOrdinal;  // Station ordinal in the LED layout, -1 if it isn't in the layout
+  int closestStopTimeOffset;
+  String nextStop;
+  String nextStopName;
+  int nextStopOrdinal;
+  int nextStopTimeOffset;
+  String tripId;
+  String vehicleId;
+  TrainDirection direction;
+  String routeId;
+  String tripHeadsign;
+  Line line;  // Line identifier
+  TrainState state;  // Whether the train is at a station or moving between stations
+  uint32_t snapshotMillis;  // Local millis() when the time offsets were current, used to age them between polls
+};
+
+// A train parsed during an update cycle, before it's merged into the vehicle table. The strings point into
+// the update task's cycle arena and are only valid until the arena is reset after the merge.
+struct StagedTrain {
+  const char* closestStop;
+  const char* closestStopName;
+  int closestStopOrdinal;
+  int closestStopTimeOffset;
+  const char* nextStop;
+  const char* nextStopName;
+  int nextStopOrdinal;
+  int nextStopTimeOffset;
+  const char* tripId;
+  const char* vehicleId;
+  TrainDirection direction;
+  const char* routeId;
+  const char* tripHeadsign;
+  Line line;
+  TrainState state;
+  uint32_t snapshotMillis;
+};
+
+#endif // TRAINDATA_H
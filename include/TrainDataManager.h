@@ -7,61 +7,96 @@
 // Only include the PSRAM components we need to avoid compilation issues with InMemoryFS
 #include "esp32-psram/AllocatorPSRAM.h"
 #include "esp32-psram/VectorPSRAM.h"
+#include "config.h"
+#include "CycleArena.h"
+#include "PollScheduler.h"
+#include "TrainData.h"
+#include "TripCache.h"
+#include "VehicleTable.h"
 
-// Train state enum
-enum class TrainState {
-  AT_STATION,
-  MOVING
-};
-
-// Train direction enum
-enum class TrainDirection {
-  SOUTHBOUND = 0,
-  NORTHBOUND = 1
-};
-
-// Line identifier enum
-enum class Line {
-  LINE_1 = 1,
-  LINE_2 = 2
-};
-
-// Train data structure
-struct TrainData {
-  String closestStop;
-  String closestStopName;
-  int closestStopTimeOffset;
-  String nextStop;
-  String nextStopName;
-  int nextStopTimeOffset;
-  String tripId;
-  String vehicleId;
-  TrainDirection direction;
+// A route shown on the strip and the line its trains are drawn as
+struct RouteLine {
   String routeId;
-  String tripHeadsign;
-  Line line;  // Line identifier
-  TrainState state;  // Whether the train is at a station or moving between stations
+  Line line;
 };
 
 class TrainDataManager {
 public:
   void updateTrainPositions();
   
-  // Returns the current list of train data parsed from the API or sample data
-  const esp32_psram::VectorPSRAM<TrainData>& getTrainDataList() const { return trainDataList; }
+  // Returns the trains parsed from the API or sample data, keyed by vehicleId. Hold dataMutex while reading.
+  const VehicleTable& getVehicleTable() const { return vehicleTable; }
 
   // Serializes the current train data list to a JSON string
   void getTrainDataAsJson(String& output) const;
 
-  // Mutex for thread-safe access to trainDataList between cores
+  // Serializes the trains changed or removed since the merge numbered sentSeq, or the full list if more than
+  // one merge has happened since. Updates sentSeq. Returns false if there's nothing new to send.
+  bool getTrainDataDeltaAsJson(String& output, uint32_t& sentSeq) const;
+
+  // Milliseconds since the newest upstream vehicle update in the published data, or -1 if unknown
+  int32_t getDataAgeMs() const;
+
+  // Summary of the last update cycle, used by the poll scheduler
+  const PollSnapshot& getPollSnapshot() const { return pollSnapshot; }
+
+  // Trip cache statistics for the status page
+  const TripCache& getTripCache() const { return tripCache; }
+
+  // Time spent deserializing and parsing responses in the last cycle, and running averages for cycles
+  // with a warm trip cache (references skipped) and a cold one
+  uint32_t getLastParseMicros() const { return lastParseMicros; }
+  uint32_t getWarmParseMicros() const { return warmParseMicros; }
+  uint32_t getColdParseMicros() const { return coldParseMicros; }
+
+  // Per-cycle arena statistics for the status page
+  const CycleArena& getCycleArena() const { return cycleArena; }
+
+  // Mutex for thread-safe access to vehicleTable between cores
   SemaphoreHandle_t dataMutex = nullptr;
+
+  // Take and give dataMutex. The wait is timed as a pipeline stage.
+  void lockData() const;
+  void unlockData() const;
   
 private:
   bool parseTrainDataFromJson(JsonDocument& doc, Line line);
+  bool parseVehiclesForAgency(JsonDocument& doc);
+  bool addTrainFromStatus(JsonObject status, const char* tripId, Line line, const TripInfo* tripInfo,
+                          uint32_t snapshotMillis, int64_t& newestUpdateTime);
+  void recordFeedRefresh(int64_t currentTime, int64_t newestUpdateTime);
+  bool fetchJson(const char* url, JsonDocument& doc, const char* label);
+  void recordParseTime(bool cacheWarm);
+  void holdVehicle(const char* vehicleId);
+  void mapStagedStations();
+  void mergeStagedTrains();
+  void releaseCycleMemory();
+  void logTrain(const TrainData& train, const char* change) const;
   void fetchTrainDataForRoute(const String& routeId, Line line, const String& apiKey);
+  void fetchTrainDataForAgency(const String& apiKey);
+  void refreshRouteLines();
+  const RouteLine* findRouteLine(const String& routeId) const;
   void buildTrainJsonObject(JsonObject trainObj, const TrainData& train) const;
-  esp32_psram::VectorPSRAM<TrainData> trainDataList;
-  esp32_psram::VectorPSRAM<TrainData> buildingList;
+  VehicleTable vehicleTable;
+
+  // Everything transient in an update cycle comes from this arena and is released at once after the merge
+  CycleArena cycleArena{CYCLE_ARENA_SIZE};
+  ArenaJsonAllocator arenaJsonAllocator{&cycleArena};
+  ArenaVector<StagedTrain> stagingList{AllocatorArena<StagedTrain>(&cycleArena)};  // Trains parsed this cycle
+  // Vehicles listed this cycle on a trip that isn't cached yet, kept as they were until references are fetched
+  ArenaVector<const char*> heldVehicles{AllocatorArena<const char*>(&cycleArena)};
+
+  // Parsed route-to-line preference, refreshed when the preference changes
+  esp32_psram::VectorPSRAM<RouteLine> routeLineList;
+  String routeLinesSource;
+  PollSnapshot pollSnapshot;
+  TripCache tripCache;
+  uint32_t cycleParseMicros = 0;
+  uint32_t lastParseMicros = 0;
+  uint32_t warmParseMicros = 0;
+  uint32_t coldParseMicros = 0;
+  bool publishedFeedRefreshKnown = false;
+  uint32_t publishedFeedRefreshMillis = 0;
 };
 
 extern TrainDataManager trainDataManager;
@@ -0,0 +1,55 @@
+#ifndef TRANSITIONENGINE_H
+#define TRANSITIONENGINE_H
+
+#include <stdint.h>
+#include "config.h"
+#include "LEDFrame.h"
+
+/**
+ * @brief Animates the strip from one target frame to the next
+ *
+ * Each LED crossfades to its new color along an ease-in-out curve. LEDs that go dark fade out over the longer
+ * tail time, so a train stepping to the next LED leaves a short trail behind it, and a station LED that lights
+ * up pulses brighter once to mark the arrival.
+ *
+ * State is a small fixed array per LED and all per-frame math is integer, with the curves looked up from
+ * 256-entry tables built once. Nothing here depends on Arduino, so the native PlatformIO environment can run
+ * it on a host (see tools/transition_profile).
+ */
+class TransitionEngine {
+public:
+  TransitionEngine();
+
+  // Number of LEDs to animate, from the layout. Defaults to MAX_LED_COUNT.
+  void setLedCount(uint16_t count) { ledCount = count > MAX_LED_COUNT ? MAX_LED_COUNT : count; }
+
+  // Starts transitions on every LED whose color differs from the new target
+  void setTarget(const LEDFrame& target);
+
+  // Advances every transition by elapsedMs and writes the blended frame. Returns true while any LED is
+  // still changing.
+  bool render(uint32_t elapsedMs, LEDFrame& output);
+
+  bool isAnimating() const { return animating; }
+
+private:
+  struct LEDState {
+    RgbColor from;
+    RgbColor to;
+    uint16_t fadeElapsedMs;
+    uint16_t fadeDurationMs;   // 0 once settled on the target
+    uint16_t pulseElapsedMs;   // TRANSITION_PULSE_MS when not pulsing
+  };
+
+  RgbColor currentColor(const LEDState& state) const;
+  static RgbColor blend(const RgbColor& from, const RgbColor& to, uint8_t amount);
+  static uint8_t progress(uint16_t elapsedMs, uint16_t durationMs);
+
+  LEDState leds[MAX_LED_COUNT];
+  uint16_t ledCount = MAX_LED_COUNT;
+  uint8_t easeTable[256];   // Smoothstep, 0-255 in and out
+  uint8_t pulseTable[256];  // Rises and falls back to 0 over the pulse
+  bool animating = false;
+};
+
+#endif // TRANSITIONENGINE_H
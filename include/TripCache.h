@@ -0,0 +1,69 @@
+#ifndef TRIPCACHE_H
+#define TRIPCACHE_H
+
+#include <Arduino.h>
+#include "esp32-psram/VectorPSRAM.h"
+#include "PSRAMString.h"
+#include "TrainData.h"
+
+// Trip information from the response's references section. Fixed for the life of a trip.
+struct TripInfo {
+  TrainDirection directionId;
+  String routeId;
+  String tripHeadsign;
+};
+
+// Persistent cache of trip information across polls, so the references section only needs parsing
+// when a trip we haven't seen before shows up. Open-addressed hash table in PSRAM keyed by trip ID.
+class TripCache {
+public:
+  // Starts a new update cycle. Trips not looked up or inserted before endCycle() are considered gone.
+  void beginCycle();
+
+  // Evicts trips not referenced during the cycle. Skip eviction when a fetch failed, since trips
+  // from the failed request weren't seen but are still running.
+  void endCycle(bool evictStale);
+
+  // Returns the cached trip, or nullptr on a miss. Marks the trip as referenced this cycle.
+  const TripInfo* find(const char* tripId);
+
+  // Adds a trip if it isn't cached yet. Trip information never changes, so cached trips are only marked
+  // as referenced. Returns false if the cache is full.
+  bool insert(const char* tripId, TrainDirection directionId, const char* routeId, const char* tripHeadsign);
+
+  // True when every trip in the last responses was already cached, so references can be skipped
+  bool isWarm() const { return warm; }
+
+  // Forces the next response to include references, e.g. after a miss while warm
+  void markCold() { warm = false; }
+
+  size_t size() const { return count; }
+  uint32_t getCycleHits() const { return cycleHits; }
+  uint32_t getCycleMisses() const { return cycleMisses; }
+  uint32_t getTotalHits() const { return totalHits; }
+  uint32_t getTotalMisses() const { return totalMisses; }
+
+private:
+  struct Entry {
+    PSRAMString tripId;  // Interned copy of the trip ID, compared on hash match
+    TripInfo info;
+    uint32_t hash = 0;
+    uint32_t generation = 0;
+    bool used = false;
+  };
+
+  static uint32_t hashTripId(const char* tripId);
+  size_t findSlot(const char* tripId, uint32_t hash) const;
+  void evictOlderThan(uint32_t keepGeneration);
+
+  esp32_psram::VectorPSRAM<Entry> slots;
+  size_t count = 0;
+  uint32_t generation = 0;
+  bool warm = false;
+  uint32_t cycleHits = 0;
+  uint32_t cycleMisses = 0;
+  uint32_t totalHits = 0;
+  uint32_t totalMisses = 0;
+};
+
+#endif // TRIPCACHE_H
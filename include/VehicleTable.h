@@ -0,0 +1,93 @@
+#ifndef VEHICLETABLE_H
+#define VEHICLETABLE_H
+
+#include <Arduino.h>
+#include "esp32-psram/VectorPSRAM.h"
+#include "TrainData.h"
+
+// Result of merging one staged train into the table
+enum class VehicleUpsert {
+  INSERTED,   // Vehicle wasn't in the table
+  UPDATED,    // Vehicle was in the table and something deciding its LED changed
+  UNCHANGED,  // Vehicle was in the table and only its time offsets moved
+  DUPLICATE,  // Vehicle was already merged this cycle (e.g. listed under two trips), ignored
+  FULL        // Table is full, vehicle dropped
+};
+
+// Persistent table of trains keyed by vehicleId, kept across polls so consumers can work on what changed.
+// Open-addressed hash table in PSRAM with tombstones for vehicles that left service. Not thread safe,
+// callers hold TrainDataManager::dataMutex.
+class VehicleTable {
+public:
+  // Starts merging a new poll. Vehicles not upserted before endMerge() are removed.
+  void beginMerge();
+
+  // Updates the vehicle in place, or inserts it if it's new. Strings are copied into the table's own
+  // Strings, which reuse their buffers when the value still fits.
+  VehicleUpsert upsert(const StagedTrain& train);
+
+  // Keeps a vehicle from the last poll as it is, for one this poll listed but couldn't place. Call after the
+  // upserts. Returns false if the vehicle isn't in the table or was already merged this cycle.
+  bool keep(const char* vehicleId);
+
+  // Tombstones vehicles that weren't in this poll. Returns how many were removed.
+  size_t endMerge();
+
+  // Calls fn(const TrainData&) for every vehicle in the table
+  template<typename Fn>
+  void forEach(Fn fn) const {
+    for (const Entry& entry : slots) {
+      if (entry.state == SlotState::LIVE) {
+        fn(entry.train);
+      }
+    }
+  }
+
+  // Calls fn(const TrainData&) for every vehicle inserted or updated by the last merge. Vehicles whose time offsets
+  // alone moved aren't included, so their offsets in a delta are as of their last change.
+  template<typename Fn>
+  void forEachChanged(Fn fn) const {
+    for (const Entry& entry : slots) {
+      if (entry.state == SlotState::LIVE && entry.changedSeq == mergeSeq) {
+        fn(entry.train);
+      }
+    }
+  }
+
+  // Vehicle IDs removed by the last merge
+  const esp32_psram::VectorPSRAM<String>& getRemovedIds() const { return removedIds; }
+
+  // Increments on every merge, so consumers can tell whether they missed one
+  uint32_t getMergeSeq() const { return mergeSeq; }
+
+  size_t size() const { return liveCount; }
+  size_t getChangedCount() const { return changedCount; }
+
+private:
+  enum class SlotState : uint8_t {
+    EMPTY,
+    LIVE,
+    TOMBSTONE
+  };
+
+  struct Entry {
+    TrainData train;
+    uint32_t hash = 0;
+    uint32_t seenSeq = 0;     // Merge that last contained this vehicle
+    uint32_t changedSeq = 0;  // Merge that last inserted or changed this vehicle
+    SlotState state = SlotState::EMPTY;
+  };
+
+  static uint32_t hashVehicleId(const char* vehicleId);
+  size_t findSlot(const char* vehicleId, uint32_t hash, bool& found) const;
+  void rehash();
+
+  esp32_psram::VectorPSRAM<Entry> slots;
+  esp32_psram::VectorPSRAM<String> removedIds;
+  size_t liveCount = 0;
+  size_t tombstoneCount = 0;
+  size_t changedCount = 0;
+  uint32_t mergeSeq = 0;
+};
+
+#endif // VEHICLETABLE_H
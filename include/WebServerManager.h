@@ -16,6 +16,12 @@ public:
   void sendLogData(int clientNum = -1);
   void sendTrainData(int clientNum = -1);
   void sendLEDState(int clientNum = -1);
+  void sendMemoryState();
+  // Sends the frame on the strip to clients subscribed to the "frames" topic that are due one
+  void sendFrames();
+  // Milliseconds until a mirroring client is due a frame it hasn't had, UINT32_MAX if none is waiting
+  uint32_t getFrameWaitMs();
+  int getWebSocketClientCount() { return webSocket.connectedClients(); }
   
 private:
   void handleFile();
@@ -25,15 +31,38 @@ private:
   void handleStatusApi();
   void handleConfigApi();
   void handleStationsApi();
+  void handleMemoryApi();
+  void handlePerfApi();
+  void handlePerfReset();
+  void handleTraceApi();
+  void handleTraceControl();
+  void handleTimelapseApi();
+  void handleTimelapseControl();
+  void handleMetrics();
   void handleUpdateFirmware();
   void handleUpdateFirmwareUpload();
   void handleUpdateFilesystem();
   void handleUpdateFilesystemUpload();
+  // Send a WebSocket message and count it for /metrics
+  void broadcastText(String& message);
+  void sendText(uint8_t clientNum, String& message);
   void handleWebSocketEvent(uint8_t clientNum, WStype_t type, uint8_t * payload, size_t length);
   static String getMimeType(const String& path);
   
   WebServer server{WEB_SERVER_PORT};
   WebSocketsServer webSocket{WEB_SOCKET_PORT};
+
+  // Vehicle table merge last broadcast to WebSocket clients, used to send only changed trains
+  uint32_t sentTrainDataSeq = 0;
+
+  // Bit per client subscribed to the live "memory" topic
+  uint32_t memorySubscribers = 0;
+
+  // Bit per client subscribed to the binary "frames" topic, and each one's rate and last frame sent
+  uint32_t frameSubscribers = 0;
+  uint32_t frameIntervalMs[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+  uint32_t frameSentMillis[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+  uint32_t frameSentSeq[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
 };
 
 extern WebServerManager webServerManager;
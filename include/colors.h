@@ -3,27 +3,36 @@
 
 #include <NeoPixelBus.h>
 #include <Arduino.h>
+#include <atomic>
 
 // Common LED colors used throughout the application
-static const RgbColor COLOR_BLUE = RgbColor(0x00, 0x7C, 0xAD); // Official SoundTransit blue
-static const RgbColor COLOR_GREEN = RgbColor(0x28, 0x81, 0x3F); // Official SoundTransit green
-static const RgbColor COLOR_YELLOW = RgbColor(32, 32, 0);
+static const RgbColor COLOR_BLUE = RgbColor(0x00, 0xB8, 0xD6); // Official SoundTransit blue, see DEFAULT_LINE2_COLOR
+static const RgbColor COLOR_GREEN = RgbColor(0x6E, 0xBB, 0x87); // Official SoundTransit green, see DEFAULT_LINE1_COLOR
+static const RgbColor COLOR_YELLOW = RgbColor(128, 128, 0);
 static const RgbColor COLOR_BLACK = RgbColor(0, 0, 0);
 
+// Line colors parsed from preferences, so rendering never touches strings
+struct LinePalette {
+  RgbColor line1;
+  RgbColor line2;
+  RgbColor shared;  // When both lines have trains at the same LED
+};
+
 // Helper class for color management
 class ColorManager {
 public:
   // Convert hex color string (e.g., "#00ff00") to RgbColor
   static RgbColor hexToRgb(const String& hexColor);
   
-  // Get Line 1 color from preferences
-  static RgbColor getLine1Color();
-  
-  // Get Line 2 color from preferences
-  static RgbColor getLine2Color();
-  
-  // Get shared line color from preferences (when both lines have trains at same LED)
-  static RgbColor getSharedLineColor();
+  // Parses the color preferences into the inactive palette and swaps it in. Call after loading or saving preferences.
+  static void refreshPalette();
+
+  // Current palette. Load it once per frame; it stays valid until the palette is refreshed twice.
+  static const LinePalette& getPalette() { return *activePalette.load(std::memory_order_acquire); }
+
+private:
+  static LinePalette palettes[2];
+  static std::atomic<const LinePalette*> activePalette;
 };
 
 #endif // COLORS_H
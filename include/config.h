@@ -4,18 +4,51 @@
 // OTA Configuration
 #define OTA_HOSTNAME "LinkLight"
 #define OTA_PASSWORD ""  // Empty by default, can be set for security
+#define OTA_PORT 3232    // UDP port OTA invitations arrive on
 
 // WiFi Configuration
 #define WIFI_PORTAL_TIMEOUT 180  // Timeout for WiFi portal in seconds
 
 // LED Configuration
 #define LED_PIN 8                  // GPIO pin for NeoPixel data
-#define LED_COUNT 160              // Number of LEDs in the strip
+#define MAX_LED_COUNT 300          // Longest strip a layout may describe, sizes the frame buffers
+#define DEFAULT_LED_COUNT 160      // Strip length used when the layout file can't be loaded
+#define LED_RENDER_TASK_PRIORITY 3 // Above the loop and train update tasks (both 1)
+#define LED_OUTPUT_FROM_LAYOUT 1   // 1 drives the outputs in the layout in parallel, 0 the whole strip from LED_PIN
+#define LED_MAX_OUTPUTS 4          // RMT transmit channels on the ESP32-S3
+
+// LED layout, loaded from LittleFS at boot (see data/layout.json)
+#define LAYOUT_FILE "/layout.json"
+#define MAX_LAYOUT_ROWS 8          // Physical rows of LEDs
+#define MAX_LAYOUT_STATIONS 64     // Stations with LEDs
+#define MAX_LAYOUT_OVERRIDES 8     // Special-case en-route LEDs
+#define LAYOUT_LINE_COUNT 2        // Lines the en-route table covers, Line::LINE_1 and Line::LINE_2
+
+// Per-channel balance applied with gamma and brightness (0-255, 255 leaves the channel as is)
+#define LED_CORRECTION_RED 255
+#define LED_CORRECTION_GREEN 255
+#define LED_CORRECTION_BLUE 255
+#define BRIGHTNESS_CHECK_INTERVAL 1000  // How often the render task checks the brightness schedule (milliseconds)
+
+// LED transitions (milliseconds)
+#define TRANSITION_FADE_MS 250     // Crossfade when an LED lights up or changes color
+#define TRANSITION_TAIL_MS 900     // Fade out when a train leaves an LED, leaving a short tail behind it
+#define TRANSITION_PULSE_MS 700    // Brightness pulse when a train arrives at a station LED
 
 // Web Server Configuration
 #define WEB_SERVER_PORT 80
 #define WEB_SOCKET_PORT 81
 
+// Streaming frames to other pixel controllers over UDP
+#define STREAM_PROTOCOL_OFF "off"
+#define STREAM_PROTOCOL_DDP "ddp"
+#define STREAM_PROTOCOL_E131 "e131"
+#define DDP_PORT 4048
+#define E131_PORT 5568
+#define STREAM_MAX_TARGETS 4
+#define STREAM_KEEPALIVE_MS 1000   // Resend an unchanged frame this often, so receivers don't time out
+#define STREAM_E131_UNIVERSE 1     // First E1.31 universe, the strip continues in the following ones
+
 // API Configuration
 #define API_BASE_URL "https://api.pugetsound.onebusaway.org/api/where"
 #define API_KEY_PARAM "key"       // API key parameter name
@@ -24,10 +57,78 @@
 // Route IDs
 #define LINE_1_ROUTE_ID "40_100479"  // Link Light Rail Line 1
 #define LINE_2_ROUTE_ID "40_2LINE"   // Link Light Rail Line 2
+#define AGENCY_ID "40"               // Sound Transit, used for agency-wide vehicle queries
+
+// Trip metadata cache
+#define TRIP_CACHE_SIZE 512          // Maximum cached trips (power of two), covers every agency trip in service at once
+
+// Vehicle table
+#define VEHICLE_TABLE_SIZE 128       // Maximum trains tracked at once (power of two)
+
+// Per-cycle arena for parsed responses and staged trains, sized for a cold agency-wide response
+#define CYCLE_ARENA_SIZE (256 * 1024)
+
+// Memory pools
+#define BULK_INTERNAL_FALLBACK_MAX 4096  // Largest bulk allocation allowed to spill into internal SRAM when PSRAM is full
+
+// Memory telemetry
+#define MEMORY_SAMPLE_INTERVAL (10 * 60 * 1000)  // History sample period in milliseconds (10 minutes)
+#define MEMORY_HISTORY_SIZE 2016                 // History samples kept in PSRAM, two weeks at the sample period
+#define MEMORY_LIVE_INTERVAL 5000                // Live sample period for WebSocket subscribers in milliseconds
+#define MEMORY_MAX_TASKS 4                       // Tasks whose stack high-water marks are recorded
+#define MEMORY_DEFAULT_POINTS 288                // History points returned by /api/memory when none are requested
+
+// Strip mirror (WebSocket "frames" topic)
+#define FRAME_MIRROR_HEADER_ROOM 14   // Bytes kept free before each mirrored frame for the WebSocket header
+#define FRAME_MIRROR_DEFAULT_FPS 10   // Frames per second for clients that don't ask for a rate
+#define FRAME_MIRROR_MAX_FPS 30       // Most frames per second sent to any one client
+
+// Tracing
+#define TRACE_BUFFER_SIZE 1024      // Begin/end events kept for /api/trace (power of two)
+#define TRACE_SLOW_THRESHOLD 500     // Per-loop calls (e.g. web server polling) are only traced when slower than this (microseconds)
+
+// Main loop. Sockets becoming readable (new data, a new connection, a peer closing) wake the loop as events, so
+// the only library deadlines that need a timed wake are WebServer's 2 s close wait and its and WebSocketsServer's
+// 5 s data and handshake timeouts. Waking once a second keeps each within a second of its deadline.
+#define LOOP_MAX_WAIT 1000          // Longest the loop sleeps without an event, so library timeouts still run (milliseconds)
+#define LOOP_NETWORK_ACK_WAIT 100   // Longest the network watcher waits for the loop to read its sockets (milliseconds)
+#define LOOP_SOCKET_RESCAN 1000     // Network watcher rebuilds its socket list at least this often (milliseconds)
+#define LOOP_BUSY_SOCKET_DELAY 10   // Wake delay when sockets are still readable after a pass (milliseconds)
+#define LOOP_STATS_WINDOW 10000     // Window for loop wakeup and busy time statistics (milliseconds)
+
+// Data freshness
+#define FRESHNESS_WINDOW_SIZE 120   // Snapshots in the rolling data-age window
+#define FRESHNESS_MIN_SAMPLES 10    // Snapshots needed before the freshness target is checked
+
+// Ingest modes
+#define INGEST_MODE_ROUTE "route"    // One trips-for-route request per mapped route
+#define INGEST_MODE_AGENCY "agency"  // One vehicles-for-agency request filtered to the mapped routes
+
+// Adaptive polling limits (seconds)
+#define MIN_POLL_INTERVAL 10         // Never poll faster than this, even when a train is about to arrive
+#define MAX_IDLE_POLL_INTERVAL 300   // Longest back-off when no trains are running
+#define POLL_ARRIVAL_MARGIN 2        // Poll this long after a train is expected to reach its station
+
+// Upstream feed phase locking (milliseconds)
+#define FEED_REFRESH_MARGIN 2000     // Poll this long after the upstream feed is expected to refresh
+#define FEED_MIN_PERIOD 5000         // Shortest upstream refresh period the scheduler will learn
+#define FEED_MAX_PERIOD 120000       // Longest upstream refresh period the scheduler will learn
 
 // Distance a train should be within to be considered at the station
 #define AT_STATION_THRESHOLD 10
 
+// Dead reckoning between polls
+#define PREDICTION_TICK_INTERVAL 1000  // Re-render predicted train positions this often (milliseconds)
+#define PREDICTED_DWELL_SECONDS 30     // Assumed time a train spends at a station before moving on
+#define STATION_TEST_DISPLAY_TIME 15000  // How long a station LED test stays on the strip (milliseconds)
+
+// Timelapse recording of the trains on the strip, for playback
+#define TIMELAPSE_BUFFER_SIZE (512 * 1024)            // PSRAM ring of recorded LED changes, several days of typical service
+#define TIMELAPSE_KEYFRAME_INTERVAL (10 * 60 * 1000)  // Full LED state recorded this often, so playback can start anywhere (milliseconds)
+#define TIMELAPSE_PLAYBACK_TICK 50                    // How often playback advances (milliseconds)
+#define TIMELAPSE_DEFAULT_SPEED 60                    // Playback speed when none is given, times real time
+#define TIMELAPSE_MAX_SPEED 3600
+
 // Preferences Keys
 #define PREF_NAMESPACE "linklight"
 #define PREF_API_KEY "apiKey"
@@ -35,9 +136,24 @@
 #define PREF_TIMEZONE "timezone"
 #define PREF_UPDATE_INTERVAL "updateInterval"
 #define PREF_AT_STATION_THRESHOLD "atStationThreshold"
+#define PREF_DAILY_API_BUDGET "dailyApiBudget"
+#define PREF_FRESHNESS_TARGET "freshnessTarget"
+#define PREF_RENDER_RATE "renderRate"
+#define PREF_BRIGHTNESS "brightness"
+#define PREF_NIGHT_BRIGHTNESS "nightBright"
+#define PREF_NIGHT_START "nightStart"
+#define PREF_NIGHT_END "nightEnd"
+#define PREF_STREAM_PROTOCOL "streamProto"
+#define PREF_STREAM_TARGETS "streamTargets"
+#define PREF_STREAM_RATE "streamRate"
+#define PREF_INGEST_MODE "ingestMode"
+#define PREF_ROUTE_LINES "routeLines"
+#define PREF_API_BASE_URL "apiBaseUrl"
 #define PREF_LINE1_COLOR "line1Color"
 #define PREF_LINE2_COLOR "line2Color"
 #define PREF_SHARED_COLOR "sharedColor"
+#define PREF_COLOR_SPACE "colorSpace"
+#define COLOR_SPACE_VERSION 1  // Saved colors are picked for the gamma-corrected strip; 0 means uncorrected
 #define MAX_PREFERENCE_LENGTH 64  // Maximum length for preference strings
 
 // Default Values
@@ -45,8 +161,21 @@
 #define DEFAULT_TIMEZONE "PST8PDT,M3.2.0,M11.1.0"  // Pacific Time with DST
 #define DEFAULT_UPDATE_INTERVAL 30  // Default update interval in seconds
 #define DEFAULT_AT_STATION_THRESHOLD 10  // Default at-station threshold in seconds
-#define DEFAULT_LINE1_COLOR "#28813F"  // Official SoundTransit green for Line 1
-#define DEFAULT_LINE2_COLOR "#007CAD"  // Official SoundTransit blue for Line 2
-#define DEFAULT_SHARED_COLOR "#232300"  // Yellow for shared/overlap
+#define DEFAULT_DAILY_API_BUDGET 6000  // Maximum API calls per day, 0 for unlimited
+#define DEFAULT_FRESHNESS_TARGET 45  // p95 data age at display to warn above, in seconds, 0 to disable
+#define DEFAULT_RENDER_RATE 30  // LED frames per second
+#define DEFAULT_BRIGHTNESS 100  // LED brightness in percent
+#define DEFAULT_NIGHT_BRIGHTNESS 30  // LED brightness in percent between the night start and end hours
+#define DEFAULT_NIGHT_START 22  // Local hour night brightness starts
+#define DEFAULT_NIGHT_END 7  // Local hour night brightness ends, the same as the start hour to disable
+#define DEFAULT_STREAM_PROTOCOL STREAM_PROTOCOL_OFF
+#define DEFAULT_STREAM_TARGETS ""  // Comma separated IP addresses, each with an optional :port
+#define DEFAULT_STREAM_RATE 30  // Most frames per second sent to stream targets
+#define DEFAULT_INGEST_MODE INGEST_MODE_ROUTE
+#define DEFAULT_ROUTE_LINES LINE_1_ROUTE_ID ":1," LINE_2_ROUTE_ID ":2"  // Route ID to line number mapping
+#define DEFAULT_API_BASE_URL API_BASE_URL
+#define DEFAULT_LINE1_COLOR "#6EBB87"  // Official SoundTransit green (#28813F) as the uncorrected strip showed it
+#define DEFAULT_LINE2_COLOR "#00B8D6"  // Official SoundTransit blue (#007CAD) as the uncorrected strip showed it
+#define DEFAULT_SHARED_COLOR "#808000"  // Yellow for shared/overlap
 
 #endif // CONFIG_H
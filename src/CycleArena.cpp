@@ -0,0 +1,143 @@
+#include "CycleArena.h"
+#include <string.h>
+#ifdef ARDUINO
+#include <esp_heap_caps.h>
+#include "MemoryPools.h"
+#include "LogManager.h"
+#else
+// Host builds (the arena_replay PlatformIO environment) get the heap and logging from the replay's model of the
+// PSRAM heap
+#include "HostHeap.h"
+#endif
+
+static const char* LOG_TAG = "CycleArena";
+
+// Every allocation is preceded by its size so reallocate() knows how much to copy
+static const size_t ALIGNMENT = 8;
+static const size_t HEADER_SIZE = ALIGNMENT;
+
+static size_t alignUp(size_t size) {
+  return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+static size_t& blockSize(void* ptr) {
+  return *reinterpret_cast<size_t*>(static_cast<uint8_t*>(ptr) - HEADER_SIZE);
+}
+
+void* CycleArena::allocate(size_t size, bool* fellBack) {
+  if (fellBack != nullptr) {
+    *fellBack = false;
+  }
+
+  if (base == nullptr && capacity > 0) {
+    base = static_cast<uint8_t*>(MemoryPools::allocate(MemoryPool::BULK_PSRAM, capacity));
+    if (base == nullptr) {
+      LINK_LOGE(LOG_TAG, "Failed to allocate %u byte arena, using the heap instead", (unsigned)capacity);
+      capacity = 0;
+    }
+  }
+
+  size_t needed = HEADER_SIZE + alignUp(size);
+  if (base != nullptr && needed <= capacity - offset) {
+    lastOffset = offset;
+    uint8_t* ptr = base + offset + HEADER_SIZE;
+    offset += needed;
+    if (offset > highWater) {
+      highWater = offset;
+    }
+    blockSize(ptr) = size;
+    return ptr;
+  }
+
+  // Out of arena space this cycle, so fall back to the bulk PSRAM pool like PSRAMJsonAllocator does
+  overflowCount++;
+  liveOverflows++;
+  return MemoryPools::allocate(MemoryPool::BULK_PSRAM, size, fellBack);
+}
+
+void CycleArena::deallocate(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  if (!owns(ptr)) {
+    liveOverflows--;
+    MemoryPools::deallocate(MemoryPool::BULK_PSRAM, ptr);
+    return;
+  }
+
+  // Give the space back if this was the most recent allocation, otherwise it's reclaimed on reset
+  size_t blockOffset = static_cast<uint8_t*>(ptr) - base - HEADER_SIZE;
+  if (blockOffset == lastOffset) {
+    offset = blockOffset;
+    lastOffset = SIZE_MAX;
+  }
+}
+
+void* CycleArena::reallocate(void* ptr, size_t newSize, bool* fellBack) {
+  if (ptr == nullptr) {
+    return allocate(newSize, fellBack);
+  }
+
+  if (!owns(ptr)) {
+    return MemoryPools::reallocate(MemoryPool::BULK_PSRAM, ptr, newSize, fellBack);
+  }
+  if (fellBack != nullptr) {
+    *fellBack = false;
+  }
+
+  size_t oldSize = blockSize(ptr);
+  size_t blockOffset = static_cast<uint8_t*>(ptr) - base - HEADER_SIZE;
+
+  // The most recent allocation can grow or shrink in place
+  if (blockOffset == lastOffset && HEADER_SIZE + alignUp(newSize) <= capacity - blockOffset) {
+    offset = blockOffset + HEADER_SIZE + alignUp(newSize);
+    if (offset > highWater) {
+      highWater = offset;
+    }
+    blockSize(ptr) = newSize;
+    return ptr;
+  }
+
+  // Shrinking anything else keeps the block where it is
+  if (newSize <= oldSize) {
+    blockSize(ptr) = newSize;
+    return ptr;
+  }
+
+  void* newPtr = allocate(newSize, fellBack);
+  if (newPtr != nullptr) {
+    memcpy(newPtr, ptr, oldSize);
+  }
+  return newPtr;
+}
+
+size_t CycleArena::allocationSize(void* ptr) const {
+  if (!owns(ptr)) {
+    return heap_caps_get_allocated_size(ptr);
+  }
+  return blockSize(ptr);
+}
+
+const char* CycleArena::copyString(const char* str) {
+  if (str == nullptr) {
+    return "";
+  }
+
+  size_t length = strlen(str);
+  char* copy = static_cast<char*>(allocate(length + 1));
+  if (copy == nullptr) {
+    return "";
+  }
+  memcpy(copy, str, length + 1);
+  return copy;
+}
+
+void CycleArena::reset() {
+  if (liveOverflows > 0) {
+    LINK_LOGW(LOG_TAG, "%u heap fallback allocations still live at reset", (unsigned)liveOverflows);
+  }
+
+  offset = 0;
+  lastOffset = SIZE_MAX;
+}
@@ -0,0 +1,43 @@
+#include "FrameMirror.h"
+#include <stddef.h>
+
+// The header is written in place right before the pixels, which go out as packed RGB bytes
+static_assert(offsetof(MirrorBuffer, frame) == FRAME_MIRROR_HEADER_ROOM, "MirrorBuffer header must precede the frame");
+static_assert(sizeof(RgbColor) == 3, "RgbColor must be 3 packed bytes to mirror frames without copying");
+
+FrameMirror frameMirror;
+
+LEDFrame& FrameMirror::beginWrite() {
+  portENTER_CRITICAL(&lock);
+  for (int i = 0; i < 3; i++) {
+    if (i != latest && i != reading) {
+      writing = i;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&lock);
+  return buffers[writing].frame;
+}
+
+void FrameMirror::publish(uint16_t ledCount) {
+  portENTER_CRITICAL(&lock);
+  latest = writing;
+  latestLedCount = ledCount;
+  seq++;
+  portEXIT_CRITICAL(&lock);
+}
+
+MirrorBuffer* FrameMirror::acquire(uint16_t& ledCount, uint32_t& frameSeq) {
+  portENTER_CRITICAL(&lock);
+  reading = latest;
+  ledCount = latestLedCount;
+  frameSeq = seq;
+  portEXIT_CRITICAL(&lock);
+  return reading >= 0 ? &buffers[reading] : nullptr;
+}
+
+void FrameMirror::release() {
+  portENTER_CRITICAL(&lock);
+  reading = -1;
+  portEXIT_CRITICAL(&lock);
+}
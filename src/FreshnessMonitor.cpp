@@ -0,0 +1,115 @@
+#include "FreshnessMonitor.h"
+#include <algorithm>
+#include "LogManager.h"
+#include "PreferencesManager.h"
+
+static const char* LOG_TAG = "FreshnessMonitor";
+
+FreshnessMonitor freshnessMonitor;
+
+void FreshnessMonitor::recordPublished(uint32_t mergeSeq, int64_t upstreamTime, bool feedRefreshKnown, uint32_t feedRefreshMillis) {
+  portENTER_CRITICAL(&lock);
+  latest = FreshnessStamps();
+  latest.mergeSeq = mergeSeq;
+  latest.upstreamTime = upstreamTime;
+  latest.feedRefreshKnown = feedRefreshKnown;
+  latest.feedRefreshMillis = feedRefreshMillis;
+  latest.fetchCompleteMillis = millis();
+  portEXIT_CRITICAL(&lock);
+}
+
+void FreshnessMonitor::recordDisplayed() {
+  uint32_t now = millis();
+  bool sampled = false;
+
+  portENTER_CRITICAL(&lock);
+  // Only the first display of a snapshot counts, later frames are dead-reckoned from it
+  if (latest.fetchCompleteMillis != 0 && latest.ledShownMillis == 0) {
+    latest.ledShownMillis = now;
+    if (latest.feedRefreshKnown) {
+      addAge(displayAges, now - latest.feedRefreshMillis);
+      sampled = true;
+    }
+  }
+  portEXIT_CRITICAL(&lock);
+
+  if (sampled) {
+    checkTarget();
+  }
+}
+
+void FreshnessMonitor::recordBroadcast() {
+  uint32_t now = millis();
+
+  portENTER_CRITICAL(&lock);
+  if (latest.fetchCompleteMillis != 0 && latest.broadcastMillis == 0) {
+    latest.broadcastMillis = now;
+    if (latest.feedRefreshKnown) {
+      addAge(broadcastAges, now - latest.feedRefreshMillis);
+    }
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+void FreshnessMonitor::addAge(AgeWindow& window, uint32_t ageMs) {
+  window.agesMs[window.next] = ageMs;
+  window.next = (window.next + 1) % FRESHNESS_WINDOW_SIZE;
+  if (window.count < FRESHNESS_WINDOW_SIZE) {
+    window.count++;
+  }
+}
+
+FreshnessStamps FreshnessMonitor::getLatestStamps() const {
+  portENTER_CRITICAL(&lock);
+  FreshnessStamps copy = latest;
+  portEXIT_CRITICAL(&lock);
+  return copy;
+}
+
+FreshnessSummary FreshnessMonitor::getDisplayAgeSummary() const {
+  return summarize(displayAges);
+}
+
+FreshnessSummary FreshnessMonitor::getBroadcastAgeSummary() const {
+  return summarize(broadcastAges);
+}
+
+// Sorts a copy of the window, which is small enough that this is cheaper than keeping a sketch
+FreshnessSummary FreshnessMonitor::summarize(const AgeWindow& window) const {
+  uint32_t sorted[FRESHNESS_WINDOW_SIZE];
+  portENTER_CRITICAL(&lock);
+  size_t count = window.count;
+  memcpy(sorted, window.agesMs, count * sizeof(uint32_t));
+  portEXIT_CRITICAL(&lock);
+
+  FreshnessSummary summary;
+  summary.samples = count;
+  if (count == 0) {
+    return summary;
+  }
+
+  std::sort(sorted, sorted + count);
+  summary.p50Ms = sorted[(count - 1) * 50 / 100];
+  summary.p95Ms = sorted[(count - 1) * 95 / 100];
+  summary.maxMs = sorted[count - 1];
+  return summary;
+}
+
+// Logs when the p95 age at display crosses the target in either direction, rather than on every sample
+void FreshnessMonitor::checkTarget() {
+  unsigned int targetSeconds = preferencesManager.getFreshnessTarget();
+  FreshnessSummary summary = getDisplayAgeSummary();
+  if (targetSeconds == 0 || summary.samples < FRESHNESS_MIN_SAMPLES) {
+    targetBreached = false;
+    return;
+  }
+
+  bool breached = summary.p95Ms > targetSeconds * 1000;
+  if (breached && !targetBreached) {
+    LINK_LOGW(LOG_TAG, "Data freshness target missed: p95 age at display %lu ms exceeds %u s (p50 %lu ms, max %lu ms)",
+              (unsigned long)summary.p95Ms, targetSeconds, (unsigned long)summary.p50Ms, (unsigned long)summary.maxMs);
+  } else if (!breached && targetBreached) {
+    LINK_LOGI(LOG_TAG, "Data freshness target met again: p95 age at display %lu ms", (unsigned long)summary.p95Ms);
+  }
+  targetBreached = breached;
+}
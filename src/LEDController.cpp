@@ -5,259 +5,375 @@
 #include "PreferencesManager.h"
 #include <ArduinoJson.h>
 #include "PSRAMJsonAllocator.h"
+#include "PerfMonitor.h"
+#include "FreshnessMonitor.h"
 
 static const char* LOG_TAG = "LEDController";
 
-// Row definitions shared by logTrainCounts() and getLEDStateAsJson().
-struct LEDRowDef {
-  const char* label;
-  const char* logPrefix;
-  int start;
-  int end;
-  bool descending;
-};
-
-// The extra spaces in the Line 2 log prefixes are intentional and align the digits with how things look
-// on the physical LED layout, with the between-station LEDs between Judkins Park and ID/Chinatown
-// aligning above ID/Chinatown.
-static const LEDRowDef LED_ROW_DEFS[] = {
-  { "Line 2 northbound", "Line 2 northbound:       ", 159, 135, true  },
-  { "Line 2 southbound", "Line 2 southbound:       ", 110, 134, false },
-  { "Line 1 northbound", "Line 1 northbound: ",       109,  55, true  },
-  { "Line 1 southbound", "Line 1 southbound: ",         0,  54, false },
-};
-
 LEDController ledController;
 
-void LEDController::initializeStationMaps() {
-  // Indexes are origin 0.
-  // {northboundIndex, northboundEnrouteIndex, southboundIndex, southboundEnrouteIndex}
-  // 1 and 2 Line stations
-  stationMap["Lynnwood City Center"] =    {108, 107, 1, 0};
-  stationMap["Mountlake Terrace"] =       {106, 105, 3, 2};
-  stationMap["Shoreline North/185th"] =   {104, 103, 5, 4};
-  stationMap["Shoreline South/148th"] =   {102, 101, 7, 6};
-  stationMap["Pinehurst"] =               {100, 99, 9, 8};
-  stationMap["Northgate"] =               {98, 97, 11, 10};
-  stationMap["Roosevelt"] =               {96, 95, 13, 12};
-  stationMap["U District"] =              {94, 93, 15, 14};
-  stationMap["Univ of Washington"] =      {92, 91, 17, 16};
-  stationMap["Capitol Hill"] =            {90, 89, 19, 18};
-  stationMap["Westlake"] =                {88, 87, 21, 20};
-  stationMap["Symphony"] =                {86, 85, 23, 22};
-  stationMap["Pioneer Square"] =          {84, 83, 25, 24};
-  stationMap["Int'l Dist/Chinatown"] =    {82, 81, 27, 26};
-
-  // 1 Line stations
-  stationMap["Stadium"] =                 {80, 79, 29, 28};
-  stationMap["SODO"] =                    {78, 77, 31, 30};
-  stationMap["Beacon Hill"] =             {76, 75, 33, 32};
-  stationMap["Mount Baker"] =             {74, 73, 35, 34};
-  stationMap["Columbia City"] =           {72, 71, 37, 36};
-  stationMap["Othello"] =                 {70, 69, 39, 38};
-  stationMap["Rainier Beach"] =           {68, 67, 41, 40};
-  stationMap["Tukwila Int'l Blvd"] =      {66, 65, 43, 42};
-  stationMap["SeaTac/Airport"] =          {64, 63, 45, 44};
-  stationMap["Angle Lake"] =              {62, 61, 47, 46};
-  stationMap["Kent Des Moines"] =         {60, 59, 49, 48};
-  stationMap["Star Lake"] =               {58, 57, 51, 50};
-  stationMap["Federal Way Downtown"] =    {56, 55, 53, 52};
-
-  // 2 Line stations
-  // These stations have the "southbound" train positions in the top LED strip
-  // and the "northbound" train positions in the bottom LED strip so things look right.
-  // At some point I'll rename northbound/southbound to be outbound/inbound or something more
-  // direction-agnostic to avoid confusion.
-  stationMap["Downtown Redmond"] =        {111, 110, 158, 157};
-  stationMap["Marymoor Village"] =        {113, 112, 156, 155};
-  stationMap["Redmond Technology"] =      {115, 114, 154, 153};
-  stationMap["Overlake Village"] =        {117, 116, 152, 151};
-  stationMap["BelRed"] =                  {119, 118, 150, 149};
-  stationMap["Spring District"] =         {121, 120, 148, 147};
-  stationMap["Wilburton"] =               {123, 122, 146, 145};
-  stationMap["Bellevue Downtown"] =       {125, 124, 144, 143};
-  stationMap["East Main"] =               {127, 126, 142, 141};
-  stationMap["South Bellevue"] =          {129, 128, 140, 139};
-  stationMap["Mercer Island"] =           {131, 130, 138, 137};
-  stationMap["Judkins Park"] =            {133, 132, 136, 135};
-}
-
 void LEDController::setup() {
   LINK_LOGD(LOG_TAG, "Setting up LEDs...");
   
-  strip.Begin();
-  strip.Show(); // Initialize all pixels to 'off'
-  
-  // Initialize station maps
-  initializeStationMaps();
+  ledRenderer.setup(ledLayout.getLedCount());
 }
 
 void LEDController::startupAnimation() {
   const int delayMs = 10;  // Delay between each color
 
-  // Light up each LED in sequence, concurrently from each end of the strip.
-  for (int i = 0; i < LED_COUNT; i++) {
-    strip.SetPixelColor(i, COLOR_BLUE);
-    strip.SetPixelColor(LED_COUNT - 1 - i, COLOR_GREEN);
-    strip.Show();
+  // Light up each LED in sequence, concurrently from each end of the strip. Runs before the render task starts.
+  int ledCount = ledLayout.getLedCount();
+  LEDFrame frame;
+  for (int i = 0; i < ledCount; i++) {
+    frame.pixels[i] = COLOR_BLUE;
+    frame.pixels[ledCount - 1 - i] = COLOR_GREEN;
+    ledRenderer.showImmediately(frame);
     delay(delayMs);
-    strip.SetPixelColor(i, COLOR_BLACK);
-    strip.SetPixelColor(LED_COUNT - 1 - i, COLOR_BLACK);
-    strip.Show();
+    frame.pixels[i] = COLOR_BLACK;
+    frame.pixels[ledCount - 1 - i] = COLOR_BLACK;
+    ledRenderer.showImmediately(frame);
   }
 
   LINK_LOGD(LOG_TAG, "LEDs initialized");
 }
 
-void LEDController::setAllLEDs(const RgbColor& color) {
-  for (int i = 0; i < LED_COUNT; i++) {
-    strip.SetPixelColor(i, color);
+// Draws the tracker into a new target frame for the render task. Every change is also recorded for timelapse
+// playback, which keeps going while playback has the strip.
+void LEDController::publishTrainTracker() {
+  uint16_t ledCount = ledLayout.getLedCount();
+  uint8_t masks[MAX_LED_COUNT];
+  for (uint16_t i = 0; i < ledCount; i++) {
+    masks[i] = trainTracker.getLineMask(i);
+  }
+  timelapseRecorder.record(masks, ledCount, millis());
+
+  if (playing) {
+    return;
+  }
+  LEDFrame frame;
+  trainTracker.render(frame);
+  publishFrame(frame);
+}
+
+// Hands a frame to the render task, marking station LEDs so arrivals pulse
+void LEDController::publishFrame(LEDFrame& frame) {
+  memcpy(frame.flags, ledLayout.getLEDFlags(), ledLayout.getLedCount());
+  ledRenderer.publish(frame);
+}
+
+bool LEDController::startPlayback(float hours, uint16_t speed) {
+  uint32_t now = millis();
+  uint32_t fromMillis = now - (uint32_t)(hours * 3600000.0f);
+  TimelapseCursor cursor;
+  if (!timelapseRecorder.seek(fromMillis, cursor)) {
+    LINK_LOGW(LOG_TAG, "Nothing recorded to play back yet");
+    return false;
   }
+
+  // Start from the keyframe at or before the requested time, or the oldest one kept if the recording is shorter
+  playbackCursor = cursor;
+  playbackFromMillis = (int32_t)(cursor.millis - fromMillis) > 0 ? cursor.millis : fromMillis;
+  playbackShownMillis = playbackFromMillis;
+  playbackStartMillis = now;
+  playbackSpeed = speed;
+  memset(playbackMasks, 0, sizeof(playbackMasks));
+  timelapseRecorder.replay(playbackCursor, playbackFromMillis, playbackMasks, ledLayout.getLedCount());
+  playing = true;
+
+  LINK_LOGI(LOG_TAG, "Playing back the last %.1f hours at %ux", (now - playbackFromMillis) / 3600000.0f, speed);
+  LEDFrame frame;
+  LEDTrainTracker::renderLineMasks(playbackMasks, frame);
+  publishFrame(frame);
+  return true;
+}
+
+void LEDController::stopPlayback() {
+  if (!playing) {
+    return;
+  }
+  playing = false;
+  LINK_LOGI(LOG_TAG, "Playback stopped, showing live trains");
+
+  // The tracker kept following the live trains, so it only needs drawing again
+  LEDFrame frame;
+  trainTracker.render(frame);
+  publishFrame(frame);
 }
 
-int LEDController::getTrainLEDIndex(const TrainData& train) const {
+uint32_t LEDController::getPlaybackSecondsAgo() const {
+  return playing ? (playbackStartMillis - playbackShownMillis) / 1000 : 0;
+}
+
+uint32_t LEDController::updatePlayback() {
+  if (!playing) {
+    return UINT32_MAX;
+  }
+
+  // Play up to when playback started, so it ends rather than chasing what's recorded meanwhile
+  uint32_t now = millis();
+  uint64_t advance = (uint64_t)(now - playbackStartMillis) * playbackSpeed;
+  uint32_t length = playbackStartMillis - playbackFromMillis;
+  bool finished = advance >= length;
+  uint32_t untilMillis = playbackFromMillis + (finished ? length : (uint32_t)advance);
+
+  int applied = timelapseRecorder.replay(playbackCursor, untilMillis, playbackMasks, ledLayout.getLedCount());
+  playbackShownMillis = untilMillis;
+  if (applied < 0) {
+    LINK_LOGW(LOG_TAG, "Playback fell behind the recording buffer");
+    stopPlayback();
+    return UINT32_MAX;
+  }
+  if (applied > 0) {
+    LEDFrame frame;
+    LEDTrainTracker::renderLineMasks(playbackMasks, frame);
+    publishFrame(frame);
+  }
+  if (finished) {
+    stopPlayback();
+    return UINT32_MAX;
+  }
+  return TIMELAPSE_PLAYBACK_TICK;
+}
+
+int LEDController::getTrainLEDIndex(const TrainData& train, bool logMissing) const {
   int ledIndex = -1;
 
   // Determine if train is northbound or southbound
   bool isNorthbound = (train.direction == TrainDirection::NORTHBOUND);
 
-  // Start by processing trains at stations. The mapping logic is simple: figure out what the closest station is,
-  // find it in the station map, then light the corresponding LED based on the direction of travel.
+  // Start by processing trains at stations. The mapping logic is simple: the poll already found the closest
+  // station's ordinal in the layout, so light its LED for the direction of travel.
   if (train.state == TrainState::AT_STATION)
   {
-    auto closestStationInfo = stationMap.find(train.closestStopName);
-    if (closestStationInfo == stationMap.end()) {
-      LINK_LOGW(LOG_TAG, "Closest station '%s' not found in Line 1 map", train.closestStopName.c_str());
-      return 0; // Default to lighting the first LED if station not found, to at least indicate presence of train.
+    if (train.closestStopOrdinal < 0) {
+      if (logMissing) {
+        LINK_LOGW(LOG_TAG, "Closest station '%s' not found in LED layout", train.closestStopName.c_str());
+      }
+      return -1;
     }
-
-    // Get the LED data for the closest station
-    const StationLEDMapping& closestMapping = closestStationInfo->second;
-
-    ledIndex = isNorthbound ? closestMapping.northboundIndex : closestMapping.southboundIndex;
+    ledIndex = ledLayout.getStationLED(train.closestStopOrdinal, isNorthbound);
   }    
   // If train is moving between stations, light the LED that is one position closer to the next station.
+  // Special cases, like Line 2 trains heading to Int'l Dist/Chinatown before the cross-lake connection
+  // opens, are en-route overrides in the layout.
   else if (train.state == TrainState::MOVING) {
-    auto nextStationInfo = stationMap.find(train.nextStopName);
-    if (nextStationInfo == stationMap.end()) {
-      LINK_LOGW(LOG_TAG, "Next station '%s' not found in Line 1 map", train.nextStopName.c_str());
-      return 0; // Default to lighting the first LED if station not found, to at least indicate presence of train.
-    }
-
-    const StationLEDMapping& nextMapping = nextStationInfo->second;
-
-    // TODO: Remove this special case once the cross-lake connection is built.
-    // Northbound Line 2 trains heading to Int'l Dist/Chinatown should show at the LED after Judkins Park
-    // rather than the LED south of Intl' Dist/Chinatown.
-    if (train.line == Line::LINE_2 && isNorthbound && train.nextStopName == "Int'l Dist/Chinatown") {
-      ledIndex = 134; // The special LED that's just after the Judkins Park LED on the northbound strip
-    } else {
-      ledIndex = isNorthbound ? nextMapping.northboundEnrouteIndex : nextMapping.southboundEnrouteIndex;
+    if (train.nextStopOrdinal < 0) {
+      if (logMissing) {
+        LINK_LOGW(LOG_TAG, "Next station '%s' not found in LED layout", train.nextStopName.c_str());
+      }
+      return -1;
     }
+    ledIndex = ledLayout.getEnrouteLED(train.nextStopOrdinal, train.line, isNorthbound);
   }
 
   // Ensure the index is within valid bounds
-  if (ledIndex < 0 || ledIndex >= LED_COUNT) {
-    LINK_LOGW(LOG_TAG, "LED index %d out of bounds for vehicle %s", ledIndex, train.vehicleId.c_str());
-    ledIndex = 0; // Default to first LED if out of bounds, to at least indicate presence of train.
+  if (ledIndex < 0 || ledIndex >= ledLayout.getLedCount()) {
+    if (logMissing) {
+      LINK_LOGW(LOG_TAG, "LED index %d out of bounds for vehicle %s", ledIndex, train.vehicleId.c_str());
+    }
+    ledIndex = -1;
   }
 
   return ledIndex;
 }
 
-void LEDController::displayTrainPositions() {
+// Dead-reckons a train forward from its last poll. Offsets are aged by the local time since the response arrived:
+// a MOVING train switches to its next station's LED once it crosses the at-station threshold, and any train that
+// has been at a station longer than PREDICTED_DWELL_SECONDS moves on to the en-route LED of its line's following
+// stop. The next poll replaces the offsets, so any disagreement with the prediction corrects itself on the next
+// render.
+int LEDController::getPredictedLEDIndex(const TrainData& train, uint32_t nowMillis, bool logMissing) const {
+  int elapsedSeconds = (int)((nowMillis - train.snapshotMillis) / 1000);
+  int secondsSinceArrival = elapsedSeconds - train.nextStopTimeOffset;
+  int atStationThreshold = (int)preferencesManager.getAtStationThreshold();
+
+  // Still on the way to the next station
+  if (secondsSinceArrival <= -atStationThreshold) {
+    return getTrainLEDIndex(train, logMissing);
+  }
+
+  // At the station: either the poll said so, or the train has since reached its next stop
+  bool northbound = train.direction == TrainDirection::NORTHBOUND;
+  bool polledAtStation = train.state == TrainState::AT_STATION;
+  int stationOrdinal = polledAtStation ? train.closestStopOrdinal : train.nextStopOrdinal;
+  int stationIndex = polledAtStation ? getTrainLEDIndex(train, logMissing) : ledLayout.getStationLED(stationOrdinal, northbound);
+  if (stationIndex < 0) {
+    return getTrainLEDIndex(train, logMissing);
+  }
+  if (secondsSinceArrival < PREDICTED_DWELL_SECONDS) {
+    return stationIndex;
+  }
+
+  // Departed. Lines don't always continue along the station's row (Line 2 leaves Int'l Dist/Chinatown for
+  // Judkins Park), so the next LED comes from the stop order in the layout. At the end of the line, or without
+  // one, the train stays on the station LED until the next poll.
+  int followingOrdinal = ledLayout.getFollowingStop(stationOrdinal, train.line, northbound);
+  int departedIndex = ledLayout.getEnrouteLED(followingOrdinal, train.line, northbound);
+  return departedIndex >= 0 ? departedIndex : stationIndex;
+}
+
+// Rebuilds the tracker from the current train list and returns a signature of which trains are on which LEDs.
+// Trains whose station isn't in the layout are left off; logDetails is only set after a poll, so they are
+// warned about once per poll.
+uint32_t LEDController::updateTrainTracker(bool logDetails) {
+  PERF_SCOPE(PerfStage::LED_UPDATE);
   // Reset train counts
   trainTracker.reset();
   
   // Get focused vehicle ID (if any)
   String focusedVehicleId = preferencesManager.getFocusedVehicleId();
+  uint32_t nowMillis = millis();
+  uint32_t signature = 2166136261u;  // FNV-1a offset basis
   
   // Process each train and update the tracker, holding the mutex for thread-safe access
-  if (trainDataManager.dataMutex) xSemaphoreTake(trainDataManager.dataMutex, portMAX_DELAY);
-  const esp32_psram::VectorPSRAM<TrainData>& trains = trainDataManager.getTrainDataList();
-  for (const TrainData& train : trains) {
+  trainDataManager.lockData();
+  trainDataManager.getVehicleTable().forEach([&](const TrainData& train) {
     // If a focused train is set, skip all other trains
     if (!focusedVehicleId.isEmpty() && train.vehicleId != focusedVehicleId) {
-      continue;
+      return;
     }
     
-    int ledIndex = getTrainLEDIndex(train);
+    int ledIndex = getPredictedLEDIndex(train, nowMillis, logDetails);
     
     if (ledIndex >= 0) {
       // Record this train at its LED index
       trainTracker.addTrain(ledIndex, train.line, train.vehicleId);
+
+      signature = (signature ^ (uint32_t)ledIndex) * 16777619u;
+      for (const char* c = train.vehicleId.c_str(); *c; c++) {
+        signature = (signature ^ (uint8_t)*c) * 16777619u;
+      }
       
-      LINK_LOGD(LOG_TAG, "Train %s at LED %d (closest: %s, next: %s, state: %s, dir: %s, line: %d)", 
-                train.vehicleId.c_str(), ledIndex, 
-                train.closestStopName.c_str(),
-                train.nextStopName.c_str(),
-              train.state == TrainState::AT_STATION ? "AT_STATION" : "MOVING",
-                train.direction == TrainDirection::NORTHBOUND ? "Northbound" : "Southbound",
-                static_cast<int>(train.line));
+      if (logDetails) {
+        LINK_LOGD(LOG_TAG, "Train %s at LED %d (closest: %s, next: %s, state: %s, dir: %s, line: %d)", 
+                  train.vehicleId.c_str(), ledIndex, 
+                  train.closestStopName.c_str(),
+                  train.nextStopName.c_str(),
+                  train.state == TrainState::AT_STATION ? "AT_STATION" : "MOVING",
+                  train.direction == TrainDirection::NORTHBOUND ? "Northbound" : "Southbound",
+                  static_cast<int>(train.line));
+      }
+    }
+  });
+  trainDataManager.unlockData();
+
+  return signature;
+}
+
+bool LEDController::refreshPredictedPositions() {
+  if (stationTestActive) {
+    if (millis() - stationTestStartMillis < STATION_TEST_DISPLAY_TIME) {
+      return false;
     }
+    stationTestActive = false;
+    displayedSignature = 0;
   }
-  if (trainDataManager.dataMutex) xSemaphoreGive(trainDataManager.dataMutex);
+
+  uint32_t renderStart = micros();
+  uint32_t signature = updateTrainTracker(false);
+  if (signature == displayedSignature) {
+    recordRenderTime(renderStart);
+    return false;
+  }
+
+  displayedSignature = signature;
+  publishTrainTracker();
+  recordRenderTime(renderStart);
+  return true;
+}
+
+// Tracks the time for one prediction frame. The poll-driven render is left out since it also logs every train.
+void LEDController::recordRenderTime(uint32_t startMicros) {
+  lastRenderMicros = micros() - startMicros;
+  if (averageRenderMicros == 0) {
+    averageRenderMicros = lastRenderMicros;
+  } else {
+    averageRenderMicros += ((int32_t)lastRenderMicros - (int32_t)averageRenderMicros) / 16;
+  }
+}
+
+bool LEDController::displayTrainPositions() {
+  bool wasStationTest = stationTestActive;
+  stationTestActive = false;
+  uint32_t signature = updateTrainTracker(true);
   
   // Log train counts for debugging
   logTrainCounts();
   
-  // Display all trains on the LED strip
-  trainTracker.display(strip);
+  // Display all trains on the LED strip, unless the poll didn't move any train to a different LED
+  bool changed = signature != displayedSignature || wasStationTest;
+  if (changed) {
+    displayedSignature = signature;
+    publishTrainTracker();
+  } else {
+    LINK_LOGD(LOG_TAG, "No LED changes, skipping redraw");
+  }
+
+  // Record how stale the data was by the time it reached the LEDs
+  displayedDataAgeMs = trainDataManager.getDataAgeMs();
+  freshnessMonitor.recordDisplayed();
+  if (displayedDataAgeMs >= 0) {
+    LINK_LOGD(LOG_TAG, "Displayed data age: %ld ms", (long)displayedDataAgeMs);
+  }
+
+  return changed;
+}
+
+void LEDController::refreshColors() {
+  // A station test pattern on the strip picks up the new colors when predictions take over again
+  if (stationTestActive) {
+    return;
+  }
+  publishTrainTracker();
 }
 
 void LEDController::testStationLEDs(const String& stationName) {
   LINK_LOGI(LOG_TAG, "Testing LEDs for station: %s", stationName.c_str());
   
-  // Find the station in the map
-  auto stationInfo = stationMap.find(stationName);
-  if (stationInfo == stationMap.end()) {
-    LINK_LOGW(LOG_TAG, "Station '%s' not found in station map", stationName.c_str());
+  // Find the station in the layout
+  int ordinal = ledLayout.findStation(stationName.c_str());
+  if (ordinal < 0) {
+    LINK_LOGW(LOG_TAG, "Station '%s' not found in LED layout", stationName.c_str());
     return;
   }
   
   // Turn off all LEDs first
-  setAllLEDs(COLOR_BLACK);
+  LEDFrame frame;
+  frame.fill(COLOR_BLACK);
   
   // Get the LED indices for this station
-  const StationLEDMapping& mapping = stationInfo->second;
+  const StationLEDMapping& mapping = ledLayout.getStation(ordinal).leds;
   
-  // Light up the northbound and southbound LEDs
-  if (mapping.northboundIndex >= 0 && mapping.northboundIndex < LED_COUNT) {
-    strip.SetPixelColor(mapping.northboundIndex, COLOR_GREEN);
-    LINK_LOGD(LOG_TAG, "Northbound LED at index %d", mapping.northboundIndex);
-  }
+  // Light up the northbound and southbound LEDs. The layout was validated on load, so all four are on the strip.
+  frame.pixels[mapping.northboundIndex] = COLOR_GREEN;
+  LINK_LOGD(LOG_TAG, "Northbound LED at index %d", mapping.northboundIndex);
 
-  if (mapping.northboundEnrouteIndex >= 0 && mapping.northboundEnrouteIndex < LED_COUNT) {
-    strip.SetPixelColor(mapping.northboundEnrouteIndex, COLOR_YELLOW);
-    LINK_LOGD(LOG_TAG, "Northbound enroute LED at index %d", mapping.northboundEnrouteIndex);
-  }
+  frame.pixels[mapping.northboundEnrouteIndex] = COLOR_YELLOW;
+  LINK_LOGD(LOG_TAG, "Northbound enroute LED at index %d", mapping.northboundEnrouteIndex);
 
-  if (mapping.southboundIndex >= 0 && mapping.southboundIndex < LED_COUNT) {
-    strip.SetPixelColor(mapping.southboundIndex, COLOR_BLUE);
-    LINK_LOGD(LOG_TAG, "Southbound LED at index %d", mapping.southboundIndex);
-  }
+  frame.pixels[mapping.southboundIndex] = COLOR_BLUE;
+  LINK_LOGD(LOG_TAG, "Southbound LED at index %d", mapping.southboundIndex);
 
-  if (mapping.southboundEnrouteIndex >= 0 && mapping.southboundEnrouteIndex < LED_COUNT) {
-    strip.SetPixelColor(mapping.southboundEnrouteIndex, COLOR_YELLOW);
-    LINK_LOGD(LOG_TAG, "Southbound enroute LED at index %d", mapping.southboundEnrouteIndex);
-  }
+  frame.pixels[mapping.southboundEnrouteIndex] = COLOR_YELLOW;
+  LINK_LOGD(LOG_TAG, "Southbound enroute LED at index %d", mapping.southboundEnrouteIndex);
 
-  // Update the strip
-  strip.Show();
-}
+  // Hand the test pattern to the render task
+  ledRenderer.publish(frame);
 
-const std::map<String, StationLEDMapping>& LEDController::getStationMap() const {
-  return stationMap;
+  // Hold the test pattern for a while before predicted positions take over again
+  stationTestStartMillis = millis();
+  stationTestActive = true;
 }
 
-// Logs the train counts in four rows, one for each LED segment of the physical layout.
+// Logs the train counts one row per LED segment of the physical layout, e.g. for the four rows of the default layout:
 // 00:16:43[I] LEDController:Line 2 northbound:       0 0 0 0 1 0 0 0 0 0 0 0 1 0 0 0 0 0 0 0 1 0 0 0 0
 // 00:16:43[I] LEDController:Line 2 southbound:       1 0 1 0 1 0 0 0 0 0 0 0 0 0 0 0 1 0 1 1 0 0 0 0 0
 // 00:16:43[I] LEDController:Line 1 northbound: 0 1 1 1 3 0 1 0 3 0 0 0 2 1 1 0 2 0 1 1 0 0 1 0 0 1 0 0 2 0 1 0 1 0 0 0 0 0 1 0 0 0 1 0 0 0 0 0 1 0 0 0 1 0 0
 // 00:16:43[I] LEDController:Line 1 southbound: 0 1 0 0 1 0 1 0 0 0 0 1 1 0 0 0 1 0 1 0 1 0 1 1 0 1 1 1 0 0 1 0 1 0 0 0 1 0 0 0 1 0 0 0 1 0 1 0 0 0 1 0 1 0 0
 void LEDController::logTrainCounts() const {
-  // Iterate over all four physical LED rows and log the count of trains at each LED position.
-  for (const LEDRowDef& row : LED_ROW_DEFS) {
+  // Iterate over the physical LED rows and log the count of trains at each LED position.
+  for (size_t rowIndex = 0; rowIndex < ledLayout.getRowCount(); rowIndex++) {
+    const LayoutRow& row = ledLayout.getRow(rowIndex);
     String log = row.logPrefix;
 
     // Walk the LEDs in the correct direction for this row (descending or ascending index).
@@ -274,15 +390,16 @@ void LEDController::logTrainCounts() const {
 }
 
 void LEDController::getLEDStateAsJson(String& output) const {
-  JsonDocument doc(PSRAMJsonAllocator::instance());
+  JsonDocument doc(PSRAMJsonAllocator::instance(JsonPurpose::LEDS));
   doc["type"] = "leds";
 
-  // Build the 4 rows of LED data. Each LED carries only its vehicleIds;
+  // Build the rows of LED data. Each LED carries only its vehicleIds;
   // the browser derives the colour from its existing train data.
   JsonArray rows = doc["rows"].to<JsonArray>();
 
-  // Iterate over the four physical LED rows and build the JSON representation.
-  for (const LEDRowDef& row : LED_ROW_DEFS) {
+  // Iterate over the physical LED rows and build the JSON representation.
+  for (size_t rowIndex = 0; rowIndex < ledLayout.getRowCount(); rowIndex++) {
+    const LayoutRow& row = ledLayout.getRow(rowIndex);
     JsonObject rowObj = rows.add<JsonObject>();
     rowObj["label"] = row.label;
 
@@ -297,7 +414,7 @@ void LEDController::getLEDStateAsJson(String& output) const {
     JsonArray leds = rowObj["leds"].to<JsonArray>();
     int step = row.descending ? -1 : 1;
     for (int ledIndex = row.start; row.descending ? (ledIndex >= row.end) : (ledIndex <= row.end); ledIndex += step) {
-      const std::vector<TrainAtLED>& trains = trainTracker.getTrainsAtLED(ledIndex);
+      const TrainsAtLED& trains = trainTracker.getTrainsAtLED(ledIndex);
       if (trains.empty()) {
         continue;
       }
@@ -0,0 +1,314 @@
+#include "LEDLayout.h"
+#include <LittleFS.h>
+#include <string.h>
+#include "LEDFrame.h"
+#include "LogManager.h"
+#include "PSRAMJsonAllocator.h"
+
+static const char* LOG_TAG = "LEDLayout";
+
+static const int LAYOUT_VERSION = 1;
+
+LEDLayout ledLayout;
+
+bool LEDLayout::load() {
+  clear();
+
+  File file = LittleFS.open(LAYOUT_FILE, "r");
+  if (!file) {
+    LINK_LOGE(LOG_TAG, "Layout file %s not found - no trains will be shown", LAYOUT_FILE);
+    return false;
+  }
+
+  JsonDocument doc(PSRAMJsonAllocator::instance());
+  DeserializationError error = deserializeJson(doc, file);
+  file.close();
+  if (error) {
+    LINK_LOGE(LOG_TAG, "Failed to parse %s: %s", LAYOUT_FILE, error.c_str());
+    return false;
+  }
+
+  // Nothing from a layout that fails validation is kept, so a typo can't leave half of it applied
+  if (!compile(doc)) {
+    clear();
+    LINK_LOGE(LOG_TAG, "Layout in %s rejected - no trains will be shown", LAYOUT_FILE);
+    return false;
+  }
+
+  loaded = true;
+  LINK_LOGI(LOG_TAG, "Layout loaded: %u LEDs, %u rows, %u stations, %u outputs",
+            ledCount, (unsigned int)rowCount, (unsigned int)stationCount, (unsigned int)outputCount);
+  return true;
+}
+
+void LEDLayout::clear() {
+  loaded = false;
+  ledCount = DEFAULT_LED_COUNT;
+  rowCount = 0;
+  stationCount = 0;
+  stationOrdinals.clear();
+  memset(ledRows, -1, sizeof(ledRows));
+  memset(ledFlags, 0, sizeof(ledFlags));
+  memset(followingStops, -1, sizeof(followingStops));
+  setSingleOutput();
+}
+
+// The whole strip in index order on LED_PIN
+void LEDLayout::setSingleOutput() {
+  outputs[0] = {LED_PIN, 0, ledCount};
+  outputCount = 1;
+  for (uint16_t led = 0; led < ledCount; led++) {
+    outputMap[led] = led;
+  }
+}
+
+int LEDLayout::findStation(const char* name) const {
+  auto ordinal = stationOrdinals.find(name);
+  return ordinal == stationOrdinals.end() ? -1 : ordinal->second;
+}
+
+bool LEDLayout::compile(JsonDocument& doc) {
+  if (doc["version"].as<int>() != LAYOUT_VERSION) {
+    LINK_LOGE(LOG_TAG, "Unsupported layout version %d, expected %d", doc["version"].as<int>(), LAYOUT_VERSION);
+    return false;
+  }
+
+  int count = doc["ledCount"] | 0;
+  if (count < 1 || count > MAX_LED_COUNT) {
+    LINK_LOGE(LOG_TAG, "ledCount %d out of range (1-%d)", count, MAX_LED_COUNT);
+    return false;
+  }
+  ledCount = (uint16_t)count;
+
+  return compileRows(doc["rows"].as<JsonArrayConst>()) &&
+         compileStations(doc["stations"].as<JsonArrayConst>()) &&
+         compileOverrides(doc["enrouteOverrides"].as<JsonArrayConst>()) &&
+         compileLines(doc["lines"].as<JsonArrayConst>()) &&
+         compileOutputs(doc["outputs"].as<JsonArrayConst>());
+}
+
+// Rows are { "label", "start", "end", "logPad" }. Rows can't overlap, and each LED's row goes in ledRows.
+bool LEDLayout::compileRows(JsonArrayConst source) {
+  if (source.isNull() || source.size() == 0 || source.size() > MAX_LAYOUT_ROWS) {
+    LINK_LOGE(LOG_TAG, "Layout needs 1-%d rows", MAX_LAYOUT_ROWS);
+    return false;
+  }
+
+  for (JsonObjectConst rowSource : source) {
+    LayoutRow& row = rows[rowCount];
+    const char* label = rowSource["label"] | "";
+    row.start = rowSource["start"] | -1;
+    row.end = rowSource["end"] | -1;
+    if (!isValidLED(row.start) || !isValidLED(row.end)) {
+      LINK_LOGE(LOG_TAG, "Row %u (%s) has LEDs outside 0-%u", (unsigned int)rowCount, label, ledCount - 1);
+      return false;
+    }
+    row.label = label;
+    row.descending = row.start > row.end;
+
+    row.logPrefix = row.label + ":";
+    int logPad = rowSource["logPad"] | 1;
+    for (int i = 0; i < logPad && i < 32; i++) {
+      row.logPrefix += " ";
+    }
+
+    int low = row.descending ? row.end : row.start;
+    int high = row.descending ? row.start : row.end;
+    for (int led = low; led <= high; led++) {
+      if (ledRows[led] >= 0) {
+        LINK_LOGE(LOG_TAG, "Row %u (%s) overlaps row %d at LED %d", (unsigned int)rowCount, label, ledRows[led], led);
+        return false;
+      }
+      ledRows[led] = (int8_t)rowCount;
+    }
+    rowCount++;
+  }
+  return true;
+}
+
+// Stations are [name, northbound, northbound en route, southbound, southbound en route]. Every station LED must
+// be on the strip and belong to only one station, which catches most typos.
+bool LEDLayout::compileStations(JsonArrayConst source) {
+  if (source.isNull() || source.size() > MAX_LAYOUT_STATIONS) {
+    LINK_LOGE(LOG_TAG, "Layout needs a stations list of at most %d stations", MAX_LAYOUT_STATIONS);
+    return false;
+  }
+
+  int16_t ledOwners[MAX_LED_COUNT];
+  memset(ledOwners, -1, sizeof(ledOwners));
+
+  for (JsonArrayConst stationSource : source) {
+    const char* name = stationSource[0] | "";
+    if (stationSource.size() != 5 || name[0] == '\0') {
+      LINK_LOGE(LOG_TAG, "Station %u must be [name, 4 LED indexes]", (unsigned int)stationCount);
+      return false;
+    }
+    if (stationOrdinals.count(name) > 0) {
+      LINK_LOGE(LOG_TAG, "Station %s is listed twice", name);
+      return false;
+    }
+
+    int leds[4];
+    for (int i = 0; i < 4; i++) {
+      leds[i] = stationSource[i + 1] | -1;
+      if (!isValidLED(leds[i])) {
+        LINK_LOGE(LOG_TAG, "Station %s has LED %d outside 0-%u", name, leds[i], ledCount - 1);
+        return false;
+      }
+      if (ledOwners[leds[i]] >= 0) {
+        LINK_LOGE(LOG_TAG, "Station %s uses LED %d, already used by %s",
+                  name, leds[i], stations[ledOwners[leds[i]]].name.c_str());
+        return false;
+      }
+      ledOwners[leds[i]] = (int16_t)stationCount;
+    }
+
+    int ordinal = (int)stationCount;
+    LayoutStation& station = stations[ordinal];
+    station.name = name;
+    station.leds = {leds[0], leds[1], leds[2], leds[3]};
+    stationOrdinals[station.name] = ordinal;
+
+    stationLEDs[ordinal][1] = (int16_t)leds[0];
+    stationLEDs[ordinal][0] = (int16_t)leds[2];
+    for (int line = 0; line < LAYOUT_LINE_COUNT; line++) {
+      enrouteLEDs[ordinal][line][1] = (int16_t)leds[1];
+      enrouteLEDs[ordinal][line][0] = (int16_t)leds[3];
+    }
+    ledFlags[leds[0]] |= LED_FLAG_STATION;
+    ledFlags[leds[2]] |= LED_FLAG_STATION;
+    stationCount++;
+  }
+  return true;
+}
+
+// Overrides are { "line", "direction", "nextStop", "led" }, replacing the en-route LED for trains of that line
+// heading to nextStop in that direction. The list is optional.
+bool LEDLayout::compileOverrides(JsonArrayConst source) {
+  if (source.isNull()) {
+    return true;
+  }
+  if (source.size() > MAX_LAYOUT_OVERRIDES) {
+    LINK_LOGE(LOG_TAG, "Layout has more than %d en-route overrides", MAX_LAYOUT_OVERRIDES);
+    return false;
+  }
+
+  for (JsonObjectConst overrideSource : source) {
+    int line = overrideSource["line"] | 0;
+    const char* direction = overrideSource["direction"] | "";
+    const char* nextStop = overrideSource["nextStop"] | "";
+    int led = overrideSource["led"] | -1;
+
+    int ordinal = findStation(nextStop);
+    bool northbound = strcmp(direction, "northbound") == 0;
+    if (line < 1 || line > LAYOUT_LINE_COUNT || ordinal < 0 || !isValidLED(led) ||
+        (!northbound && strcmp(direction, "southbound") != 0)) {
+      LINK_LOGE(LOG_TAG, "Invalid en-route override: line %d, %s, next stop '%s', LED %d", line, direction, nextStop, led);
+      return false;
+    }
+    enrouteLEDs[ordinal][line - 1][northbound ? 1 : 0] = (int16_t)led;
+  }
+  return true;
+}
+
+// Lines are { "line", "stops" }, with the line's stations in the order northbound trains reach them. They give
+// each station's following stop per line and direction, for predicting where a departing train goes next. The
+// list is optional; without it departing trains stay on the station LED until the next poll.
+bool LEDLayout::compileLines(JsonArrayConst source) {
+  if (source.isNull()) {
+    return true;
+  }
+
+  for (JsonObjectConst lineSource : source) {
+    int line = lineSource["line"] | 0;
+    JsonArrayConst stops = lineSource["stops"].as<JsonArrayConst>();
+    if (line < 1 || line > LAYOUT_LINE_COUNT || stops.isNull()) {
+      LINK_LOGE(LOG_TAG, "Line %d must be { \"line\": 1-%d, \"stops\": [...] }", line, LAYOUT_LINE_COUNT);
+      return false;
+    }
+
+    bool listed[MAX_LAYOUT_STATIONS] = {};
+    int previous = -1;
+    for (JsonVariantConst stop : stops) {
+      const char* name = stop | "";
+      int ordinal = findStation(name);
+      if (ordinal < 0 || listed[ordinal]) {
+        LINK_LOGE(LOG_TAG, "Line %d stop '%s' isn't a station or is listed twice", line, name);
+        return false;
+      }
+      listed[ordinal] = true;
+      if (previous >= 0) {
+        followingStops[previous][line - 1][1] = (int16_t)ordinal;
+        followingStops[ordinal][line - 1][0] = (int16_t)previous;
+      }
+      previous = ordinal;
+    }
+  }
+  return true;
+}
+
+// Outputs are { "pin", "leds": [[from, to], ...] }, one per data line. The ranges are listed in wiring order and
+// each runs from the LED nearest the data pin, in either direction, so a row can be wired from either end. An
+// LED can be on only one output. The list is optional and defaults to the whole strip on LED_PIN.
+bool LEDLayout::compileOutputs(JsonArrayConst source) {
+  if (source.isNull()) {
+    setSingleOutput();
+    return true;
+  }
+  if (source.size() == 0 || source.size() > LED_MAX_OUTPUTS) {
+    LINK_LOGE(LOG_TAG, "Layout needs 1-%d outputs", LED_MAX_OUTPUTS);
+    return false;
+  }
+
+  bool wired[MAX_LED_COUNT] = {};
+  uint16_t mapped = 0;
+  outputCount = 0;
+  for (JsonObjectConst outputSource : source) {
+    int pin = outputSource["pin"] | -1;
+    if (pin < 0 || pin > 48) {
+      LINK_LOGE(LOG_TAG, "Output %u has invalid pin %d", (unsigned int)outputCount, pin);
+      return false;
+    }
+    for (size_t other = 0; other < outputCount; other++) {
+      if (outputs[other].pin == pin) {
+        LINK_LOGE(LOG_TAG, "Outputs %u and %u both use pin %d", (unsigned int)other, (unsigned int)outputCount, pin);
+        return false;
+      }
+    }
+
+    LayoutOutput& output = outputs[outputCount];
+    output.pin = (uint8_t)pin;
+    output.first = mapped;
+    for (JsonArrayConst range : outputSource["leds"].as<JsonArrayConst>()) {
+      int from = range[0] | -1;
+      int to = range[1] | -1;
+      if (range.size() != 2 || !isValidLED(from) || !isValidLED(to)) {
+        LINK_LOGE(LOG_TAG, "Output on pin %d has a range outside 0-%u", pin, ledCount - 1);
+        return false;
+      }
+      int step = from <= to ? 1 : -1;
+      for (int led = from; ; led += step) {
+        if (wired[led]) {
+          LINK_LOGE(LOG_TAG, "LED %d is on more than one output", led);
+          return false;
+        }
+        wired[led] = true;
+        outputMap[mapped++] = (uint16_t)led;
+        if (led == to) {
+          break;
+        }
+      }
+    }
+    output.count = mapped - output.first;
+    if (output.count == 0) {
+      LINK_LOGE(LOG_TAG, "Output on pin %d has no LEDs", pin);
+      return false;
+    }
+    outputCount++;
+  }
+
+  if (mapped < ledCount) {
+    LINK_LOGW(LOG_TAG, "%u of %u LEDs aren't on any output and won't light", ledCount - mapped, ledCount);
+  }
+  return true;
+}
@@ -0,0 +1,183 @@
+#include "LEDRenderer.h"
+#include <esp_timer.h>
+#include <string.h>
+#include <time.h>
+#include "LogManager.h"
+#include "PreferencesManager.h"
+#include "PerfMonitor.h"
+#include "FrameMirror.h"
+#include "LoopEvents.h"
+
+static const char* LOG_TAG = "LEDRenderer";
+
+LEDRenderer ledRenderer;
+
+void LEDRenderer::setup(uint16_t ledCount) {
+  pipeline.begin(ledCount);
+  publishMutex = xSemaphoreCreateMutex();
+  if (publishMutex == nullptr) {
+    LINK_LOGE(LOG_TAG, "Failed to create LED publish mutex");
+  }
+}
+
+void LEDRenderer::start() {
+  // Preferences weren't loaded yet at setup(), so the startup animation ran at full brightness
+  updateBrightness();
+  // Above the loop and train update tasks, so a slow web client can't hold a frame back
+  if (xTaskCreatePinnedToCore(renderTaskEntry, "LEDRender", 4096, this, LED_RENDER_TASK_PRIORITY, &renderTask, 1) != pdPASS) {
+    LINK_LOGE(LOG_TAG, "Failed to create LED render task");
+    return;
+  }
+  LINK_LOGI(LOG_TAG, "LED render task started at %u Hz", preferencesManager.getRenderRate());
+}
+
+void LEDRenderer::publish(const LEDFrame& frame) {
+  if (publishMutex == nullptr) {
+    return;
+  }
+  xSemaphoreTake(publishMutex, portMAX_DELAY);
+
+  // With the latest and the render task's buffer excluded, one of the three is always free
+  portENTER_CRITICAL(&lock);
+  int slot = 0;
+  while (slot == latest || slot == reading) {
+    slot++;
+  }
+  portEXIT_CRITICAL(&lock);
+
+  // The render task only ever pins the latest buffer, so this one can be filled outside the lock
+  publishedFrames[slot] = frame;
+
+  portENTER_CRITICAL(&lock);
+  latest = slot;
+  publishedSeq++;
+  portEXIT_CRITICAL(&lock);
+
+  xSemaphoreGive(publishMutex);
+}
+
+void LEDRenderer::showImmediately(const LEDFrame& frame) {
+  pipeline.show(frame);
+}
+
+void LEDRenderer::renderTaskEntry(void* parameter) {
+  static_cast<LEDRenderer*>(parameter)->renderLoop();
+}
+
+void LEDRenderer::renderLoop() {
+  unsigned int rate = 0;
+  TickType_t periodTicks = 1;
+  TickType_t lastWake = xTaskGetTickCount();
+  int64_t lastTickMicros = esp_timer_get_time();
+
+  while (true) {
+    // Picked up live, so a new frame rate applies without a restart
+    unsigned int configuredRate = preferencesManager.getRenderRate();
+    if (configuredRate != rate) {
+      rate = configuredRate;
+      periodTicks = pdMS_TO_TICKS(1000 / rate);
+      if (periodTicks == 0) {
+        periodTicks = 1;
+      }
+      lastWake = xTaskGetTickCount();
+    }
+
+    if (xTaskDelayUntil(&lastWake, periodTicks) == pdFALSE) {
+      // The last frame overran its slot, so start the schedule again from now rather than bursting to catch up
+      lastWake = xTaskGetTickCount();
+    }
+
+    // Jitter is how far the time since the last tick is from the frame period
+    int64_t now = esp_timer_get_time();
+    int64_t periodMicros = (int64_t)periodTicks * portTICK_PERIOD_MS * 1000;
+    int64_t interval = now - lastTickMicros;
+    lastTickMicros = now;
+    if (interval > 2 * periodMicros) {
+      lateFrames++;
+    }
+#ifdef LINKLIGHT_PERF
+    perfMonitor.record(PerfStage::RENDER_JITTER, (uint32_t)(interval > periodMicros ? interval - periodMicros : periodMicros - interval));
+#endif
+
+    renderFrame((uint32_t)(interval / 1000));
+    pixelStreamer.update(pipeline.getShownFrame(), pipeline.getLedCount());
+  }
+}
+
+// Any time before this means NTP hasn't synchronized yet, so the night schedule can't apply
+static const time_t MIN_VALID_EPOCH = 1700000000;
+
+// Picks the day or night brightness for the current local hour and rebuilds the correction tables if it
+// changed. Returns true if it did, so the frame on the strip needs showing again.
+bool LEDRenderer::updateBrightness() {
+  unsigned int percent = preferencesManager.getBrightness();
+  unsigned int nightStart = preferencesManager.getNightStart();
+  unsigned int nightEnd = preferencesManager.getNightEnd();
+  time_t now = time(nullptr);
+  if (nightStart != nightEnd && now >= MIN_VALID_EPOCH) {
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    unsigned int hour = timeinfo.tm_hour;
+    // The night may wrap past midnight (e.g. 22 to 7)
+    bool night = nightStart < nightEnd ? (hour >= nightStart && hour < nightEnd)
+                                       : (hour >= nightStart || hour < nightEnd);
+    if (night) {
+      percent = preferencesManager.getNightBrightness();
+    }
+  }
+
+  uint8_t brightness = (uint8_t)((percent > 100 ? 100 : percent) * 255 / 100);
+  if (!pipeline.setBrightness(brightness)) {
+    return false;
+  }
+  LINK_LOGI(LOG_TAG, "LED brightness set to %u%%", percent);
+  return true;
+}
+
+void LEDRenderer::renderFrame(uint32_t elapsedMs) {
+  bool reshow = false;
+  if (millis() - lastBrightnessCheck >= BRIGHTNESS_CHECK_INTERVAL) {
+    lastBrightnessCheck = millis();
+    reshow = updateBrightness();
+  }
+
+  // Pin the latest published buffer so producers leave it alone while it's compared and copied
+  int slot = -1;
+  portENTER_CRITICAL(&lock);
+  if (publishedSeq != shownSeq) {
+    shownSeq = publishedSeq;
+    slot = latest;
+    reading = slot;
+  }
+  portEXIT_CRITICAL(&lock);
+
+  bool newTarget = false;
+  if (slot >= 0) {
+    if (memcmp(&frontFrame, &publishedFrames[slot], sizeof(LEDFrame)) != 0) {
+      frontFrame = publishedFrames[slot];
+      newTarget = true;
+    }
+    portENTER_CRITICAL(&lock);
+    reading = -1;
+    portEXIT_CRITICAL(&lock);
+  }
+
+  if (newTarget) {
+    pipeline.setTarget(frontFrame);
+  } else if (!pipeline.isAnimating() && !reshow) {
+    framesSkipped++;
+    return;
+  }
+
+  // Corrected straight into the mirror's next buffer, which is published once it's on the strip
+  pipeline.setOutputBuffer(frameMirror.beginWrite());
+  if (pipeline.render(elapsedMs, reshow)) {
+    framesShown++;
+    frameMirror.publish(pipeline.getLedCount());
+    if (frameMirror.isWanted()) {
+      loopEvents.signal(LOOP_EVENT_FRAME);
+    }
+  } else {
+    framesSkipped++;
+  }
+}
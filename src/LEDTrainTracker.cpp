@@ -3,6 +3,7 @@
 #include "config.h"
 #include "TrainDataManager.h"
 #include "colors.h"
+#include "LEDLayout.h"
 
 static const char* LOG_TAG = "LEDTrainTracker";
 
@@ -12,7 +13,7 @@ LEDTrainTracker::LEDTrainTracker() {
 
 // Add a train at a specific LED. Used later when displaying LEDs to determine color based on train presence.
 void LEDTrainTracker::addTrain(int ledIndex, Line line, const String& vehicleId) {
-  if (ledIndex < 0 || ledIndex >= LED_COUNT) {
+  if (ledIndex < 0 || ledIndex >= ledLayout.getLedCount()) {
     LINK_LOGW(LOG_TAG, "Invalid LED index %d for line %d", ledIndex, static_cast<int>(line));
     return;
   }
@@ -21,35 +22,49 @@ void LEDTrainTracker::addTrain(int ledIndex, Line line, const String& vehicleId)
 
 // Reset all trains for all LEDs. Called at the start of each update cycle to clear previous state.
 void LEDTrainTracker::reset() {
-  for (int i = 0; i < LED_COUNT; i++) {
+  for (int i = 0; i < MAX_LED_COUNT; i++) {
     ledTrains[i].clear();
   }
 }
 
-// Display the trains on the LED strip based on current state. Determines color for each LED based on presence of trains from both lines.
-void LEDTrainTracker::display(NeoPixelBus<NeoGrbFeature, NeoEsp32Rmt0Apa106Method>& strip) {
-  for (int i = 0; i < LED_COUNT; i++) {
-    bool hasLine1 = false;
-    bool hasLine2 = false;
-    for (const TrainAtLED& t : ledTrains[i]) {
-      if (t.line == Line::LINE_1) hasLine1 = true;
-      if (t.line == Line::LINE_2) hasLine2 = true;
-    }
-
-    if (hasLine1 && hasLine2) {
-      strip.SetPixelColor(i, ColorManager::getSharedLineColor());
-    } else if (hasLine1) {
-      strip.SetPixelColor(i, ColorManager::getLine1Color());
-    } else if (hasLine2) {
-      strip.SetPixelColor(i, ColorManager::getLine2Color());
-    } else {
-      strip.SetPixelColor(i, COLOR_BLACK);
-    }
+// Draw the trains into a frame based on current state. Determines color for each LED based on presence of trains from both lines.
+void LEDTrainTracker::render(LEDFrame& frame) const {
+  const LinePalette& palette = ColorManager::getPalette();
+  int ledCount = ledLayout.getLedCount();
+  for (int i = 0; i < ledCount; i++) {
+    frame.pixels[i] = colorForMask(getLineMask(i), palette);
   }
+}
+
+void LEDTrainTracker::renderLineMasks(const uint8_t* masks, LEDFrame& frame) {
+  const LinePalette& palette = ColorManager::getPalette();
+  int ledCount = ledLayout.getLedCount();
+  for (int i = 0; i < ledCount; i++) {
+    frame.pixels[i] = colorForMask(masks[i], palette);
+  }
+}
 
-  strip.Show();
+uint8_t LEDTrainTracker::getLineMask(int ledIndex) const {
+  uint8_t mask = 0;
+  for (const TrainAtLED& t : ledTrains[ledIndex]) {
+    if (t.line == Line::LINE_1) mask |= LINE_MASK_1;
+    if (t.line == Line::LINE_2) mask |= LINE_MASK_2;
+  }
+  return mask;
+}
+
+// The shared color for both lines, the line color for one, black for none
+RgbColor LEDTrainTracker::colorForMask(uint8_t mask, const LinePalette& palette) {
+  if (mask == (LINE_MASK_1 | LINE_MASK_2)) {
+    return palette.shared;
+  } else if (mask == LINE_MASK_1) {
+    return palette.line1;
+  } else if (mask == LINE_MASK_2) {
+    return palette.line2;
+  }
+  return COLOR_BLACK;
 }
 
-const std::vector<TrainAtLED>& LEDTrainTracker::getTrainsAtLED(int ledIndex) const {
+const TrainsAtLED& LEDTrainTracker::getTrainsAtLED(int ledIndex) const {
   return ledTrains[ledIndex];
 }
@@ -2,6 +2,7 @@
 #include "WebServerManager.h"
 #include <ArduinoJson.h>
 #include "PSRAMJsonAllocator.h"
+#include "Metrics.h"
 
 static const char* LOG_TAG = "LogManager";
 
@@ -29,6 +30,8 @@ void LogManager::addLog(const char* level, const char* tag, const char* message)
     Serial.println("[LogManager] Null parameter passed to addLog");
     return;
   }
+
+  metrics.recordLog(level);
   
   try {
     LogEntry entry;
@@ -80,7 +83,7 @@ void LogManager::clear() {
 void LogManager::getLogsAsJson(String& output, const char* messageType) const {
   size_t available = logBuffer.available();
 
-  JsonDocument doc(PSRAMJsonAllocator::instance());
+  JsonDocument doc(PSRAMJsonAllocator::instance(JsonPurpose::LOGS));
   if (messageType != nullptr) {
     doc["type"] = messageType;
   }
@@ -101,7 +104,7 @@ void LogManager::getLogsAsJson(String& output, const char* messageType) const {
 }
 
 void LogManager::getLogEntryAsJson(const LogEntry& entry, String& output) const {
-  JsonDocument doc(PSRAMJsonAllocator::instance());
+  JsonDocument doc(PSRAMJsonAllocator::instance(JsonPurpose::LOGS));
   doc["type"] = "log";
   doc["timestamp"] = entry.timestamp;
   doc["level"] = entry.level;
@@ -0,0 +1,148 @@
+#include "LoopEvents.h"
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include <string.h>
+#include "LogManager.h"
+#include "PerfMonitor.h"
+
+static const char* LOG_TAG = "LoopEvents";
+
+LoopEvents loopEvents;
+
+void LoopEvents::begin() {
+  loopTask = xTaskGetCurrentTaskHandle();
+  lastWakeMicros = esp_timer_get_time();
+  windowStartMicros = lastWakeMicros;
+
+  // Without the watcher the loop still services sockets every LOOP_MAX_WAIT, just with more latency
+  if (xTaskCreatePinnedToCore(watcherTaskEntry, "NetWatch", 3072, this, 1, &watcherTask, 1) != pdPASS) {
+    LINK_LOGE(LOG_TAG, "Failed to create network watcher task");
+  }
+}
+
+void LoopEvents::signal(uint32_t events) {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  for (int i = 0; i < LOOP_EVENT_COUNT; i++) {
+    if (events & (1UL << i)) {
+      // Keep the first raise, so coalesced events report the longest wait
+      uint32_t expected = 0;
+      signalMicros[i].compare_exchange_strong(expected, now != 0 ? now : 1);
+    }
+  }
+  if (loopTask != nullptr) {
+    xTaskNotify(loopTask, events, eSetBits);
+  }
+}
+
+uint32_t LoopEvents::wait(uint32_t timeoutMs) {
+  int64_t waitStart = esp_timer_get_time();
+  windowBusyMicros += waitStart - lastWakeMicros;
+
+  uint32_t events = 0;
+  xTaskNotifyWait(0, UINT32_MAX, &events, pdMS_TO_TICKS(timeoutMs));
+
+  int64_t now = esp_timer_get_time();
+  lastWakeMicros = now;
+  windowWakeups++;
+
+  if (events == 0) {
+    timeoutCount++;
+  }
+  for (int i = 0; i < LOOP_EVENT_COUNT; i++) {
+    if (!(events & (1UL << i))) {
+      continue;
+    }
+    eventCounts[i]++;
+    uint32_t raisedMicros = signalMicros[i].exchange(0);
+#ifdef LINKLIGHT_PERF
+    if (raisedMicros != 0) {
+      perfMonitor.record(PerfStage::LOOP_DISPATCH, (uint32_t)now - raisedMicros);
+    }
+#else
+    (void)raisedMicros;
+#endif
+  }
+
+  int64_t windowMicros = now - windowStartMicros;
+  if (windowMicros >= (int64_t)LOOP_STATS_WINDOW * 1000) {
+    wakeupsPerSecond = windowWakeups * 1e6f / windowMicros;
+    busyPercent = windowBusyMicros * 100.0f / windowMicros;
+    windowStartMicros = now;
+    windowBusyMicros = 0;
+    windowWakeups = 0;
+  }
+
+  return events;
+}
+
+void LoopEvents::networkHandled() {
+  if (watcherTask != nullptr) {
+    xTaskNotifyGive(watcherTask);
+  }
+}
+
+void LoopEvents::watcherTaskEntry(void* parameter) {
+  static_cast<LoopEvents*>(parameter)->watchNetwork();
+}
+
+// Collects sockets bound to the web server, WebSocket or OTA port. The train update task's outgoing API
+// connections have ephemeral local ports, so they're left out.
+static int collectServerSockets(fd_set& sockets) {
+  FD_ZERO(&sockets);
+  int maxFd = -1;
+  for (int fd = LWIP_SOCKET_OFFSET; fd < LWIP_SOCKET_OFFSET + CONFIG_LWIP_MAX_SOCKETS; fd++) {
+    struct sockaddr_in local;
+    socklen_t length = sizeof(local);
+    if (getsockname(fd, (struct sockaddr*)&local, &length) != 0 || local.sin_family != AF_INET) {
+      continue;
+    }
+    uint16_t port = ntohs(local.sin_port);
+    if (port == WEB_SERVER_PORT || port == WEB_SOCKET_PORT || port == OTA_PORT) {
+      FD_SET(fd, &sockets);
+      maxFd = fd > maxFd ? fd : maxFd;
+    }
+  }
+  return maxFd;
+}
+
+void LoopEvents::watchNetwork() {
+  fd_set lastReadable;
+  FD_ZERO(&lastReadable);
+
+  while (true) {
+    // Rebuilt every pass, since the loop accepts and closes client sockets between passes
+    fd_set readable;
+    int maxFd = collectServerSockets(readable);
+    if (maxFd < 0) {
+      // Servers aren't listening yet
+      vTaskDelay(pdMS_TO_TICKS(LOOP_SOCKET_RESCAN));
+      continue;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = LOOP_SOCKET_RESCAN / 1000;
+    timeout.tv_usec = (LOOP_SOCKET_RESCAN % 1000) * 1000;
+    int ready = select(maxFd + 1, &readable, nullptr, nullptr, &timeout);
+    if (ready < 0) {
+      // A socket was closed between collecting and selecting
+      vTaskDelay(1);
+      continue;
+    }
+    if (ready == 0) {
+      FD_ZERO(&lastReadable);
+      continue;
+    }
+
+    // The same sockets still readable after a pass means the loop is leaving them for later, e.g. a
+    // connection queued behind the HTTP client being served, so wake it at the old polling rate instead
+    if (memcmp(&readable, &lastReadable, sizeof(fd_set)) == 0) {
+      vTaskDelay(pdMS_TO_TICKS(LOOP_BUSY_SOCKET_DELAY));
+    }
+    lastReadable = readable;
+
+    signal(LOOP_EVENT_NETWORK);
+
+    // Wait for the loop to read before selecting again, or the same data would wake it straight away
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOOP_NETWORK_ACK_WAIT));
+  }
+}
@@ -0,0 +1,182 @@
+#include "MemoryMonitor.h"
+#include <algorithm>
+#include <esp_heap_caps.h>
+#include "LogManager.h"
+#include "PSRAMJsonAllocator.h"
+
+static const char* LOG_TAG = "MemoryMonitor";
+
+MemoryMonitor memoryMonitor;
+
+void MemoryMonitor::registerTask(const char* name, TaskHandle_t task) {
+  if (task == nullptr) {
+    return;
+  }
+  if (taskCount >= MEMORY_MAX_TASKS) {
+    LINK_LOGW(LOG_TAG, "Can't monitor stack of task %s, already watching %d tasks", name, MEMORY_MAX_TASKS);
+    return;
+  }
+
+  taskNames[taskCount] = name;
+  tasks[taskCount] = task;
+  taskCount++;
+}
+
+bool MemoryMonitor::handle() {
+  unsigned long now = millis();
+
+  // The first sample is taken right away so the history isn't empty for the first interval
+  if (!sampled || now - lastSampleMillis >= MEMORY_SAMPLE_INTERVAL) {
+    lastSampleMillis = now;
+    sampled = true;
+    history.pushOverwrite(takeSample());
+  }
+
+  if (now - lastLiveMillis >= MEMORY_LIVE_INTERVAL) {
+    lastLiveMillis = now;
+    return true;
+  }
+  return false;
+}
+
+MemorySample MemoryMonitor::takeSample() const {
+  MemorySample sample;
+  sample.uptimeSeconds = millis() / 1000;
+
+  sample.freeInternal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  sample.minFreeInternal = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+  sample.largestInternal = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+  sample.freePsram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+  sample.minFreePsram = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+  sample.largestPsram = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+  sample.largestDma = heap_caps_get_largest_free_block(MALLOC_CAP_DMA);
+
+  for (int i = 0; i < static_cast<int>(JsonPurpose::COUNT); i++) {
+    const JsonAllocatorStats& jsonStats = PSRAMJsonAllocator::getStats(static_cast<JsonPurpose>(i));
+    sample.jsonAllocations += jsonStats.allocations.load();
+    sample.jsonLiveBytes += jsonStats.liveBytes.load();
+  }
+
+  for (size_t i = 0; i < taskCount; i++) {
+    // ESP-IDF reports the high-water mark in bytes rather than words
+    sample.stackFree[i] = uxTaskGetStackHighWaterMark(tasks[i]);
+  }
+
+  return sample;
+}
+
+// Folds the next sample into a downsampled bucket, keeping the worst case so short dips aren't hidden
+void MemoryMonitor::mergeSample(MemorySample& into, const MemorySample& next) {
+  into.uptimeSeconds = next.uptimeSeconds;
+  into.freeInternal = std::min(into.freeInternal, next.freeInternal);
+  into.minFreeInternal = std::min(into.minFreeInternal, next.minFreeInternal);
+  into.largestInternal = std::min(into.largestInternal, next.largestInternal);
+  into.freePsram = std::min(into.freePsram, next.freePsram);
+  into.minFreePsram = std::min(into.minFreePsram, next.minFreePsram);
+  into.largestPsram = std::min(into.largestPsram, next.largestPsram);
+  into.largestDma = std::min(into.largestDma, next.largestDma);
+  into.jsonAllocations = next.jsonAllocations;
+  into.jsonLiveBytes = std::max(into.jsonLiveBytes, next.jsonLiveBytes);
+  for (size_t i = 0; i < MEMORY_MAX_TASKS; i++) {
+    into.stackFree[i] = std::min(into.stackFree[i], next.stackFree[i]);
+  }
+}
+
+void MemoryMonitor::addSampleFields(JsonObject obj, const MemorySample& sample) const {
+  obj["uptime"] = sample.uptimeSeconds;
+  obj["freeInternal"] = sample.freeInternal;
+  obj["minFreeInternal"] = sample.minFreeInternal;
+  obj["largestInternal"] = sample.largestInternal;
+  obj["freePsram"] = sample.freePsram;
+  obj["minFreePsram"] = sample.minFreePsram;
+  obj["largestPsram"] = sample.largestPsram;
+  obj["largestDma"] = sample.largestDma;
+  obj["jsonAllocations"] = sample.jsonAllocations;
+  obj["jsonLiveBytes"] = sample.jsonLiveBytes;
+
+  JsonObject stacks = obj["stackFree"].to<JsonObject>();
+  for (size_t i = 0; i < taskCount; i++) {
+    stacks[taskNames[i]] = sample.stackFree[i];
+  }
+}
+
+void MemoryMonitor::getHistoryAsJson(String& output, size_t maxPoints) const {
+  JsonDocument doc(PSRAMJsonAllocator::instance());
+  doc["intervalSeconds"] = MEMORY_SAMPLE_INTERVAL / 1000;
+  doc["capacity"] = history.capacity();
+  addSampleFields(doc["current"].to<JsonObject>(), takeSample());
+
+  // Per-purpose JSON document sizes, for right-sizing buffers
+  JsonObject jsonAllocators = doc["jsonAllocators"].to<JsonObject>();
+  for (int i = 0; i < static_cast<int>(JsonPurpose::COUNT); i++) {
+    JsonPurpose purpose = static_cast<JsonPurpose>(i);
+    const JsonAllocatorStats& jsonStats = PSRAMJsonAllocator::getStats(purpose);
+    JsonObject purposeObj = jsonAllocators[PSRAMJsonAllocator::purposeToString(purpose)].to<JsonObject>();
+    purposeObj["liveBytes"] = jsonStats.liveBytes.load();
+    purposeObj["peakBytes"] = jsonStats.peakBytes.load();
+    purposeObj["allocations"] = jsonStats.allocations.load();
+    purposeObj["reallocations"] = jsonStats.reallocations.load();
+    purposeObj["fallbacks"] = jsonStats.fallbacks.load();
+  }
+
+  size_t available = history.available();
+  if (maxPoints == 0 || maxPoints > available) {
+    maxPoints = available;
+  }
+  size_t bucketSize = maxPoints > 0 ? (available + maxPoints - 1) / maxPoints : 1;
+  doc["bucketSize"] = bucketSize;
+
+  // One array per field keeps the response compact enough to return weeks of samples
+  JsonObject series = doc["history"].to<JsonObject>();
+  JsonArray uptime = series["uptime"].to<JsonArray>();
+  JsonArray freeInternal = series["freeInternal"].to<JsonArray>();
+  JsonArray minFreeInternal = series["minFreeInternal"].to<JsonArray>();
+  JsonArray largestInternal = series["largestInternal"].to<JsonArray>();
+  JsonArray freePsram = series["freePsram"].to<JsonArray>();
+  JsonArray minFreePsram = series["minFreePsram"].to<JsonArray>();
+  JsonArray largestPsram = series["largestPsram"].to<JsonArray>();
+  JsonArray largestDma = series["largestDma"].to<JsonArray>();
+  JsonArray jsonAllocations = series["jsonAllocations"].to<JsonArray>();
+  JsonArray jsonLiveBytes = series["jsonLiveBytes"].to<JsonArray>();
+  JsonObject stacks = series["stackFree"].to<JsonObject>();
+  JsonArray stackArrays[MEMORY_MAX_TASKS];
+  for (size_t i = 0; i < taskCount; i++) {
+    stackArrays[i] = stacks[taskNames[i]].to<JsonArray>();
+  }
+
+  for (size_t start = 0; start < available; start += bucketSize) {
+    MemorySample bucket;
+    if (!history.peekAt(start, bucket)) {
+      break;
+    }
+    for (size_t i = start + 1; i < start + bucketSize && i < available; i++) {
+      MemorySample next;
+      if (history.peekAt(i, next)) {
+        mergeSample(bucket, next);
+      }
+    }
+
+    uptime.add(bucket.uptimeSeconds);
+    freeInternal.add(bucket.freeInternal);
+    minFreeInternal.add(bucket.minFreeInternal);
+    largestInternal.add(bucket.largestInternal);
+    freePsram.add(bucket.freePsram);
+    minFreePsram.add(bucket.minFreePsram);
+    largestPsram.add(bucket.largestPsram);
+    largestDma.add(bucket.largestDma);
+    jsonAllocations.add(bucket.jsonAllocations);
+    jsonLiveBytes.add(bucket.jsonLiveBytes);
+    for (size_t i = 0; i < taskCount; i++) {
+      stackArrays[i].add(bucket.stackFree[i]);
+    }
+  }
+
+  serializeJson(doc, output);
+}
+
+void MemoryMonitor::getLiveAsJson(String& output) const {
+  JsonDocument doc(PSRAMJsonAllocator::instance());
+  doc["type"] = "memory";
+  addSampleFields(doc["sample"].to<JsonObject>(), takeSample());
+  serializeJson(doc, output);
+}
@@ -0,0 +1,122 @@
+#include "MemoryPools.h"
+#include <esp_heap_caps.h>
+#include "config.h"
+
+MemoryPoolStats MemoryPools::stats[static_cast<int>(MemoryPool::COUNT)];
+
+static const uint32_t INTERNAL_CAPS = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+static const uint32_t DMA_CAPS = MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+
+static uint32_t preferredCaps(MemoryPool pool) {
+  switch (pool) {
+    case MemoryPool::HOT_INTERNAL: return INTERNAL_CAPS;
+    case MemoryPool::DMA: return DMA_CAPS;
+    case MemoryPool::BULK_PSRAM:
+    default: return MALLOC_CAP_SPIRAM;
+  }
+}
+
+// Returns the caps to retry with when the preferred memory is full, or 0 for no fallback.
+// Bulk data only spills into internal SRAM when it's small, so a large document can't starve
+// the WiFi stack and render path of internal memory.
+static uint32_t fallbackCaps(MemoryPool pool, size_t size) {
+  switch (pool) {
+    case MemoryPool::HOT_INTERNAL: return MALLOC_CAP_SPIRAM;
+    case MemoryPool::BULK_PSRAM: return size <= BULK_INTERNAL_FALLBACK_MAX ? INTERNAL_CAPS : 0;
+    case MemoryPool::DMA:
+    default: return 0;
+  }
+}
+
+void MemoryPools::addLiveBytes(MemoryPool pool, size_t size) {
+  MemoryPoolStats& poolStats = stats[static_cast<int>(pool)];
+  uint32_t live = poolStats.liveBytes.fetch_add(size) + size;
+  uint32_t peak = poolStats.peakBytes.load();
+  while (live > peak && !poolStats.peakBytes.compare_exchange_weak(peak, live)) {
+  }
+}
+
+void* MemoryPools::allocate(MemoryPool pool, size_t size, bool* fellBack) {
+  MemoryPoolStats& poolStats = stats[static_cast<int>(pool)];
+  if (fellBack != nullptr) {
+    *fellBack = false;
+  }
+
+  void* ptr = heap_caps_malloc(size, preferredCaps(pool));
+  if (ptr == nullptr) {
+    uint32_t caps = fallbackCaps(pool, size);
+    if (caps != 0) {
+      ptr = heap_caps_malloc(size, caps);
+      if (ptr != nullptr) {
+        poolStats.fallbacks++;
+        if (fellBack != nullptr) {
+          *fellBack = true;
+        }
+      }
+    }
+  }
+
+  if (ptr == nullptr) {
+    poolStats.failures++;
+    return nullptr;
+  }
+
+  poolStats.allocations++;
+  addLiveBytes(pool, heap_caps_get_allocated_size(ptr));
+  return ptr;
+}
+
+void* MemoryPools::reallocate(MemoryPool pool, void* ptr, size_t newSize, bool* fellBack) {
+  if (ptr == nullptr) {
+    return allocate(pool, newSize, fellBack);
+  }
+  if (fellBack != nullptr) {
+    *fellBack = false;
+  }
+
+  MemoryPoolStats& poolStats = stats[static_cast<int>(pool)];
+  size_t oldSize = heap_caps_get_allocated_size(ptr);
+
+  void* newPtr = heap_caps_realloc(ptr, newSize, preferredCaps(pool));
+  if (newPtr == nullptr && newSize > 0) {
+    uint32_t caps = fallbackCaps(pool, newSize);
+    if (caps != 0) {
+      newPtr = heap_caps_realloc(ptr, newSize, caps);
+      if (newPtr != nullptr) {
+        poolStats.fallbacks++;
+        if (fellBack != nullptr) {
+          *fellBack = true;
+        }
+      }
+    }
+  }
+
+  if (newPtr == nullptr) {
+    if (newSize > 0) {
+      poolStats.failures++;
+    }
+    return nullptr;
+  }
+
+  poolStats.liveBytes -= oldSize;
+  addLiveBytes(pool, heap_caps_get_allocated_size(newPtr));
+  return newPtr;
+}
+
+void MemoryPools::deallocate(MemoryPool pool, void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  stats[static_cast<int>(pool)].liveBytes -= heap_caps_get_allocated_size(ptr);
+  heap_caps_free(ptr);
+}
+
+const char* MemoryPools::poolToString(MemoryPool pool) {
+  switch (pool) {
+    case MemoryPool::HOT_INTERNAL: return "hotInternal";
+    case MemoryPool::BULK_PSRAM: return "bulkPsram";
+    case MemoryPool::DMA: return "dma";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,204 @@
+#include "Metrics.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <stdarg.h>
+#include "FreshnessMonitor.h"
+#include "PreferencesManager.h"
+#include "TrainDataManager.h"
+#include "WebServerManager.h"
+
+Metrics metrics;
+
+static const char* LOG_LEVELS = "EWIDV";
+
+void Metrics::recordPoll(bool failed) {
+  pollsTotal++;
+  if (failed) {
+    pollFailuresTotal++;
+  }
+}
+
+void Metrics::recordApiResponse(int httpCode) {
+  if (httpCode == 0) {
+    // 0 marks an empty slot, and HTTPClient never returns it
+    otherHttpCodes++;
+    return;
+  }
+
+  // Find the slot for this code, claiming an empty one the first time a code is seen
+  for (HttpCodeCount& slot : httpCodes) {
+    int slotCode = slot.code.load();
+    if (slotCode == 0) {
+      int expected = 0;
+      if (slot.code.compare_exchange_strong(expected, httpCode)) {
+        slotCode = httpCode;
+      } else {
+        slotCode = expected;
+      }
+    }
+    if (slotCode == httpCode) {
+      slot.count++;
+      return;
+    }
+  }
+  otherHttpCodes++;
+}
+
+void Metrics::recordBytesDownloaded(size_t bytes) {
+  bytesDownloaded += bytes;
+}
+
+void Metrics::recordParseTime(uint32_t micros) {
+  parseMicrosTotal += micros;
+  parsesTotal++;
+}
+
+void Metrics::recordWebSocketSend(size_t bytes, size_t clients) {
+  webSocketMessagesSent += clients;
+  webSocketBytesSent += bytes * clients;
+}
+
+void Metrics::recordLog(const char* level) {
+  const char* match = strchr(LOG_LEVELS, level[0]);
+  if (match != nullptr && level[0] != '\0') {
+    logMessages[match - LOG_LEVELS]++;
+  }
+}
+
+// Formats lines into a small stack buffer and sends it as a chunk whenever it fills, so the
+// response never exists as a whole in memory
+class PrometheusWriter {
+public:
+  explicit PrometheusWriter(WebServer& server) : server(server) {}
+
+  void printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+      va_list args;
+      va_start(args, format);
+      int written = vsnprintf(buffer + length, sizeof(buffer) - length, format, args);
+      va_end(args);
+
+      if (written >= 0 && (size_t)written < sizeof(buffer) - length) {
+        length += written;
+        return;
+      }
+      // Didn't fit, so send what's buffered and try again into an empty buffer
+      flush();
+    }
+  }
+
+  void header(const char* name, const char* type, const char* help) {
+    printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+  }
+
+  void flush() {
+    if (length > 0) {
+      server.sendContent(buffer, length);
+      length = 0;
+    }
+  }
+
+private:
+  WebServer& server;
+  char buffer[512];
+  size_t length = 0;
+};
+
+void Metrics::writePrometheus(WebServer& server) const {
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain; version=0.0.4; charset=utf-8", "");
+  PrometheusWriter out(server);
+
+  out.header("linklight_info", "gauge", "Device information");
+  out.printf("linklight_info{hostname=\"%s\"} 1\n", preferencesManager.getHostname().c_str());
+
+  out.header("linklight_uptime_seconds", "gauge", "Time since boot");
+  out.printf("linklight_uptime_seconds %llu\n", (unsigned long long)(esp_timer_get_time() / 1000000));
+
+  // Polling and ingest
+  out.header("linklight_polls_total", "counter", "Train update cycles run");
+  out.printf("linklight_polls_total %u\n", (unsigned)pollsTotal.load());
+  out.header("linklight_poll_failures_total", "counter", "Update cycles where a request or parse failed");
+  out.printf("linklight_poll_failures_total %u\n", (unsigned)pollFailuresTotal.load());
+
+  out.header("linklight_api_responses_total", "counter", "API responses by HTTP status code, negative codes are HTTPClient errors");
+  for (const HttpCodeCount& slot : httpCodes) {
+    int code = slot.code.load();
+    if (code != 0) {
+      out.printf("linklight_api_responses_total{code=\"%d\"} %u\n", code, (unsigned)slot.count.load());
+    }
+  }
+  out.printf("linklight_api_responses_total{code=\"other\"} %u\n", (unsigned)otherHttpCodes.load());
+
+  out.header("linklight_downloaded_bytes_total", "counter", "API response body bytes read");
+  out.printf("linklight_downloaded_bytes_total %u\n", (unsigned)bytesDownloaded.load());
+
+  out.header("linklight_parse_duration_seconds", "summary", "Time spent downloading and parsing responses per update cycle");
+  out.printf("linklight_parse_duration_seconds_sum %.6f\n", parseMicrosTotal.load() / 1e6);
+  out.printf("linklight_parse_duration_seconds_count %u\n", (unsigned)parsesTotal.load());
+
+  // Trains, counted under the mutex so the table isn't changing underneath
+  size_t line1Trains = 0;
+  size_t line2Trains = 0;
+  trainDataManager.lockData();
+  trainDataManager.getVehicleTable().forEach([&](const TrainData& train) {
+    if (train.line == Line::LINE_1) {
+      line1Trains++;
+    } else if (train.line == Line::LINE_2) {
+      line2Trains++;
+    }
+  });
+  trainDataManager.unlockData();
+
+  out.header("linklight_trains", "gauge", "Trains currently tracked per line");
+  out.printf("linklight_trains{line=\"1\"} %u\n", (unsigned)line1Trains);
+  out.printf("linklight_trains{line=\"2\"} %u\n", (unsigned)line2Trains);
+
+  int32_t dataAgeMs = trainDataManager.getDataAgeMs();
+  if (dataAgeMs >= 0) {
+    out.header("linklight_data_age_seconds", "gauge", "Age of the newest upstream vehicle update in the published data");
+    out.printf("linklight_data_age_seconds %.3f\n", dataAgeMs / 1000.0);
+  }
+
+  FreshnessSummary displayAge = freshnessMonitor.getDisplayAgeSummary();
+  if (displayAge.samples > 0) {
+    // Separate gauges rather than a summary: the percentiles cover a rolling window, with no running sum or count
+    out.header("linklight_data_age_at_display_p50_seconds", "gauge", "Rolling median data age when it reached the LEDs");
+    out.printf("linklight_data_age_at_display_p50_seconds %.3f\n", displayAge.p50Ms / 1000.0);
+    out.header("linklight_data_age_at_display_p95_seconds", "gauge", "Rolling 95th percentile data age when it reached the LEDs");
+    out.printf("linklight_data_age_at_display_p95_seconds %.3f\n", displayAge.p95Ms / 1000.0);
+    out.header("linklight_data_age_at_display_max_seconds", "gauge", "Rolling maximum data age when it reached the LEDs");
+    out.printf("linklight_data_age_at_display_max_seconds %.3f\n", displayAge.maxMs / 1000.0);
+  }
+  out.header("linklight_freshness_target_breached", "gauge", "1 while the p95 data age at display is above the freshness target");
+  out.printf("linklight_freshness_target_breached %d\n", freshnessMonitor.isTargetBreached() ? 1 : 0);
+
+  // WebSocket
+  out.header("linklight_websocket_clients", "gauge", "Connected WebSocket clients");
+  out.printf("linklight_websocket_clients %d\n", webServerManager.getWebSocketClientCount());
+  out.header("linklight_websocket_messages_sent_total", "counter", "WebSocket messages sent, counted once per client");
+  out.printf("linklight_websocket_messages_sent_total %u\n", (unsigned)webSocketMessagesSent.load());
+  out.header("linklight_websocket_sent_bytes_total", "counter", "WebSocket payload bytes sent across all clients");
+  out.printf("linklight_websocket_sent_bytes_total %u\n", (unsigned)webSocketBytesSent.load());
+
+  // Logs
+  out.header("linklight_log_messages_total", "counter", "Log messages by level");
+  for (int i = 0; i < METRICS_LOG_LEVELS; i++) {
+    out.printf("linklight_log_messages_total{level=\"%c\"} %u\n", LOG_LEVELS[i], (unsigned)logMessages[i].load());
+  }
+
+  // Heap
+  out.header("linklight_heap_free_bytes", "gauge", "Free heap");
+  out.printf("linklight_heap_free_bytes{heap=\"internal\"} %u\n", (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+  out.printf("linklight_heap_free_bytes{heap=\"psram\"} %u\n", (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+  out.header("linklight_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+  out.printf("linklight_heap_min_free_bytes{heap=\"internal\"} %u\n", (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+  out.printf("linklight_heap_min_free_bytes{heap=\"psram\"} %u\n", (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+  out.header("linklight_heap_largest_free_block_bytes", "gauge", "Largest free block, shrinks as the heap fragments");
+  out.printf("linklight_heap_largest_free_block_bytes{heap=\"internal\"} %u\n", (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+  out.printf("linklight_heap_largest_free_block_bytes{heap=\"psram\"} %u\n", (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+
+  out.flush();
+  // An empty chunk ends the response
+  server.sendContent("");
+}
@@ -14,6 +14,7 @@ void OTAManager::setup() {
   // Set hostname from preferences
   String hostname = preferencesManager.getHostname();
   ArduinoOTA.setHostname(hostname.c_str());
+  ArduinoOTA.setPort(OTA_PORT);
   LINK_LOGI(LOG_TAG, "OTA hostname set to: %s", hostname.c_str());
   
   // Set password if configured
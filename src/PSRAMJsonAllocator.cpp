@@ -0,0 +1,94 @@
+#include "PSRAMJsonAllocator.h"
+#include <esp_heap_caps.h>
+
+JsonAllocatorStats PSRAMJsonAllocator::stats[static_cast<int>(JsonPurpose::COUNT)];
+
+void* PSRAMJsonAllocator::allocate(size_t size) {
+  bool fellBack = false;
+  void* ptr = MemoryPools::allocate(MemoryPool::BULK_PSRAM, size, &fellBack);
+  if (ptr != nullptr) {
+    recordAllocate(purpose, heap_caps_get_allocated_size(ptr), fellBack);
+  }
+  return ptr;
+}
+
+void PSRAMJsonAllocator::deallocate(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  recordDeallocate(purpose, heap_caps_get_allocated_size(ptr));
+  MemoryPools::deallocate(MemoryPool::BULK_PSRAM, ptr);
+}
+
+void* PSRAMJsonAllocator::reallocate(void* ptr, size_t new_size) {
+  if (ptr == nullptr) {
+    return allocate(new_size);
+  }
+
+  size_t oldSize = heap_caps_get_allocated_size(ptr);
+  bool fellBack = false;
+  void* newPtr = MemoryPools::reallocate(MemoryPool::BULK_PSRAM, ptr, new_size, &fellBack);
+  if (newPtr != nullptr) {
+    recordReallocate(purpose, oldSize, heap_caps_get_allocated_size(newPtr), fellBack);
+  }
+  return newPtr;
+}
+
+PSRAMJsonAllocator* PSRAMJsonAllocator::instance(JsonPurpose purpose) {
+  static PSRAMJsonAllocator allocators[] = {
+    PSRAMJsonAllocator(JsonPurpose::INGEST),
+    PSRAMJsonAllocator(JsonPurpose::TRAINS),
+    PSRAMJsonAllocator(JsonPurpose::LEDS),
+    PSRAMJsonAllocator(JsonPurpose::LOGS),
+    PSRAMJsonAllocator(JsonPurpose::WS_INBOUND),
+    PSRAMJsonAllocator(JsonPurpose::API),
+  };
+  static_assert(sizeof(allocators) / sizeof(allocators[0]) == static_cast<size_t>(JsonPurpose::COUNT),
+                "One allocator per JSON purpose");
+  return &allocators[static_cast<int>(purpose)];
+}
+
+// Only a few atomic adds per call, cheap enough to leave on in production
+void PSRAMJsonAllocator::addLiveBytes(JsonPurpose purpose, size_t size) {
+  JsonAllocatorStats& purposeStats = stats[static_cast<int>(purpose)];
+  uint32_t live = purposeStats.liveBytes.fetch_add(size) + size;
+  uint32_t peak = purposeStats.peakBytes.load();
+  while (live > peak && !purposeStats.peakBytes.compare_exchange_weak(peak, live)) {
+  }
+}
+
+void PSRAMJsonAllocator::recordAllocate(JsonPurpose purpose, size_t size, bool fellBack) {
+  JsonAllocatorStats& purposeStats = stats[static_cast<int>(purpose)];
+  purposeStats.allocations++;
+  if (fellBack) {
+    purposeStats.fallbacks++;
+  }
+  addLiveBytes(purpose, size);
+}
+
+void PSRAMJsonAllocator::recordReallocate(JsonPurpose purpose, size_t oldSize, size_t newSize, bool fellBack) {
+  JsonAllocatorStats& purposeStats = stats[static_cast<int>(purpose)];
+  purposeStats.reallocations++;
+  if (fellBack) {
+    purposeStats.fallbacks++;
+  }
+  purposeStats.liveBytes -= oldSize;
+  addLiveBytes(purpose, newSize);
+}
+
+void PSRAMJsonAllocator::recordDeallocate(JsonPurpose purpose, size_t size) {
+  stats[static_cast<int>(purpose)].liveBytes -= size;
+}
+
+const char* PSRAMJsonAllocator::purposeToString(JsonPurpose purpose) {
+  switch (purpose) {
+    case JsonPurpose::INGEST: return "ingest";
+    case JsonPurpose::TRAINS: return "trains";
+    case JsonPurpose::LEDS: return "leds";
+    case JsonPurpose::LOGS: return "logs";
+    case JsonPurpose::WS_INBOUND: return "wsInbound";
+    case JsonPurpose::API: return "api";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,134 @@
+#include "PerfMonitor.h"
+#include <ArduinoJson.h>
+#include "PSRAMJsonAllocator.h"
+
+PerfMonitor perfMonitor;
+
+static int bucketIndex(uint32_t elapsedMicros) {
+  if (elapsedMicros < 2) {
+    return 0;
+  }
+  int index = 31 - __builtin_clz(elapsedMicros);
+  return index < PERF_BUCKET_COUNT ? index : PERF_BUCKET_COUNT - 1;
+}
+
+void PerfMonitor::record(PerfStage stage, uint32_t elapsedMicros) {
+  PerfHistogram& histogram = histograms[static_cast<int>(stage)];
+
+  portENTER_CRITICAL(&lock);
+  if (histogram.count == 0 || elapsedMicros < histogram.minMicros) {
+    histogram.minMicros = elapsedMicros;
+  }
+  if (elapsedMicros > histogram.maxMicros) {
+    histogram.maxMicros = elapsedMicros;
+  }
+  histogram.count++;
+  histogram.totalMicros += elapsedMicros;
+  histogram.buckets[bucketIndex(elapsedMicros)]++;
+  portEXIT_CRITICAL(&lock);
+}
+
+void PerfMonitor::reset() {
+  portENTER_CRITICAL(&lock);
+  for (PerfHistogram& histogram : histograms) {
+    histogram = PerfHistogram();
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+PerfHistogram PerfMonitor::getHistogram(PerfStage stage) const {
+  portENTER_CRITICAL(&lock);
+  PerfHistogram copy = histograms[static_cast<int>(stage)];
+  portEXIT_CRITICAL(&lock);
+  return copy;
+}
+
+uint32_t PerfMonitor::percentile(const PerfHistogram& histogram, unsigned int percent) {
+  if (histogram.count == 0) {
+    return 0;
+  }
+
+  // Rank of the sample we're looking for, rounded up so p100 is the last sample
+  uint32_t rank = (uint32_t)(((uint64_t)histogram.count * percent + 99) / 100);
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  uint32_t seen = 0;
+  for (int i = 0; i < PERF_BUCKET_COUNT; i++) {
+    uint32_t inBucket = histogram.buckets[i];
+    if (seen + inBucket < rank) {
+      seen += inBucket;
+      continue;
+    }
+
+    // Assume samples are spread evenly across the part of the bucket that was actually observed
+    uint64_t lower = i == 0 ? 0 : 1ULL << i;
+    uint64_t upper = i == PERF_BUCKET_COUNT - 1 ? histogram.maxMicros : 1ULL << (i + 1);
+    if (lower < histogram.minMicros) {
+      lower = histogram.minMicros;
+    }
+    if (upper > histogram.maxMicros) {
+      upper = histogram.maxMicros;
+    }
+    return (uint32_t)(lower + (upper - lower) * (rank - seen) / inBucket);
+  }
+
+  return histogram.maxMicros;
+}
+
+void PerfMonitor::getPerfAsJson(String& output) const {
+  JsonDocument doc(PSRAMJsonAllocator::instance());
+#ifdef LINKLIGHT_PERF
+  doc["enabled"] = true;
+#else
+  doc["enabled"] = false;
+#endif
+
+  JsonObject stages = doc["stages"].to<JsonObject>();
+  for (int i = 0; i < static_cast<int>(PerfStage::COUNT); i++) {
+    PerfStage stage = static_cast<PerfStage>(i);
+    PerfHistogram histogram = getHistogram(stage);
+
+    JsonObject stageObj = stages[stageToString(stage)].to<JsonObject>();
+    stageObj["count"] = histogram.count;
+    stageObj["minUs"] = histogram.minMicros;
+    stageObj["maxUs"] = histogram.maxMicros;
+    stageObj["meanUs"] = histogram.count > 0 ? (uint32_t)(histogram.totalMicros / histogram.count) : 0;
+    stageObj["p50Us"] = percentile(histogram, 50);
+    stageObj["p90Us"] = percentile(histogram, 90);
+    stageObj["p99Us"] = percentile(histogram, 99);
+
+    // Trailing empty buckets are left off to keep the response short
+    int lastBucket = PERF_BUCKET_COUNT - 1;
+    while (lastBucket >= 0 && histogram.buckets[lastBucket] == 0) {
+      lastBucket--;
+    }
+    JsonArray buckets = stageObj["buckets"].to<JsonArray>();
+    for (int bucket = 0; bucket <= lastBucket; bucket++) {
+      buckets.add(histogram.buckets[bucket]);
+    }
+  }
+
+  serializeJson(doc, output);
+}
+
+const char* PerfMonitor::stageToString(PerfStage stage) {
+  switch (stage) {
+    case PerfStage::UPDATE_CYCLE: return "updateCycle";
+    case PerfStage::HTTP_REQUEST: return "httpRequest";
+    case PerfStage::DOWNLOAD_PARSE: return "downloadParse";
+    case PerfStage::TRAIN_PARSE: return "trainParse";
+    case PerfStage::TRIP_JOIN: return "tripJoin";
+    case PerfStage::STATION_MAPPING: return "stationMapping";
+    case PerfStage::MUTEX_WAIT: return "mutexWait";
+    case PerfStage::MERGE: return "merge";
+    case PerfStage::LED_UPDATE: return "ledUpdate";
+    case PerfStage::LED_SHOW: return "ledShow";
+    case PerfStage::WS_BROADCAST: return "wsBroadcast";
+    case PerfStage::LOOP_DISPATCH: return "loopDispatch";
+    case PerfStage::RENDER_JITTER: return "renderJitter";
+    case PerfStage::LED_CORRECT: return "ledCorrect";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,206 @@
+#include "PixelStreamer.h"
+#include <WiFi.h>
+#include <errno.h>
+#include <lwip/sockets.h>
+#include <string.h>
+#include "LogManager.h"
+#include "PreferencesManager.h"
+
+static const char* LOG_TAG = "PixelStreamer";
+
+// Pixels go out straight from the frame, so they must be packed RGB bytes
+static_assert(sizeof(RgbColor) == 3, "RgbColor must be 3 packed bytes to stream frames without copying");
+
+PixelStreamer pixelStreamer;
+
+const char* PixelStreamer::protocolToString(StreamProtocol protocol) {
+  switch (protocol) {
+    case StreamProtocol::DDP:
+      return STREAM_PROTOCOL_DDP;
+    case StreamProtocol::E131:
+      return STREAM_PROTOCOL_E131;
+    default:
+      return STREAM_PROTOCOL_OFF;
+  }
+}
+
+// Parses the stream preferences, e.g. "192.168.1.50,192.168.1.51:4049", and hands them to the render task
+void PixelStreamer::configure() {
+  StreamConfig config;
+  String protocol = preferencesManager.getStreamProtocol();
+  if (protocol == STREAM_PROTOCOL_DDP) {
+    config.protocol = StreamProtocol::DDP;
+  } else if (protocol == STREAM_PROTOCOL_E131) {
+    config.protocol = StreamProtocol::E131;
+  }
+
+  unsigned int rate = preferencesManager.getStreamRate();
+  if (rate < 1 || rate > 60) {
+    rate = DEFAULT_STREAM_RATE;
+  }
+  config.intervalMs = 1000 / rate;
+  strncpy(config.sourceName, preferencesManager.getHostname().c_str(), E131_SOURCE_NAME_SIZE - 1);
+
+  uint16_t defaultPort = config.protocol == StreamProtocol::E131 ? E131_PORT : DDP_PORT;
+  String targets = preferencesManager.getStreamTargets();
+  int start = 0;
+  while (start < (int)targets.length()) {
+    int end = targets.indexOf(',', start);
+    if (end == -1) {
+      end = targets.length();
+    }
+
+    String entry = targets.substring(start, end);
+    entry.trim();
+    start = end + 1;
+    if (entry.isEmpty()) {
+      continue;
+    }
+
+    String host = entry;
+    long port = defaultPort;
+    int separator = entry.indexOf(':');
+    if (separator > 0) {
+      host = entry.substring(0, separator);
+      port = entry.substring(separator + 1).toInt();
+    }
+    IPAddress address;
+    if (!address.fromString(host) || port < 1 || port > 65535) {
+      LINK_LOGW(LOG_TAG, "Ignoring malformed stream target '%s'", entry.c_str());
+      continue;
+    }
+    if (config.targetCount == STREAM_MAX_TARGETS) {
+      LINK_LOGW(LOG_TAG, "Ignoring stream target '%s', at most %d are supported", entry.c_str(), STREAM_MAX_TARGETS);
+      continue;
+    }
+    config.targets[config.targetCount++] = {(uint32_t)address, (uint16_t)port};
+  }
+
+  portENTER_CRITICAL(&lock);
+  pending = config;
+  configSeq++;
+  portEXIT_CRITICAL(&lock);
+  enabled = config.protocol != StreamProtocol::OFF && config.targetCount > 0;
+
+  if (enabled) {
+    LINK_LOGI(LOG_TAG, "Streaming %s to %u targets at up to %u fps",
+              protocolToString(config.protocol), (unsigned int)config.targetCount, rate);
+  } else if (config.protocol != StreamProtocol::OFF) {
+    LINK_LOGW(LOG_TAG, "Streaming is %s but no valid targets are set", protocolToString(config.protocol));
+  }
+}
+
+void PixelStreamer::openSocket() {
+  sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    LINK_LOGE(LOG_TAG, "Failed to create stream socket: %d", errno);
+    return;
+  }
+
+  // E1.31 receivers recognize a sender by its CID, which stays the same across restarts
+  uint64_t mac = ESP.getEfuseMac();
+  memcpy(cid, "LinkLight", 9);
+  for (int i = 0; i < 6; i++) {
+    cid[10 + i] = (uint8_t)(mac >> (8 * i));
+  }
+}
+
+void PixelStreamer::update(const LEDFrame& frame, uint16_t ledCount) {
+  if (configSeq != activeSeq) {
+    portENTER_CRITICAL(&lock);
+    active = pending;
+    activeSeq = configSeq;
+    portEXIT_CRITICAL(&lock);
+    resend = true;
+  }
+
+  if (active.protocol == StreamProtocol::OFF || active.targetCount == 0 || WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+  if (sock < 0) {
+    openSocket();
+    if (sock < 0) {
+      // Retried after the next configure()
+      active.targetCount = 0;
+      return;
+    }
+  }
+
+  uint32_t now = millis();
+  uint32_t sinceSend = now - lastSendMillis;
+  if (sinceSend < active.intervalMs && !resend) {
+    return;
+  }
+
+  // FNV-1a, so an unchanged frame is skipped without keeping a copy of the last one sent
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(frame.pixels);
+  size_t length = ledCount * sizeof(RgbColor);
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  if (hash == lastFrameHash && sinceSend < STREAM_KEEPALIVE_MS && !resend) {
+    return;
+  }
+
+  if (active.protocol == StreamProtocol::DDP) {
+    sendDdp(data, length);
+  } else {
+    sendE131(data, length);
+  }
+  lastSendMillis = now;
+  lastFrameHash = hash;
+  resend = false;
+  framesSent++;
+}
+
+// Up to DDP_MAX_DATA bytes per packet, the last one flagged to push the frame to the display
+void PixelStreamer::sendDdp(const uint8_t* data, size_t length) {
+  ddpSequence = ddpSequence % 15 + 1;
+  for (size_t offset = 0; offset < length; offset += DDP_MAX_DATA) {
+    size_t chunk = length - offset < DDP_MAX_DATA ? length - offset : DDP_MAX_DATA;
+    writeDdpHeader(packetHeader, ddpSequence, offset, chunk, offset + chunk == length);
+    sendToTargets(packetHeader, DDP_HEADER_SIZE, data + offset, chunk);
+  }
+}
+
+// One universe per E131_UNIVERSE_PIXELS pixels, each with its own sequence number
+void PixelStreamer::sendE131(const uint8_t* data, size_t length) {
+  const size_t universeBytes = E131_UNIVERSE_PIXELS * sizeof(RgbColor);
+  size_t universe = 0;
+  for (size_t offset = 0; offset < length; offset += universeBytes, universe++) {
+    size_t chunk = length - offset < universeBytes ? length - offset : universeBytes;
+    writeE131Header(packetHeader, cid, active.sourceName, ++e131Sequence[universe],
+                    STREAM_E131_UNIVERSE + universe, chunk);
+    sendToTargets(packetHeader, E131_HEADER_SIZE, data + offset, chunk);
+  }
+}
+
+// The header and the pixels are separate buffers of one datagram, so the frame isn't copied here
+void PixelStreamer::sendToTargets(const uint8_t* header, size_t headerLength, const uint8_t* data, size_t length) {
+  struct iovec parts[2];
+  parts[0].iov_base = const_cast<uint8_t*>(header);
+  parts[0].iov_len = headerLength;
+  parts[1].iov_base = const_cast<uint8_t*>(data);
+  parts[1].iov_len = length;
+
+  for (size_t i = 0; i < active.targetCount; i++) {
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(active.targets[i].port);
+    address.sin_addr.s_addr = active.targets[i].address;
+
+    struct msghdr message = {};
+    message.msg_name = &address;
+    message.msg_namelen = sizeof(address);
+    message.msg_iov = parts;
+    message.msg_iovlen = 2;
+
+    // Never blocks the render task: a full send buffer drops the packet
+    if (sendmsg(sock, &message, MSG_DONTWAIT) < 0) {
+      sendErrors++;
+    } else {
+      packetsSent++;
+    }
+  }
+}
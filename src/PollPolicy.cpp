@@ -0,0 +1,146 @@
+#include "PollPolicy.h"
+#include "config.h"
+
+uint32_t PollPolicy::nextDelayMs(const PollSnapshot& snapshot, const PollLimits& limits, uint32_t nowMillis) {
+  apiCallsToday += snapshot.apiCalls;
+
+  uint32_t baseSeconds = limits.baseIntervalSeconds;
+  uint32_t delaySeconds = baseSeconds;
+  PollReason reason = PollReason::BASE_INTERVAL;
+
+  if (snapshot.fetchFailed) {
+    // Retry on the regular cadence; an empty list caused by a failure says nothing about service
+    consecutiveIdlePolls = 0;
+  } else if (snapshot.trainCount == 0) {
+    // No trains running (e.g. overnight), so back off exponentially up to the idle ceiling
+    consecutiveIdlePolls++;
+    uint32_t shift = consecutiveIdlePolls < 8 ? consecutiveIdlePolls : 8;
+    delaySeconds = baseSeconds << shift;
+    if (delaySeconds > MAX_IDLE_POLL_INTERVAL) {
+      delaySeconds = MAX_IDLE_POLL_INTERVAL;
+    }
+    reason = PollReason::IDLE_BACKOFF;
+  } else {
+    consecutiveIdlePolls = 0;
+
+    // Poll just after the next train is due to reach its station so the LED flips on time
+    if (snapshot.soonestArrivalSeconds >= 0) {
+      uint32_t arrivalSeconds = snapshot.soonestArrivalSeconds + POLL_ARRIVAL_MARGIN;
+      if (arrivalSeconds < MIN_POLL_INTERVAL) {
+        arrivalSeconds = MIN_POLL_INTERVAL;
+      }
+      if (arrivalSeconds < delaySeconds) {
+        delaySeconds = arrivalSeconds;
+        reason = PollReason::TRAIN_ARRIVING;
+      }
+    }
+  }
+
+  // Spread the remaining daily budget evenly over the rest of the day
+  unsigned int budget = limits.dailyApiBudget;
+  unsigned int callsPerPoll = snapshot.apiCalls > 0 ? snapshot.apiCalls : 1;
+  if (budget > 0) {
+    uint32_t secondsLeft = limits.secondsLeftInDay;
+    unsigned int remainingCalls = apiCallsToday < budget ? budget - apiCallsToday : 0;
+    uint32_t budgetSeconds;
+    if (remainingCalls < callsPerPoll) {
+      // Budget exhausted, wait until the count resets
+      budgetSeconds = secondsLeft;
+    } else {
+      budgetSeconds = (uint32_t)((uint64_t)secondsLeft * callsPerPoll / remainingCalls);
+    }
+
+    if (budgetSeconds > delaySeconds) {
+      delaySeconds = budgetSeconds;
+      reason = PollReason::DAILY_BUDGET;
+    }
+  }
+
+  uint32_t delayMs = delaySeconds * 1000;
+
+  // Land the poll just after the upstream feed is expected to refresh so the data shown is as new as possible.
+  // Idle back-off has no vehicles to learn from. A budget-driven delay must never be shortened, and an arrival
+  // poll waits for the first refresh after the arrival, since an earlier one can't show the train at the station.
+  if (snapshot.feedRefreshKnown) {
+    learnFeedPeriod(snapshot.feedRefreshMillis);
+  }
+  if (feedPeriodMs > 0 && reason != PollReason::IDLE_BACKOFF) {
+    bool roundUp = reason == PollReason::DAILY_BUDGET || reason == PollReason::TRAIN_ARRIVING;
+    delayMs = alignToFeedRefresh(delayMs, roundUp, nowMillis);
+  }
+
+  lastReason = reason;
+  return delayMs;
+}
+
+// Learns the upstream refresh period from the newest vehicle update time seen on each poll. Polls usually
+// land several refreshes apart, so each observed gap is divided by the nearest whole number of periods
+// and folded into a running average.
+void PollPolicy::learnFeedPeriod(uint32_t refreshMillis) {
+  if (!feedAnchorValid) {
+    feedAnchorMillis = refreshMillis;
+    feedAnchorValid = true;
+    return;
+  }
+
+  int32_t delta = (int32_t)(refreshMillis - feedAnchorMillis);
+  if (delta < FEED_MIN_PERIOD / 2) {
+    // Same refresh seen again (or older data from a lagging route), nothing new to learn
+    return;
+  }
+  feedAnchorMillis = refreshMillis;
+
+  if (delta > FEED_MAX_PERIOD * 8) {
+    // Too far apart to say anything about the period, e.g. after an idle back-off
+    return;
+  }
+
+  uint32_t sample;
+  uint32_t periods = feedPeriodMs > 0 ? (delta + feedPeriodMs / 2) / feedPeriodMs : 0;
+  if (periods == 0) {
+    // First measurement, or the feed refreshed faster than the current estimate
+    sample = delta;
+    feedPeriodMs = 0;
+  } else {
+    sample = delta / periods;
+  }
+
+  if (feedPeriodMs == 0) {
+    feedPeriodMs = sample;
+  } else {
+    feedPeriodMs += ((int32_t)sample - (int32_t)feedPeriodMs) / 4;
+  }
+  if (feedPeriodMs < FEED_MIN_PERIOD) {
+    feedPeriodMs = FEED_MIN_PERIOD;
+  } else if (feedPeriodMs > FEED_MAX_PERIOD) {
+    feedPeriodMs = FEED_MAX_PERIOD;
+  }
+}
+
+// Moves a poll delay onto the expected refresh nearest to it, or the first one at or after it when roundUp is set.
+// Rounding to the nearest refresh keeps the average request rate the same while removing most of the
+// time data sits upstream before we fetch it.
+uint32_t PollPolicy::alignToFeedRefresh(uint32_t desiredMs, bool roundUp, uint32_t nowMillis) const {
+  uint32_t sinceAnchor = nowMillis - feedAnchorMillis;
+  if (sinceAnchor > FEED_MAX_PERIOD * 4) {
+    // The feed hasn't advanced in a long time, so its phase is no longer meaningful
+    return desiredMs;
+  }
+
+  uint32_t target = sinceAnchor + desiredMs;
+  uint32_t targetRefresh = target > FEED_REFRESH_MARGIN ? target - FEED_REFRESH_MARGIN : 0;
+  uint32_t periods = roundUp
+    ? (targetRefresh + feedPeriodMs - 1) / feedPeriodMs
+    : (targetRefresh + feedPeriodMs / 2) / feedPeriodMs;
+
+  // Always wait for a refresh we haven't fetched yet, and never poll faster than the minimum interval
+  if (periods < 1) {
+    periods = 1;
+  }
+  uint32_t aligned = periods * feedPeriodMs + FEED_REFRESH_MARGIN;
+  while (aligned < sinceAnchor + MIN_POLL_INTERVAL * 1000) {
+    aligned += feedPeriodMs;
+  }
+
+  return aligned - sinceAnchor;
+}
@@ -0,0 +1,88 @@
+#include "PollScheduler.h"
+#include <time.h>
+#include "LogManager.h"
+#include "PreferencesManager.h"
+
+static const char* LOG_TAG = "PollScheduler";
+static const uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+// Any time before this means NTP hasn't synchronized yet, so fall back to uptime-based days
+static const time_t MIN_VALID_EPOCH = 1700000000;
+
+PollScheduler pollScheduler;
+
+long PollScheduler::currentDayIndex() const {
+  time_t now = time(nullptr);
+  if (now < MIN_VALID_EPOCH) {
+    return -1 - static_cast<long>(millis() / 1000 / SECONDS_PER_DAY);
+  }
+
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  return timeinfo.tm_year * 1000L + timeinfo.tm_yday;
+}
+
+uint32_t PollScheduler::secondsLeftInDay() const {
+  time_t now = time(nullptr);
+  if (now < MIN_VALID_EPOCH) {
+    return SECONDS_PER_DAY - (millis() / 1000) % SECONDS_PER_DAY;
+  }
+
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  uint32_t secondsIntoDay = timeinfo.tm_hour * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec;
+  return SECONDS_PER_DAY - secondsIntoDay;
+}
+
+// Resets the API call count at local midnight (or every 24 hours of uptime if the clock isn't set).
+void PollScheduler::rollOverDay() {
+  long today = currentDayIndex();
+  if (today != dayIndex) {
+    if (dayIndex != -1) {
+      LINK_LOGI(LOG_TAG, "New day, %u API calls made yesterday", policy.getApiCallsToday());
+    }
+    dayIndex = today;
+    policy.startDay();
+  }
+}
+
+uint32_t PollScheduler::nextPollDelayMs(const PollSnapshot& snapshot) {
+  rollOverDay();
+  if (wakeRequested.exchange(false)) {
+    policy.resetIdleBackoff();
+  }
+
+  PollLimits limits;
+  limits.baseIntervalSeconds = preferencesManager.getUpdateInterval();
+  limits.dailyApiBudget = preferencesManager.getDailyApiBudget();
+  limits.secondsLeftInDay = secondsLeftInDay();
+  lastDelayMs = policy.nextDelayMs(snapshot, limits, millis());
+
+  LINK_LOGD(LOG_TAG, "Next poll in %lu ms (%s), feed period %lu ms, %u trains, %u API calls today (budget %u)",
+            (unsigned long)lastDelayMs, reasonToString(policy.getLastReason()), (unsigned long)policy.getFeedPeriodMs(),
+            snapshot.trainCount, policy.getApiCallsToday(), limits.dailyApiBudget);
+
+  return lastDelayMs;
+}
+
+void PollScheduler::waitForNextPoll(uint32_t delayMs) {
+  // A notification from wake() ends the wait early
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(delayMs));
+}
+
+void PollScheduler::wake() {
+  // The poll task owns the policy, so it drops the idle back-off itself when it next picks a delay
+  wakeRequested = true;
+  if (pollTask != nullptr) {
+    xTaskNotifyGive(pollTask);
+  }
+}
+
+const char* PollScheduler::reasonToString(PollReason reason) {
+  switch (reason) {
+    case PollReason::TRAIN_ARRIVING: return "train arriving";
+    case PollReason::IDLE_BACKOFF: return "idle backoff";
+    case PollReason::DAILY_BUDGET: return "daily budget";
+    case PollReason::BASE_INTERVAL:
+    default: return "base interval";
+  }
+}
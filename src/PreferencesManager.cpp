@@ -1,5 +1,7 @@
 #include "PreferencesManager.h"
 #include "LogManager.h"
+#include "ColorCorrection.h"
+#include "colors.h"
 #include "config.h"
 
 static const char* LOG_TAG = "PreferencesManager";
@@ -16,16 +18,61 @@ void PreferencesManager::load() {
   timezone = preferences.getString(PREF_TIMEZONE, DEFAULT_TIMEZONE);
   updateInterval = preferences.getUInt(PREF_UPDATE_INTERVAL, DEFAULT_UPDATE_INTERVAL);
   atStationThreshold = preferences.getUInt(PREF_AT_STATION_THRESHOLD, DEFAULT_AT_STATION_THRESHOLD);
+  dailyApiBudget = preferences.getUInt(PREF_DAILY_API_BUDGET, DEFAULT_DAILY_API_BUDGET);
+  freshnessTarget = preferences.getUInt(PREF_FRESHNESS_TARGET, DEFAULT_FRESHNESS_TARGET);
+  renderRate = preferences.getUInt(PREF_RENDER_RATE, DEFAULT_RENDER_RATE);
+  brightness = preferences.getUInt(PREF_BRIGHTNESS, DEFAULT_BRIGHTNESS);
+  nightBrightness = preferences.getUInt(PREF_NIGHT_BRIGHTNESS, DEFAULT_NIGHT_BRIGHTNESS);
+  nightStart = preferences.getUInt(PREF_NIGHT_START, DEFAULT_NIGHT_START);
+  nightEnd = preferences.getUInt(PREF_NIGHT_END, DEFAULT_NIGHT_END);
+  streamProtocol = preferences.getString(PREF_STREAM_PROTOCOL, DEFAULT_STREAM_PROTOCOL);
+  streamTargets = preferences.getString(PREF_STREAM_TARGETS, DEFAULT_STREAM_TARGETS);
+  streamRate = preferences.getUInt(PREF_STREAM_RATE, DEFAULT_STREAM_RATE);
+  ingestMode = preferences.getString(PREF_INGEST_MODE, DEFAULT_INGEST_MODE);
+  routeLines = preferences.getString(PREF_ROUTE_LINES, DEFAULT_ROUTE_LINES);
+  apiBaseUrl = preferences.getString(PREF_API_BASE_URL, DEFAULT_API_BASE_URL);
   line1Color = preferences.getString(PREF_LINE1_COLOR, DEFAULT_LINE1_COLOR);
   line2Color = preferences.getString(PREF_LINE2_COLOR, DEFAULT_LINE2_COLOR);
   sharedColor = preferences.getString(PREF_SHARED_COLOR, DEFAULT_SHARED_COLOR);
+  unsigned int colorSpace = preferences.getUInt(PREF_COLOR_SPACE, 0);
   
   preferences.end();
+
+  if (colorSpace < COLOR_SPACE_VERSION) {
+    migrateColorSpace();
+  }
   
   // focusedVehicleId is not persisted - always starts empty on boot
   focusedVehicleId = "";
   }
 
+// Colors saved before the correction stage were picked to look right on an uncorrected strip. Runs them through
+// the inverse gamma once so they look the same with gamma 2.2 applied, then records the color space so it never
+// happens again.
+void PreferencesManager::migrateColorSpace() {
+  preferences.begin(PREF_NAMESPACE, false);
+  migrateColor(PREF_LINE1_COLOR, line1Color);
+  migrateColor(PREF_LINE2_COLOR, line2Color);
+  migrateColor(PREF_SHARED_COLOR, sharedColor);
+  preferences.putUInt(PREF_COLOR_SPACE, COLOR_SPACE_VERSION);
+  preferences.end();
+}
+
+void PreferencesManager::migrateColor(const char* key, String& color) {
+  // A color that was never saved is the default, which is already picked for the corrected strip
+  if (!preferences.isKey(key)) {
+    return;
+  }
+
+  RgbColor saved = ColorManager::hexToRgb(color);
+  char converted[8];
+  snprintf(converted, sizeof(converted), "#%02X%02X%02X", ColorCorrection::inverseGamma(saved.R),
+           ColorCorrection::inverseGamma(saved.G), ColorCorrection::inverseGamma(saved.B));
+  LINK_LOGI(LOG_TAG, "Converted saved %s from %s to %s for gamma correction", key, color.c_str(), converted);
+  color = converted;
+  preferences.putString(key, color);
+}
+
 void PreferencesManager::save() {
   LINK_LOGD(LOG_TAG, "Saving preferences...");
   
@@ -36,6 +83,19 @@ void PreferencesManager::save() {
   preferences.putString(PREF_TIMEZONE, timezone);
   preferences.putUInt(PREF_UPDATE_INTERVAL, updateInterval);
   preferences.putUInt(PREF_AT_STATION_THRESHOLD, atStationThreshold);
+  preferences.putUInt(PREF_DAILY_API_BUDGET, dailyApiBudget);
+  preferences.putUInt(PREF_FRESHNESS_TARGET, freshnessTarget);
+  preferences.putUInt(PREF_RENDER_RATE, renderRate);
+  preferences.putUInt(PREF_BRIGHTNESS, brightness);
+  preferences.putUInt(PREF_NIGHT_BRIGHTNESS, nightBrightness);
+  preferences.putUInt(PREF_NIGHT_START, nightStart);
+  preferences.putUInt(PREF_NIGHT_END, nightEnd);
+  preferences.putString(PREF_STREAM_PROTOCOL, streamProtocol);
+  preferences.putString(PREF_STREAM_TARGETS, streamTargets);
+  preferences.putUInt(PREF_STREAM_RATE, streamRate);
+  preferences.putString(PREF_INGEST_MODE, ingestMode);
+  preferences.putString(PREF_ROUTE_LINES, routeLines);
+  preferences.putString(PREF_API_BASE_URL, apiBaseUrl);
   preferences.putString(PREF_LINE1_COLOR, line1Color);
   preferences.putString(PREF_LINE2_COLOR, line2Color);
   preferences.putString(PREF_SHARED_COLOR, sharedColor);
@@ -0,0 +1,47 @@
+#include "RecordingPixelOutput.h"
+
+bool RecordingPixelOutput::begin(uint16_t ledCount) {
+  count = ledCount;
+  showCount = 0;
+  next = 0;
+  kept = 0;
+  frames.assign(maxFrames * frameSize(), 0);
+  return true;
+}
+
+void RecordingPixelOutput::show(const LEDFrame& frame) {
+  showCount++;
+  if (maxFrames == 0) {
+    if (file != nullptr) {
+      for (uint16_t i = 0; i < count; i++) {
+        uint8_t rgb[3] = {frame.pixels[i].R, frame.pixels[i].G, frame.pixels[i].B};
+        fwrite(rgb, 1, sizeof(rgb), file);
+      }
+    }
+    return;
+  }
+
+  // Overwrites the oldest frame once the ring is full
+  uint8_t* out = &frames[next * frameSize()];
+  for (uint16_t i = 0; i < count; i++) {
+    out[i * 3] = frame.pixels[i].R;
+    out[i * 3 + 1] = frame.pixels[i].G;
+    out[i * 3 + 2] = frame.pixels[i].B;
+  }
+  next = (next + 1) % maxFrames;
+  if (kept < maxFrames) {
+    kept++;
+  }
+
+  if (file != nullptr) {
+    fwrite(out, 1, frameSize(), file);
+  }
+}
+
+RgbColor RecordingPixelOutput::getPixel(uint16_t led) const {
+  if (kept == 0 || led >= count) {
+    return RgbColor(0, 0, 0);
+  }
+  const uint8_t* rgb = getFrame(kept - 1) + led * 3;
+  return RgbColor(rgb[0], rgb[1], rgb[2]);
+}
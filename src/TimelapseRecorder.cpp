@@ -0,0 +1,204 @@
+#include "TimelapseRecorder.h"
+#include <string.h>
+#include "LogManager.h"
+#include "MemoryPools.h"
+
+static const char* LOG_TAG = "Timelapse";
+
+static const size_t BODY_START = 3;  // Room in scratch for the body length varint
+
+TimelapseRecorder timelapseRecorder;
+
+static size_t writeVarint(uint8_t* out, uint32_t value) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = (uint8_t)value;
+  return length;
+}
+
+uint32_t TimelapseRecorder::readVarint(uint32_t& position) const {
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    uint8_t byte = readByte(position++);
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  return value;
+}
+
+void TimelapseRecorder::record(const uint8_t* masks, uint16_t ledCount, uint32_t nowMillis) {
+  if (buffer == nullptr) {
+    if (allocationFailed) {
+      return;
+    }
+    buffer = static_cast<uint8_t*>(MemoryPools::allocate(MemoryPool::BULK_PSRAM, TIMELAPSE_BUFFER_SIZE));
+    if (buffer == nullptr) {
+      LINK_LOGE(LOG_TAG, "Failed to allocate %u byte timelapse buffer, not recording", (unsigned)TIMELAPSE_BUFFER_SIZE);
+      allocationFailed = true;
+      return;
+    }
+  }
+
+  uint32_t startMicros = micros();
+  bool keyframe = recordCount == 0 || nowMillis - lastKeyframeMillis >= TIMELAPSE_KEYFRAME_INTERVAL;
+  uint8_t* body = scratch + BODY_START;
+  size_t length = 0;
+  if (keyframe) {
+    length += writeVarint(body, 1);
+    memcpy(body + length, &nowMillis, sizeof(nowMillis));
+    length += sizeof(nowMillis);
+  } else {
+    length += writeVarint(body, (nowMillis - lastRecordMillis) << 1);
+  }
+  size_t timeLength = length;
+
+  // A keyframe lists every lit LED, a delta only the ones that changed
+  int previous = -1;
+  for (int led = 0; led < ledCount; led++) {
+    if (keyframe ? masks[led] == 0 : masks[led] == lastMasks[led]) {
+      continue;
+    }
+    length += writeVarint(body + length, ((uint32_t)(led - previous - 1) << 2) | (masks[led] & 0x03));
+    previous = led;
+  }
+  if (!keyframe && length == timeLength) {
+    return;
+  }
+
+  uint8_t lengthBytes[BODY_START];
+  size_t lengthLength = writeVarint(lengthBytes, length);
+  append(lengthBytes, lengthLength);
+  append(body, length);
+
+  memcpy(lastMasks, masks, ledCount);
+  if (recordCount == 0) {
+    firstRecordMillis = nowMillis;
+  }
+  if (keyframe) {
+    lastKeyframeMillis = nowMillis;
+    keyframeCount++;
+  }
+  lastRecordMillis = nowMillis;
+  recordCount++;
+
+  uint32_t elapsed = micros() - startMicros;
+  averageRecordMicros = averageRecordMicros == 0 ? elapsed
+                                                 : averageRecordMicros + ((int32_t)elapsed - (int32_t)averageRecordMicros) / 16;
+}
+
+// Copies into the ring, first dropping as many of the oldest records as it takes to fit
+void TimelapseRecorder::append(const uint8_t* data, size_t length) {
+  while (head - tail + length > TIMELAPSE_BUFFER_SIZE) {
+    dropOldest();
+  }
+  size_t offset = head % TIMELAPSE_BUFFER_SIZE;
+  size_t first = TIMELAPSE_BUFFER_SIZE - offset < length ? TIMELAPSE_BUFFER_SIZE - offset : length;
+  memcpy(buffer + offset, data, first);
+  memcpy(buffer, data + first, length - first);
+  head += length;
+}
+
+void TimelapseRecorder::dropOldest() {
+  uint32_t position = tail;
+  uint32_t length = readVarint(position);
+  tail = position + length;
+}
+
+// Reads the record at position. Delta times are relative to previousMillis, the time of the record before it.
+bool TimelapseRecorder::readHeader(uint32_t position, uint32_t previousMillis, RecordHeader& header) const {
+  if ((int32_t)(position - tail) < 0 || position == head) {
+    return false;
+  }
+  uint32_t length = readVarint(position);
+  header.end = position + length;
+  uint32_t time = readVarint(position);
+  header.keyframe = time == 1;
+  if (header.keyframe) {
+    uint8_t bytes[sizeof(uint32_t)];
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+      bytes[i] = readByte(position++);
+    }
+    memcpy(&header.millis, bytes, sizeof(header.millis));
+  } else {
+    header.millis = previousMillis + (time >> 1);
+  }
+  header.bodyStart = position;
+  return true;
+}
+
+bool TimelapseRecorder::seek(uint32_t startMillis, TimelapseCursor& cursor) const {
+  if (buffer == nullptr) {
+    return false;
+  }
+
+  // Only keyframes carry an absolute time, so records before the first one kept can't be placed
+  bool found = false;
+  uint32_t position = tail;
+  RecordHeader header;
+  while (readHeader(position, 0, header)) {
+    if (header.keyframe) {
+      if (found && (int32_t)(header.millis - startMillis) > 0) {
+        break;
+      }
+      cursor.position = position;
+      cursor.millis = header.millis;
+      found = true;
+    }
+    position = header.end;
+  }
+  return found;
+}
+
+int TimelapseRecorder::replay(TimelapseCursor& cursor, uint32_t untilMillis, uint8_t* masks, uint16_t ledCount) const {
+  if ((int32_t)(cursor.position - tail) < 0) {
+    return -1;
+  }
+
+  int applied = 0;
+  RecordHeader header;
+  while (readHeader(cursor.position, cursor.millis, header) && (int32_t)(header.millis - untilMillis) <= 0) {
+    if (header.keyframe) {
+      memset(masks, 0, ledCount);
+    }
+    uint32_t position = header.bodyStart;
+    int led = -1;
+    while (position != header.end) {
+      uint32_t entry = readVarint(position);
+      led += (int)(entry >> 2) + 1;
+      if (led < ledCount) {
+        masks[led] = (uint8_t)(entry & 0x03);
+      }
+    }
+    cursor.position = header.end;
+    cursor.millis = header.millis;
+    applied++;
+  }
+  return applied;
+}
+
+TimelapseStats TimelapseRecorder::getStats(uint32_t nowMillis) const {
+  TimelapseStats stats;
+  stats.capacity = buffer != nullptr ? TIMELAPSE_BUFFER_SIZE : 0;
+  stats.bytesUsed = head - tail;
+  stats.bytesWritten = head;
+  stats.records = recordCount;
+  stats.keyframes = keyframeCount;
+  stats.averageRecordMicros = averageRecordMicros;
+
+  TimelapseCursor oldest;
+  if (seek(firstRecordMillis, oldest)) {
+    stats.spanSeconds = (lastRecordMillis - oldest.millis) / 1000;
+  }
+
+  // Needs a minute of recording to say anything useful
+  uint32_t recordingMillis = nowMillis - firstRecordMillis;
+  if (recordCount > 0 && recordingMillis >= 60000) {
+    stats.bytesPerDay = (uint32_t)((uint64_t)head * 86400000ULL / recordingMillis);
+  }
+  return stats;
+}
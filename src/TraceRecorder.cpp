@@ -0,0 +1,101 @@
+#include "TraceRecorder.h"
+#include <ArduinoJson.h>
+#include "LogManager.h"
+#include "MemoryPools.h"
+#include "PSRAMJsonAllocator.h"
+
+static const char* LOG_TAG = "TraceRecorder";
+static const int MAX_TRACED_TASKS = 8;
+
+static_assert((TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) == 0, "TRACE_BUFFER_SIZE must be a power of two");
+
+TraceRecorder traceRecorder;
+
+void TraceRecorder::setEnabled(bool enable) {
+  if (enable && events == nullptr) {
+    // Kept once allocated, since a task on the other core may still be writing into it after tracing is disabled
+    events = static_cast<TraceEvent*>(MemoryPools::allocate(MemoryPool::HOT_INTERNAL, sizeof(TraceEvent) * TRACE_BUFFER_SIZE));
+    if (events == nullptr) {
+      LINK_LOGE(LOG_TAG, "Failed to allocate trace buffer of %u events", (unsigned)TRACE_BUFFER_SIZE);
+      return;
+    }
+  }
+
+  if (enable && !isEnabled()) {
+    writeIndex.store(0);
+  }
+  enabled.store(enable);
+  LINK_LOGI(LOG_TAG, "Tracing %s", enable ? "enabled" : "disabled");
+}
+
+void TraceRecorder::getTraceAsJson(String& output) {
+  // Stop recording so the ring doesn't move underneath the export, and give in-flight events time to land
+  bool wasEnabled = enabled.exchange(false);
+  if (wasEnabled) {
+    delay(1);
+  }
+
+  JsonDocument doc(PSRAMJsonAllocator::instance());
+  doc["displayTimeUnit"] = "ms";
+  JsonArray traceEvents = doc["traceEvents"].to<JsonArray>();
+
+  // Each core is shown as a process so their timelines sit side by side
+  for (int core = 0; core < 2; core++) {
+    JsonObject meta = traceEvents.add<JsonObject>();
+    meta["name"] = "process_name";
+    meta["ph"] = "M";
+    meta["pid"] = core;
+    meta["args"]["name"] = core == 0 ? "Core 0" : "Core 1";
+  }
+
+  uint32_t total = writeIndex.load();
+  uint32_t count = total < TRACE_BUFFER_SIZE ? total : TRACE_BUFFER_SIZE;
+  TaskHandle_t tasks[MAX_TRACED_TASKS] = {};
+  bool namedTask[MAX_TRACED_TASKS][2] = {};
+  int taskCount = 0;
+
+  if (events != nullptr && count > 0) {
+    uint32_t first = total - count;
+    uint32_t startMicros = events[first & (TRACE_BUFFER_SIZE - 1)].timestampMicros;
+
+    for (uint32_t i = first; i < total; i++) {
+      const TraceEvent& event = events[i & (TRACE_BUFFER_SIZE - 1)];
+
+      // Tasks become threads, numbered in the order they first appear
+      int tid = 0;
+      while (tid < taskCount && tasks[tid] != event.task) {
+        tid++;
+      }
+      if (tid == taskCount) {
+        if (taskCount == MAX_TRACED_TASKS) {
+          continue;
+        }
+        tasks[taskCount++] = event.task;
+      }
+      int core = event.core < 2 ? event.core : 1;
+      if (!namedTask[tid][core]) {
+        namedTask[tid][core] = true;
+        JsonObject meta = traceEvents.add<JsonObject>();
+        meta["name"] = "thread_name";
+        meta["ph"] = "M";
+        meta["pid"] = core;
+        meta["tid"] = tid + 1;
+        meta["args"]["name"] = pcTaskGetName(event.task);
+      }
+
+      JsonObject traceEvent = traceEvents.add<JsonObject>();
+      traceEvent["name"] = event.name;
+      traceEvent["ph"] = event.phase == 'B' ? "B" : "E";
+      // Unsigned subtraction unwraps the 32-bit timestamps as long as the ring spans less than 71 minutes
+      traceEvent["ts"] = event.timestampMicros - startMicros;
+      traceEvent["pid"] = core;
+      traceEvent["tid"] = tid + 1;
+    }
+  }
+
+  serializeJson(doc, output);
+
+  if (wasEnabled) {
+    enabled.store(true);
+  }
+}
@@ -6,27 +6,262 @@
 #include "config.h"
 #include "PreferencesManager.h"
 #include "PSRAMJsonAllocator.h"
-#include "PSRAMString.h"
+#include "PerfMonitor.h"
+#include "TraceRecorder.h"
+#include "Metrics.h"
+#include "FreshnessMonitor.h"
 #include "StopData.h"
+#include "LEDLayout.h"
+#include <esp_heap_caps.h>
 
 static const char* LOG_TAG = "TrainDataManager";
 static const float MIN_SCHEDULED_DISTANCE_THRESHOLD = 0.001f;
 
 TrainDataManager trainDataManager;
 
-// PSRAM-backed map types for temporary data structures
-// Using PSRAM allocator for both the map nodes and the String-to-PSRAMString conversions
-template<typename Key, typename Value>
-using PSRAMMap = std::map<Key, Value, std::less<Key>, esp32_psram::AllocatorPSRAM<std::pair<const Key, Value>>>;
+// Adds the trips from the response's references section to the trip cache. Returns false if the response had no
+// trips, which is expected when the cache was warm and references were filtered out.
+static bool cacheTrips(JsonObject data, TripCache& tripCache) {
+  PERF_SCOPE(PerfStage::TRIP_JOIN);
+  JsonArray trips = data["references"]["trips"];
+  if (trips.isNull()) {
+    return false;
+  }
 
-// Trip information structure
-struct TripInfo {
-  TrainDirection directionId;
-  String routeId;
-  String tripHeadsign;
-};
+  for (JsonObject trip : trips) {
+    // directionId is a string in the API, but accept a number too
+    JsonVariant direction = trip["directionId"];
+    bool northbound = direction.is<const char*>() ? strcmp(direction.as<const char*>(), "1") == 0 : direction.as<int>() == 1;
+    tripCache.insert(trip["id"] | "", northbound ? TrainDirection::NORTHBOUND : TrainDirection::SOUTHBOUND,
+                     trip["routeId"] | "", trip["tripHeadsign"] | "");
+  }
+  return true;
+}
+
+// Builds a deserialization filter that keeps only the fields the parsers read. Schedules, stops, routes and
+// agencies are always dropped; trip references are only kept while the trip cache needs filling.
+static void buildResponseFilter(JsonDocument& filter, bool includeTrips) {
+  filter["currentTime"] = true;
+  JsonObject item = filter["data"]["list"].add<JsonObject>();
+  item["tripId"] = true;
+  item["status"] = true;      // trips-for-route
+  item["tripStatus"] = true;  // vehicles-for-agency
+  if (includeTrips) {
+    JsonObject trip = filter["data"]["references"]["trips"].add<JsonObject>();
+    trip["id"] = true;
+    trip["directionId"] = true;
+    trip["routeId"] = true;
+    trip["tripHeadsign"] = true;
+  }
+}
+
+// Looks up the display name for a stop ID, falling back to the ID itself
+static const char* lookupStopName(const char* stopId, const char* field) {
+  auto stopIt = STOP_ID_TO_NAME.find(stopId);
+  if (stopIt != STOP_ID_TO_NAME.end()) {
+    return stopIt->second.c_str();
+  }
+  LINK_LOGW(LOG_TAG, "Stop name not found for %s ID: %s", field, stopId);
+  return stopId;
+}
+
+// Re-parses the route-to-line preference, e.g. "40_100479:1,40_2LINE:2", when it has changed since the last cycle
+void TrainDataManager::refreshRouteLines() {
+  String routeLines = preferencesManager.getRouteLines();
+  if (routeLines == routeLinesSource) {
+    return;
+  }
+  routeLinesSource = routeLines;
+  routeLineList.clear();
+
+  int start = 0;
+  while (start < (int)routeLines.length()) {
+    int end = routeLines.indexOf(',', start);
+    if (end == -1) {
+      end = routeLines.length();
+    }
+
+    String entry = routeLines.substring(start, end);
+    entry.trim();
+    int separator = entry.lastIndexOf(':');
+    if (separator > 0) {
+      String routeId = entry.substring(0, separator);
+      int lineNumber = entry.substring(separator + 1).toInt();
+      if (lineNumber == static_cast<int>(Line::LINE_1) || lineNumber == static_cast<int>(Line::LINE_2)) {
+        routeLineList.push_back({routeId, static_cast<Line>(lineNumber)});
+      } else {
+        LINK_LOGW(LOG_TAG, "Ignoring route mapping '%s', unknown line %d", entry.c_str(), lineNumber);
+      }
+    } else if (!entry.isEmpty()) {
+      LINK_LOGW(LOG_TAG, "Ignoring malformed route mapping '%s'", entry.c_str());
+    }
+
+    start = end + 1;
+  }
+}
+
+const RouteLine* TrainDataManager::findRouteLine(const String& routeId) const {
+  for (const RouteLine& routeLine : routeLineList) {
+    if (routeLine.routeId == routeId) {
+      return &routeLine;
+    }
+  }
+  return nullptr;
+}
+
+// Parses a single trip status object into a StagedTrain and adds it to the staging list. Strings are copied
+// into the cycle arena. Returns false if the status is missing fields needed to place the train.
+bool TrainDataManager::addTrainFromStatus(JsonObject status, const char* tripId, Line line, const TripInfo* tripInfo,
+                                          uint32_t snapshotMillis, int64_t& newestUpdateTime) {
+  StagedTrain train;
+  train.tripId = cycleArena.copyString(tripId);
+
+  // Extract vehicleId from status.vehicleId
+  const char* vehicleId = status["vehicleId"] | "";
+  if (*vehicleId != '\0') {
+    train.vehicleId = cycleArena.copyString(vehicleId);
+  } else {
+    // Fall back to last part of tripId if vehicleId is empty. If no underscore found, use the whole tripId.
+    const char* lastUnderscore = strrchr(train.tripId, '_');
+    train.vehicleId = (lastUnderscore != nullptr && lastUnderscore[1] != '\0') ? lastUnderscore + 1 : train.tripId;
+  }
+
+  // Check for nextStop
+  if (status["nextStop"].isNull()) {
+    LINK_LOGW(LOG_TAG, "No next stop for vehicle %s", train.vehicleId);
+    return false;
+  }
+  train.nextStop = cycleArena.copyString(status["nextStop"].as<const char*>());
+
+  // Check for nextStopTimeOffset
+  if (status["nextStopTimeOffset"].isNull()) {
+    LINK_LOGW(LOG_TAG, "No next stop time offset for vehicle %s", train.vehicleId);
+    return false;
+  }
+  train.nextStopTimeOffset = status["nextStopTimeOffset"].as<int>();
+
+  int64_t lastUpdateTime = (int64_t)status["lastUpdateTime"].as<double>();
+  if (lastUpdateTime > newestUpdateTime) {
+    newestUpdateTime = lastUpdateTime;
+  }
+
+  // Extract closestStop and offset
+  train.closestStop = cycleArena.copyString(status["closestStop"] | "");
+  train.closestStopTimeOffset = status["closestStopTimeOffset"].as<int>();
+
+  // Check if trip is in progress
+  // Note: We log warnings but don't skip trains that haven't started yet,
+  // as they are still valid and should be displayed
+  if (!status["scheduledDistanceAlongTrip"].isNull()) {
+    float scheduledDistance = status["scheduledDistanceAlongTrip"].as<float>();
+    if (scheduledDistance < MIN_SCHEDULED_DISTANCE_THRESHOLD) {
+      LINK_LOGW(LOG_TAG, "Vehicle %s not in progress yet, scheduledDistanceAlongTrip: %.2f", 
+               train.vehicleId, scheduledDistance);
+    }
+  } else {
+    LINK_LOGW(LOG_TAG, "Vehicle %s not in progress yet, no scheduledDistanceAlongTrip", 
+             train.vehicleId);
+  }
+
+  // Merge trip information if available. Copied since the trip cache can rehash later in the cycle.
+  if (tripInfo != nullptr) {
+    train.direction = tripInfo->directionId;
+    train.routeId = cycleArena.copyString(tripInfo->routeId.c_str());
+    train.tripHeadsign = cycleArena.copyString(tripInfo->tripHeadsign.c_str());
+  } else {
+    train.direction = TrainDirection::SOUTHBOUND;
+    train.routeId = "";
+    train.tripHeadsign = "";
+  }
+
+  // Set the line identifier
+  train.line = line;
+  train.snapshotMillis = snapshotMillis;
+
+  // Determine train state: AT_STATION or MOVING
+  // This took quite a bit of work to get right. Simply checking to see if nextStopTimeOffset and closestStopTimeOffset are 0
+  // doesn't work, since it misses trains that are just barely arriving at the station but leave during the data refresh window.
+  // Checking for the next and closest stop IDs (or offsets) being the same also doesn't work, since that's true any time the
+  // train is past the halfway point of the two stations. 
+  int atStationThreshold = (int)preferencesManager.getAtStationThreshold();
+  if (train.nextStopTimeOffset < atStationThreshold) {
+    train.state = TrainState::AT_STATION;
+  } else {
+    train.state = TrainState::MOVING;
+
+    // Track the train closest to crossing into AT_STATION so the scheduler can poll right after it arrives
+    int arrivalSeconds = train.nextStopTimeOffset - atStationThreshold;
+    if (pollSnapshot.soonestArrivalSeconds < 0 || arrivalSeconds < pollSnapshot.soonestArrivalSeconds) {
+      pollSnapshot.soonestArrivalSeconds = arrivalSeconds;
+    }
+  }
+
+  // Add to the list
+  stagingList.push_back(train);
+
+  return true;
+}
+
+// A vehicle that just started a trip isn't cached yet, so it can't be placed this cycle. Keeping its entry from
+// the last poll stops the merge from removing it for one cycle and inserting it again on the next.
+void TrainDataManager::holdVehicle(const char* vehicleId) {
+  if (*vehicleId != '\0') {
+    heldVehicles.push_back(cycleArena.copyString(vehicleId));
+  }
+}
+
+// Looks up every staged train's stop names from the hardcoded stop data, then where they are in the LED layout.
+// Done in one pass per cycle so the stage is timed once rather than on every lookup.
+void TrainDataManager::mapStagedStations() {
+  PERF_SCOPE(PerfStage::STATION_MAPPING);
+  for (StagedTrain& train : stagingList) {
+    train.closestStopName = lookupStopName(train.closestStop, "closestStop");
+    train.nextStopName = lookupStopName(train.nextStop, "nextStop");
+    train.closestStopOrdinal = ledLayout.findStation(train.closestStopName);
+    train.nextStopOrdinal = ledLayout.findStation(train.nextStopName);
+  }
+}
+
+// Logs a train that was added or changed by the last merge
+void TrainDataManager::logTrain(const TrainData& train, const char* change) const {
+  // If a focused train is set, log only that train's data
+  String focusedVehicleId = preferencesManager.getFocusedVehicleId();
+  if (!focusedVehicleId.isEmpty() && train.vehicleId != focusedVehicleId) {
+    return;
+  }
+
+  LINK_LOGD(LOG_TAG, "Train %s: vehicleId=%s, closestStop=%s (%s), closestStopOffset=%d, nextStop=%s (%s), nextStopOffset=%d, direction=%s, route=%s, headsign=%s, line=%d, state=%s",
+    change,
+    train.vehicleId.c_str(),
+    train.closestStop.c_str(),
+    train.closestStopName.c_str(),
+    train.closestStopTimeOffset,
+    train.nextStop.c_str(),
+    train.nextStopName.c_str(),
+    train.nextStopTimeOffset,
+    train.direction == TrainDirection::NORTHBOUND ? "Northbound" : "Southbound",
+    train.routeId.c_str(),
+    train.tripHeadsign.c_str(),
+    static_cast<int>(train.line),
+    train.state == TrainState::AT_STATION ? "AT_STATION" : "MOVING");
+}
+
+// Converts the newest vehicle update to local millis() using the response's own clock, so device clock skew doesn't matter
+void TrainDataManager::recordFeedRefresh(int64_t currentTime, int64_t newestUpdateTime) {
+  if (currentTime > pollSnapshot.upstreamTime) {
+    pollSnapshot.upstreamTime = currentTime;
+  }
+  if (currentTime > 0 && newestUpdateTime > 0 && newestUpdateTime <= currentTime) {
+    uint32_t refreshMillis = millis() - (uint32_t)(currentTime - newestUpdateTime);
+    if (!pollSnapshot.feedRefreshKnown || (int32_t)(refreshMillis - pollSnapshot.feedRefreshMillis) > 0) {
+      pollSnapshot.feedRefreshMillis = refreshMillis;
+      pollSnapshot.feedRefreshKnown = true;
+    }
+  }
+}
 
 bool TrainDataManager::parseTrainDataFromJson(JsonDocument& doc, Line line) {
+  PERF_SCOPE(PerfStage::TRAIN_PARSE);
   // Get the data object
   JsonObject data = doc["data"];
   if (data.isNull()) {
@@ -34,24 +269,14 @@ bool TrainDataManager::parseTrainDataFromJson(JsonDocument& doc, Line line) {
     return false;
   }
 
-  // First, build a map of trip information using PSRAM allocator
-  PSRAMMap<String, TripInfo> tripMap;
-  JsonArray trips = data["references"]["trips"];
-  if (!trips.isNull()) {
-    for (JsonObject trip : trips) {
-      String tripId = trip["id"].as<String>();
-      TripInfo info;
-      String directionStr = trip["directionId"].as<String>();
-      info.directionId = (directionStr == "1") ? TrainDirection::NORTHBOUND : TrainDirection::SOUTHBOUND;
-      info.routeId = trip["routeId"].as<String>();
-      info.tripHeadsign = trip["tripHeadsign"].as<String>();
-      tripMap[tripId] = info;
-    }
-  }
+  // First, add any new trips to the trip cache. A warm cache means references were filtered out.
+  uint32_t parseStart = micros();
+  bool hasTrips = cacheTrips(data, tripCache);
 
   // Use hardcoded stop data instead of parsing from JSON
   // Stop information is now defined in StopData.h and never changes
-  LINK_LOGI(LOG_TAG, "Loaded %u trips for %d Line", tripMap.size(), static_cast<int>(line));
+  LINK_LOGI(LOG_TAG, "%u trips cached for %d Line (references %s)", (unsigned)tripCache.size(), static_cast<int>(line),
+            hasTrips ? "parsed" : "skipped");
 
   // Process the list array
   JsonArray list = data["list"];
@@ -60,171 +285,218 @@ bool TrainDataManager::parseTrainDataFromJson(JsonDocument& doc, Line line) {
     return false;
   }
 
-  // Reserve memory to avoid reallocations during push_back operations
-  buildingList.reserve(list.size());
+  // Newest upstream vehicle update in this response, in the server's clock, used to learn the feed refresh cadence
+  int64_t currentTime = (int64_t)doc["currentTime"].as<double>();
+  int64_t newestUpdateTime = 0;
 
-  for (JsonObject item : list) {
-    TrainData train;
+  // All time offsets in this response are relative to when it was received
+  uint32_t snapshotMillis = millis();
 
+  for (JsonObject item : list) {
     // Extract tripId from the list item
-    train.tripId = item["tripId"].as<String>();
+    const char* tripId = item["tripId"] | "";
 
     // Trains without a status aren't actually running, so we skip them entirely instead of trying to parse incomplete data.
     JsonObject status = item["status"];
     if (status.isNull()) {
-      LINK_LOGW(LOG_TAG, "Status missing for trip %s, skipping train", train.tripId.c_str());
+      LINK_LOGW(LOG_TAG, "Status missing for trip %s, skipping train", tripId);
       continue;
     }
 
-    // Extract vehicleId from status.vehicleId
-    train.vehicleId = status["vehicleId"].as<String>();
-    
-    // Fall back to last part of tripId if vehicleId is empty
-    if (train.vehicleId.isEmpty()) {
-      int lastUnderscore = train.tripId.lastIndexOf('_');
-      if (lastUnderscore != -1 && lastUnderscore < train.tripId.length() - 1) {
-        train.vehicleId = train.tripId.substring(lastUnderscore + 1);
-      } else {
-        // If no underscore found, use the whole tripId as fallback
-        train.vehicleId = train.tripId;
-      }
-    }
-
-    // Check for nextStop
-    if (status["nextStop"].isNull()) {
-      LINK_LOGW(LOG_TAG, "No next stop for vehicle %s", train.vehicleId.c_str());
+    const TripInfo* tripInfo = tripCache.find(tripId);
+    if (tripInfo == nullptr && !hasTrips) {
+      // A trip that started since the references were last fetched. Its direction is unknown, so keep the
+      // vehicle where it was and fetch references next time.
+      LINK_LOGD(LOG_TAG, "Trip %s not cached, holding its vehicle until references are fetched", tripId);
+      tripCache.markCold();
+      holdVehicle(status["vehicleId"] | "");
       continue;
     }
-    train.nextStop = status["nextStop"].as<String>();
+    addTrainFromStatus(status, tripId, line, tripInfo, snapshotMillis, newestUpdateTime);
+  }
 
-    // Check for nextStopTimeOffset
-    if (status["nextStopTimeOffset"].isNull()) {
-      LINK_LOGW(LOG_TAG, "No next stop time offset for vehicle %s", train.vehicleId.c_str());
-      continue;
-    }
-    train.nextStopTimeOffset = status["nextStopTimeOffset"].as<int>();
-
-    // Extract closestStop and offset
-    train.closestStop = status["closestStop"].as<String>();
-    train.closestStopTimeOffset = status["closestStopTimeOffset"].as<int>();
-
-    // Check if trip is in progress
-    // Note: We log warnings but don't skip trains that haven't started yet,
-    // as they are still valid and should be displayed
-    if (!status["scheduledDistanceAlongTrip"].isNull()) {
-      float scheduledDistance = status["scheduledDistanceAlongTrip"].as<float>();
-      if (scheduledDistance < MIN_SCHEDULED_DISTANCE_THRESHOLD) {
-        LINK_LOGW(LOG_TAG, "Vehicle %s not in progress yet, scheduledDistanceAlongTrip: %.2f", 
-                 train.vehicleId.c_str(), scheduledDistance);
-      }
-    } else {
-      LINK_LOGW(LOG_TAG, "Vehicle %s not in progress yet, no scheduledDistanceAlongTrip", 
-               train.vehicleId.c_str());
-    }
+  recordFeedRefresh(currentTime, newestUpdateTime);
+  cycleParseMicros += micros() - parseStart;
 
-    // Look up stop names from the hardcoded stop data
-    auto closestStopIt = STOP_ID_TO_NAME.find(train.closestStop);
-    if (closestStopIt != STOP_ID_TO_NAME.end()) {
-      train.closestStopName = closestStopIt->second;
-    } else {
-      LINK_LOGW(LOG_TAG, "Stop name not found for closestStop ID: %s", train.closestStop.c_str());
-      train.closestStopName = train.closestStop; // Fall back to ID if name not found
-    }
+  return true;
+}
 
-    auto nextStopIt = STOP_ID_TO_NAME.find(train.nextStop);
-    if (nextStopIt != STOP_ID_TO_NAME.end()) {
-      train.nextStopName = nextStopIt->second;
-    } else {
-      LINK_LOGW(LOG_TAG, "Stop name not found for nextStop ID: %s", train.nextStop.c_str());
-      train.nextStopName = train.nextStop; // Fall back to ID if name not found
-    }
+// Parses a vehicles-for-agency response. Every vehicle in the agency is listed, so only vehicles whose
+// trip belongs to a route in the route-to-line map are kept; everything else (e.g. buses) is skipped quietly.
+bool TrainDataManager::parseVehiclesForAgency(JsonDocument& doc) {
+  PERF_SCOPE(PerfStage::TRAIN_PARSE);
+  JsonObject data = doc["data"];
+  if (data.isNull()) {
+    LINK_LOGW(LOG_TAG, "JSON response missing 'data' object");
+    return false;
+  }
 
-    // Merge trip information if available
-    auto tripIt = tripMap.find(train.tripId);
-    if (tripIt != tripMap.end()) {
-      TripInfo& tripInfo = tripIt->second;
-      train.direction = tripInfo.directionId;
-      train.routeId = tripInfo.routeId;
-      train.tripHeadsign = tripInfo.tripHeadsign;
-    }
+  uint32_t parseStart = micros();
+  bool hasTrips = cacheTrips(data, tripCache);
+  LINK_LOGI(LOG_TAG, "%u trips cached for agency %s (references %s)", (unsigned)tripCache.size(), AGENCY_ID,
+            hasTrips ? "parsed" : "skipped");
+
+  JsonArray list = data["list"];
+  if (list.isNull()) {
+    LINK_LOGW(LOG_TAG, "JSON response missing 'data.list' array");
+    return false;
+  }
 
-    // Set the line identifier
-    train.line = line;
+  int64_t currentTime = (int64_t)doc["currentTime"].as<double>();
+  int64_t newestUpdateTime = 0;
+  uint32_t snapshotMillis = millis();
 
-    // Determine train state: AT_STATION or MOVING
-    // This took quite a bit of work to get right. Simply checking to see if nextStopTimeOffset and closestStopTimeOffset are 0
-    // doesn't work, since it misses trains that are just barely arriving at the station but leave during the data refresh window.
-    // Checking for the next and closest stop IDs (or offsets) being the same also doesn't work, since that's true any time the
-    // train is past the halfway point of the two stations. 
-    if (train.nextStopTimeOffset < (int)preferencesManager.getAtStationThreshold()) {
-      train.state = TrainState::AT_STATION;
-    } else {
-      train.state = TrainState::MOVING;
+  for (JsonObject vehicle : list) {
+    // Vehicles that aren't in service have no trip
+    const char* tripId = vehicle["tripId"] | "";
+    if (*tripId == '\0') {
+      continue;
+    }
+
+    // Every trip in the agency is cached, including ones on unmapped routes, so a miss always means a new trip
+    const TripInfo* tripInfo = tripCache.find(tripId);
+    if (tripInfo == nullptr) {
+      if (!hasTrips) {
+        LINK_LOGD(LOG_TAG, "Trip %s not cached, holding its vehicle until references are fetched", tripId);
+        tripCache.markCold();
+        holdVehicle(vehicle["vehicleId"] | "");
+      }
+      continue;
     }
 
-    // Add to the list
-    buildingList.push_back(train);
+    const RouteLine* routeLine = findRouteLine(tripInfo->routeId);
+    if (routeLine == nullptr) {
+      continue;
+    }
 
-    // If a focused train is set, log only that train's data
-    String focusedVehicleId = preferencesManager.getFocusedVehicleId();
-    if (!focusedVehicleId.isEmpty() && train.vehicleId != focusedVehicleId) {
+    JsonObject status = vehicle["tripStatus"];
+    if (status.isNull()) {
+      LINK_LOGW(LOG_TAG, "Status missing for trip %s, skipping train", tripId);
       continue;
     }
 
-    // Log parsed data
-    LINK_LOGD(LOG_TAG, "Train: vehicleId=%s, closestStop=%s (%s), closestStopOffset=%d, nextStop=%s (%s), nextStopOffset=%d, direction=%s, route=%s, headsign=%s, line=%d, state=%s",
-      train.vehicleId.c_str(),
-      train.closestStop.c_str(),
-      train.closestStopName.c_str(),
-      train.closestStopTimeOffset,
-      train.nextStop.c_str(),
-      train.nextStopName.c_str(),
-      train.nextStopTimeOffset,
-      train.direction == TrainDirection::NORTHBOUND ? "Northbound" : "Southbound",
-      train.routeId.c_str(),
-      train.tripHeadsign.c_str(),
-      static_cast<int>(train.line),
-      train.state == TrainState::AT_STATION ? "AT_STATION" : "MOVING");
+    addTrainFromStatus(status, tripId, routeLine->line, tripInfo, snapshotMillis, newestUpdateTime);
   }
 
+  recordFeedRefresh(currentTime, newestUpdateTime);
+  cycleParseMicros += micros() - parseStart;
+
   return true;
 }
 
-void TrainDataManager::fetchTrainDataForRoute(const String& routeId, Line line, const String& apiKey) {
-  // Use static buffer to avoid heap allocation for URL string on every call
-  char url[256];
-  snprintf(url, sizeof(url), "%s/trips-for-route/%s.json?includeSchedule=false&%s=%s", 
-           API_BASE_URL, routeId.c_str(), API_KEY_PARAM, apiKey.c_str());
-  
-  LINK_LOGD(LOG_TAG, "Fetching data for %d Line (route: %s)", static_cast<int>(line), routeId.c_str());
-  
+// Passes a response body through to the JSON parser, counting the bytes read for /metrics
+class CountingStream : public Stream {
+public:
+  explicit CountingStream(Stream& inner) : inner(inner) {}
+
+  int available() override { return inner.available(); }
+  int peek() override { return inner.peek(); }
+  int read() override {
+    int c = inner.read();
+    if (c >= 0) {
+      bytesRead++;
+    }
+    return c;
+  }
+  size_t readBytes(char* buffer, size_t length) override {
+    size_t count = inner.readBytes(buffer, length);
+    bytesRead += count;
+    return count;
+  }
+  size_t write(uint8_t) override { return 0; }
+
+  size_t getBytesRead() const { return bytesRead; }
+
+private:
+  Stream& inner;
+  size_t bytesRead = 0;
+};
+
+// Fetches a URL and deserializes the response into doc. Returns true if doc holds a parsed response.
+bool TrainDataManager::fetchJson(const char* url, JsonDocument& doc, const char* label) {
   HTTPClient http;
   http.setTimeout(10000);
   http.begin(url);
-  int httpCode = http.GET();
+  int httpCode;
+  {
+    // HTTPClient doesn't expose DNS, connect, TLS and time to first byte separately, so they're timed together
+    PERF_SCOPE(PerfStage::HTTP_REQUEST);
+    httpCode = http.GET();
+  }
+  pollSnapshot.apiCalls++;
+  metrics.recordApiResponse(httpCode);
 
+  bool success = false;
   if (httpCode == HTTP_CODE_OK) {
     WiFiClient* stream = http.getStreamPtr();
 
     if (stream == nullptr) {
-      LINK_LOGE(LOG_TAG, "Failed to get HTTP stream for %d Line. URL: %s", static_cast<int>(line), url);
+      LINK_LOGE(LOG_TAG, "Failed to get HTTP stream for %s. URL: %s", label, url);
     } else {
-      JsonDocument doc(PSRAMJsonAllocator::instance());
-      DeserializationError error = deserializeJson(doc, *stream);
+      // Deserialization reads the body off the network as it parses, so this time includes transfer time
+      JsonDocument filter(&arenaJsonAllocator);
+      buildResponseFilter(filter, !tripCache.isWarm());
+      CountingStream body(*stream);
+      uint32_t parseStart = micros();
+      DeserializationError error;
+      {
+        PERF_SCOPE(PerfStage::DOWNLOAD_PARSE);
+        error = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+      }
+      cycleParseMicros += micros() - parseStart;
+      metrics.recordBytesDownloaded(body.getBytesRead());
 
       if (error) {
-        LINK_LOGE(LOG_TAG, "JSON parsing failed for %d Line: %s. URL: %s", static_cast<int>(line), error.c_str(), url);
+        LINK_LOGE(LOG_TAG, "JSON parsing failed for %s: %s. URL: %s", label, error.c_str(), url);
       } else {
-        LINK_LOGD(LOG_TAG, "Successfully retrieved %d Line train data", static_cast<int>(line));
-        parseTrainDataFromJson(doc, line);
+        LINK_LOGD(LOG_TAG, "Successfully retrieved %s train data", label);
+        success = true;
       }
     }
   } else {
-    LINK_LOGW(LOG_TAG, "HTTP request failed for %d Line with code %d. URL: %s. Will retry on next update cycle.", 
-             static_cast<int>(line), httpCode, url);
+    LINK_LOGW(LOG_TAG, "HTTP request failed for %s with code %d. URL: %s. Will retry on next update cycle.", 
+             label, httpCode, url);
   }
 
   http.end();
+
+  if (!success) {
+    pollSnapshot.fetchFailed = true;
+  }
+  return success;
+}
+
+void TrainDataManager::fetchTrainDataForRoute(const String& routeId, Line line, const String& apiKey) {
+  // Use static buffer to avoid heap allocation for URL string on every call
+  char url[256];
+  snprintf(url, sizeof(url), "%s/trips-for-route/%s.json?includeSchedule=false&includeReferences=%s&%s=%s", 
+           preferencesManager.getApiBaseUrl().c_str(), routeId.c_str(), tripCache.isWarm() ? "false" : "true",
+           API_KEY_PARAM, apiKey.c_str());
+  
+  char label[48];
+  snprintf(label, sizeof(label), "%d Line (route: %s)", static_cast<int>(line), routeId.c_str());
+  LINK_LOGD(LOG_TAG, "Fetching data for %s", label);
+  
+  JsonDocument doc(&arenaJsonAllocator);
+  if (fetchJson(url, doc, label) && !parseTrainDataFromJson(doc, line)) {
+    pollSnapshot.fetchFailed = true;
+  }
+}
+
+void TrainDataManager::fetchTrainDataForAgency(const String& apiKey) {
+  char url[256];
+  snprintf(url, sizeof(url), "%s/vehicles-for-agency/%s.json?includeReferences=%s&%s=%s",
+           preferencesManager.getApiBaseUrl().c_str(), AGENCY_ID, tripCache.isWarm() ? "false" : "true",
+           API_KEY_PARAM, apiKey.c_str());
+
+  char label[32];
+  snprintf(label, sizeof(label), "agency %s", AGENCY_ID);
+  LINK_LOGD(LOG_TAG, "Fetching data for %s", label);
+
+  JsonDocument doc(&arenaJsonAllocator);
+  if (fetchJson(url, doc, label) && !parseVehiclesForAgency(doc)) {
+    pollSnapshot.fetchFailed = true;
+  }
 }
 
 void TrainDataManager::buildTrainJsonObject(JsonObject trainObj, const TrainData& train) const {
@@ -240,27 +512,74 @@ void TrainDataManager::buildTrainJsonObject(JsonObject trainObj, const TrainData
 }
 
 void TrainDataManager::getTrainDataAsJson(String& output) const {
-  JsonDocument doc(PSRAMJsonAllocator::instance());
+  JsonDocument doc(PSRAMJsonAllocator::instance(JsonPurpose::TRAINS));
   doc["type"] = "trains";
   JsonArray trainsArray = doc["trains"].to<JsonArray>();
 
-  if (dataMutex) xSemaphoreTake(dataMutex, portMAX_DELAY);
-  for (const TrainData& train : trainDataList) {
+  lockData();
+  vehicleTable.forEach([this, &trainsArray](const TrainData& train) {
     JsonObject trainObj = trainsArray.add<JsonObject>();
     buildTrainJsonObject(trainObj, train);
+  });
+  unlockData();
+
+  serializeJson(doc, output);
+}
+
+bool TrainDataManager::getTrainDataDeltaAsJson(String& output, uint32_t& sentSeq) const {
+  JsonDocument doc(PSRAMJsonAllocator::instance(JsonPurpose::TRAINS));
+
+  lockData();
+  uint32_t mergeSeq = vehicleTable.getMergeSeq();
+  if (mergeSeq == sentSeq) {
+    unlockData();
+    return false;
   }
-  if (dataMutex) xSemaphoreGive(dataMutex);
+
+  if (mergeSeq != sentSeq + 1) {
+    // Missed a merge, so the last merge's changes aren't enough to bring clients up to date
+    doc["type"] = "trains";
+    JsonArray trainsArray = doc["trains"].to<JsonArray>();
+    vehicleTable.forEach([this, &trainsArray](const TrainData& train) {
+      buildTrainJsonObject(trainsArray.add<JsonObject>(), train);
+    });
+  } else {
+    if (vehicleTable.getChangedCount() == 0 && vehicleTable.getRemovedIds().empty()) {
+      sentSeq = mergeSeq;
+      unlockData();
+      return false;
+    }
+
+    doc["type"] = "trainsDelta";
+    JsonArray trainsArray = doc["trains"].to<JsonArray>();
+    vehicleTable.forEachChanged([this, &trainsArray](const TrainData& train) {
+      buildTrainJsonObject(trainsArray.add<JsonObject>(), train);
+    });
+    JsonArray removedArray = doc["removed"].to<JsonArray>();
+    for (const String& vehicleId : vehicleTable.getRemovedIds()) {
+      removedArray.add(vehicleId);
+    }
+  }
+  sentSeq = mergeSeq;
+  unlockData();
 
   serializeJson(doc, output);
+  return true;
 }
 
 void TrainDataManager::updateTrainPositions() {
   static const char* SAMPLE_DATA_PATH = "/data.json";
+  PERF_SCOPE(PerfStage::UPDATE_CYCLE);
 
   String apiKey = preferencesManager.getApiKey();
 
-  // Clear the building list at the start of each update
-  buildingList.clear();
+  // Reset the cycle summary at the start of each update. The staging list comes from the cycle arena,
+  // so reserving room for a full table up front keeps it from leaving abandoned copies behind as it grows.
+  stagingList.reserve(VEHICLE_TABLE_SIZE);
+  pollSnapshot = PollSnapshot();
+  cycleParseMicros = 0;
+  tripCache.beginCycle();
+  bool cacheWarm = tripCache.isWarm();
 
   if (apiKey.isEmpty()) {
     LINK_LOGW(LOG_TAG, "API key not configured, loading sample data from %s", SAMPLE_DATA_PATH);
@@ -269,8 +588,12 @@ void TrainDataManager::updateTrainPositions() {
     if (!sampleFile) {
       LINK_LOGE(LOG_TAG, "Sample data not found.");
     } else {
-      JsonDocument doc(PSRAMJsonAllocator::instance());
-      DeserializationError error = deserializeJson(doc, sampleFile);
+      JsonDocument doc(&arenaJsonAllocator);
+      JsonDocument filter(&arenaJsonAllocator);
+      buildResponseFilter(filter, !cacheWarm);
+      uint32_t parseStart = micros();
+      DeserializationError error = deserializeJson(doc, sampleFile, DeserializationOption::Filter(filter));
+      cycleParseMicros += micros() - parseStart;
       sampleFile.close();
       if (error) {
         LINK_LOGE(LOG_TAG, "Sample JSON parsing failed: %s", error.c_str());
@@ -281,13 +604,127 @@ void TrainDataManager::updateTrainPositions() {
   } else {
     LINK_LOGD(LOG_TAG, "Updating train positions...");
 
-    // Fetch data for both lines
-    fetchTrainDataForRoute(LINE_1_ROUTE_ID, Line::LINE_1, apiKey);
-    fetchTrainDataForRoute(LINE_2_ROUTE_ID, Line::LINE_2, apiKey);
+    refreshRouteLines();
+    if (preferencesManager.getIngestMode() == INGEST_MODE_AGENCY) {
+      // One request for every vehicle in the agency, filtered down to the mapped routes
+      fetchTrainDataForAgency(apiKey);
+    } else {
+      // One request per mapped route
+      for (const RouteLine& routeLine : routeLineList) {
+        fetchTrainDataForRoute(routeLine.routeId, routeLine.line, apiKey);
+      }
+    }
   }
 
-  // Swap the completed building list into the active list under mutex
+  // Trips from a failed request weren't seen this cycle but are still running, so only evict after a clean cycle
+  tripCache.endCycle(!pollSnapshot.fetchFailed);
+  recordParseTime(cacheWarm);
+  metrics.recordPoll(pollSnapshot.fetchFailed);
+
+  mapStagedStations();
+  mergeStagedTrains();
+  releaseCycleMemory();
+}
+
+// Drops everything the cycle allocated from the arena in one step, once the staged trains are merged
+void TrainDataManager::releaseCycleMemory() {
+  ArenaVector<StagedTrain>(AllocatorArena<StagedTrain>(&cycleArena)).swap(stagingList);
+  ArenaVector<const char*>(AllocatorArena<const char*>(&cycleArena)).swap(heldVehicles);
+  size_t used = cycleArena.getUsed();
+  cycleArena.reset();
+
+  LINK_LOGD(LOG_TAG, "Cycle arena: %u of %u bytes used (peak %u, %lu overflows), largest free block internal %u, PSRAM %u",
+            (unsigned)used, (unsigned)cycleArena.getCapacity(), (unsigned)cycleArena.getHighWater(),
+            (unsigned long)cycleArena.getOverflowCount(),
+            (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+            (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+}
+
+// Merges the trains parsed this cycle into the vehicle table under the mutex. Only this task writes the table,
+// so it can be read for logging after the mutex is released.
+void TrainDataManager::mergeStagedTrains() {
+  size_t inserted = 0;
+  size_t updated = 0;
+  size_t unchanged = 0;
+  size_t held = 0;
+
+  size_t removed;
+  lockData();
+  {
+    PERF_SCOPE(PerfStage::MERGE);
+    vehicleTable.beginMerge();
+    for (const StagedTrain& train : stagingList) {
+      switch (vehicleTable.upsert(train)) {
+        case VehicleUpsert::INSERTED: inserted++; break;
+        case VehicleUpsert::UPDATED: updated++; break;
+        case VehicleUpsert::UNCHANGED: unchanged++; break;
+        case VehicleUpsert::DUPLICATE: break;
+        case VehicleUpsert::FULL: break;
+      }
+    }
+    for (const char* vehicleId : heldVehicles) {
+      if (vehicleTable.keep(vehicleId)) {
+        held++;
+      }
+    }
+    removed = vehicleTable.endMerge();
+    publishedFeedRefreshKnown = pollSnapshot.feedRefreshKnown;
+    publishedFeedRefreshMillis = pollSnapshot.feedRefreshMillis;
+  }
+  unlockData();
+
+  freshnessMonitor.recordPublished(vehicleTable.getMergeSeq(), pollSnapshot.upstreamTime,
+                                   pollSnapshot.feedRefreshKnown, pollSnapshot.feedRefreshMillis);
+  pollSnapshot.trainCount = vehicleTable.size();
+
+  if (inserted + updated + unchanged < stagingList.size()) {
+    LINK_LOGW(LOG_TAG, "%u trains not merged (duplicate vehicle or table full)",
+              (unsigned)(stagingList.size() - inserted - updated - unchanged));
+  }
+
+  vehicleTable.forEachChanged([this](const TrainData& train) {
+    logTrain(train, "changed");
+  });
+  for (const String& vehicleId : vehicleTable.getRemovedIds()) {
+    LINK_LOGD(LOG_TAG, "Train removed: vehicleId=%s", vehicleId.c_str());
+  }
+
+  LINK_LOGI(LOG_TAG, "Merged %u trains: %u new, %u updated, %u unchanged, %u held, %u removed",
+            (unsigned)vehicleTable.size(), (unsigned)inserted, (unsigned)updated, (unsigned)unchanged, (unsigned)held,
+            (unsigned)removed);
+}
+
+// Tracks parse time separately for warm and cold trip cache cycles so the savings from skipping references show up
+void TrainDataManager::recordParseTime(bool cacheWarm) {
+  lastParseMicros = cycleParseMicros;
+  metrics.recordParseTime(cycleParseMicros);
+  uint32_t& average = cacheWarm ? warmParseMicros : coldParseMicros;
+  if (average == 0) {
+    average = cycleParseMicros;
+  } else {
+    average += ((int32_t)cycleParseMicros - (int32_t)average) / 8;
+  }
+
+  uint32_t lookups = tripCache.getTotalHits() + tripCache.getTotalMisses();
+  unsigned int hitRate = lookups > 0 ? (unsigned int)((uint64_t)tripCache.getTotalHits() * 100 / lookups) : 0;
+  LINK_LOGI(LOG_TAG, "Parsed in %lu us (%s cache), trip cache %u trips, %u%% hit rate, avg warm %lu us vs cold %lu us",
+            (unsigned long)cycleParseMicros, cacheWarm ? "warm" : "cold", (unsigned)tripCache.size(), hitRate,
+            (unsigned long)warmParseMicros, (unsigned long)coldParseMicros);
+}
+
+void TrainDataManager::lockData() const {
+  PERF_SCOPE(PerfStage::MUTEX_WAIT);
+  TRACE_SCOPE("mutexWait");
   if (dataMutex) xSemaphoreTake(dataMutex, portMAX_DELAY);
-  buildingList.swap(trainDataList);
+}
+
+void TrainDataManager::unlockData() const {
   if (dataMutex) xSemaphoreGive(dataMutex);
 }
+
+int32_t TrainDataManager::getDataAgeMs() const {
+  if (!publishedFeedRefreshKnown) {
+    return -1;
+  }
+  return (int32_t)(millis() - publishedFeedRefreshMillis);
+}
@@ -0,0 +1,104 @@
+#include "TransitionEngine.h"
+
+// Smoothstep on 0-255: 3x^2 - 2x^3, scaled back to 0-255
+static uint8_t smoothstep(uint32_t x) {
+  return (uint8_t)((x * x * (3 * 255 - 2 * x)) / (255 * 255));
+}
+
+TransitionEngine::TransitionEngine() {
+  for (uint32_t i = 0; i < 256; i++) {
+    easeTable[i] = smoothstep(i);
+    // Up and back down, eased at both ends
+    uint32_t triangle = i < 128 ? i * 2 : (255 - i) * 2;
+    pulseTable[i] = smoothstep(triangle > 255 ? 255 : triangle);
+  }
+
+  for (LEDState& state : leds) {
+    state.fadeElapsedMs = 0;
+    state.fadeDurationMs = 0;
+    state.pulseElapsedMs = TRANSITION_PULSE_MS;
+  }
+}
+
+uint8_t TransitionEngine::progress(uint16_t elapsedMs, uint16_t durationMs) {
+  return (uint8_t)((uint32_t)elapsedMs * 255 / durationMs);
+}
+
+RgbColor TransitionEngine::blend(const RgbColor& from, const RgbColor& to, uint8_t amount) {
+  return RgbColor(
+    (uint8_t)(from.R + (((int16_t)to.R - from.R) * amount) / 255),
+    (uint8_t)(from.G + (((int16_t)to.G - from.G) * amount) / 255),
+    (uint8_t)(from.B + (((int16_t)to.B - from.B) * amount) / 255));
+}
+
+// Color the LED is showing right now, so a retarget mid-fade starts from where it is rather than jumping
+RgbColor TransitionEngine::currentColor(const LEDState& state) const {
+  if (state.fadeDurationMs == 0) {
+    return state.to;
+  }
+  return blend(state.from, state.to, easeTable[progress(state.fadeElapsedMs, state.fadeDurationMs)]);
+}
+
+void TransitionEngine::setTarget(const LEDFrame& target) {
+  for (int i = 0; i < ledCount; i++) {
+    LEDState& state = leds[i];
+    const RgbColor& color = target.pixels[i];
+    if (color == state.to) {
+      continue;
+    }
+
+    bool wasDark = state.to == RgbColor(0, 0, 0);
+    bool goingDark = color == RgbColor(0, 0, 0);
+    state.from = currentColor(state);
+    state.to = color;
+    state.fadeElapsedMs = 0;
+    state.fadeDurationMs = goingDark ? TRANSITION_TAIL_MS : TRANSITION_FADE_MS;
+
+    if (wasDark && !goingDark && (target.flags[i] & LED_FLAG_STATION)) {
+      state.pulseElapsedMs = 0;
+    }
+    animating = true;
+  }
+}
+
+bool TransitionEngine::render(uint32_t elapsedMs, LEDFrame& output) {
+  // A stalled frame shouldn't overflow the 16-bit timers, and everything would have settled anyway
+  uint16_t step = elapsedMs > TRANSITION_TAIL_MS ? TRANSITION_TAIL_MS : (uint16_t)elapsedMs;
+  bool stillAnimating = false;
+
+  for (int i = 0; i < ledCount; i++) {
+    LEDState& state = leds[i];
+    RgbColor color = state.to;
+
+    if (state.fadeDurationMs != 0) {
+      uint32_t fadeElapsed = (uint32_t)state.fadeElapsedMs + step;
+      if (fadeElapsed >= state.fadeDurationMs) {
+        state.fadeDurationMs = 0;
+        state.from = state.to;
+      } else {
+        state.fadeElapsedMs = (uint16_t)fadeElapsed;
+        color = blend(state.from, state.to, easeTable[progress(state.fadeElapsedMs, state.fadeDurationMs)]);
+        stillAnimating = true;
+      }
+    }
+
+    if (state.pulseElapsedMs < TRANSITION_PULSE_MS) {
+      uint32_t pulseElapsed = (uint32_t)state.pulseElapsedMs + step;
+      state.pulseElapsedMs = pulseElapsed >= TRANSITION_PULSE_MS ? TRANSITION_PULSE_MS : (uint16_t)pulseElapsed;
+      if (state.pulseElapsedMs < TRANSITION_PULSE_MS) {
+        // Brighten by up to double at the peak, saturating each channel
+        uint8_t gain = pulseTable[progress(state.pulseElapsedMs, TRANSITION_PULSE_MS)];
+        uint16_t r = color.R + ((color.R * gain) >> 8);
+        uint16_t g = color.G + ((color.G * gain) >> 8);
+        uint16_t b = color.B + ((color.B * gain) >> 8);
+        color = RgbColor(r > 255 ? 255 : r, g > 255 ? 255 : g, b > 255 ? 255 : b);
+        stillAnimating = true;
+      }
+    }
+
+    output.pixels[i] = color;
+  }
+
+  animating = stillAnimating;
+  return stillAnimating;
+}
@@ -0,0 +1,126 @@
+#include "TripCache.h"
+#include "LogManager.h"
+#include "config.h"
+
+static const char* LOG_TAG = "TripCache";
+
+// Slot count is a power of two at twice the entry limit so probe chains stay short
+static const size_t TRIP_CACHE_SLOTS = TRIP_CACHE_SIZE * 2;
+
+uint32_t TripCache::hashTripId(const char* tripId) {
+  uint32_t hash = 2166136261u;  // FNV-1a offset basis
+  for (const char* c = tripId; *c; ++c) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+  return hash;
+}
+
+// Returns the slot holding tripId, or the empty slot where it would go
+size_t TripCache::findSlot(const char* tripId, uint32_t hash) const {
+  size_t mask = slots.size() - 1;
+  size_t index = hash & mask;
+  while (slots[index].used) {
+    if (slots[index].hash == hash && slots[index].tripId == tripId) {
+      break;
+    }
+    index = (index + 1) & mask;
+  }
+  return index;
+}
+
+void TripCache::beginCycle() {
+  if (slots.empty()) {
+    slots.resize(TRIP_CACHE_SLOTS);
+  }
+  generation++;
+  cycleHits = 0;
+  cycleMisses = 0;
+}
+
+void TripCache::endCycle(bool evictStale) {
+  if (evictStale) {
+    evictOlderThan(generation);
+  }
+
+  if (cycleMisses > 0) {
+    warm = false;
+  } else if (count > 0 && cycleHits + cycleMisses > 0) {
+    warm = true;
+  }
+}
+
+const TripInfo* TripCache::find(const char* tripId) {
+  if (slots.empty()) {
+    return nullptr;
+  }
+
+  uint32_t hash = hashTripId(tripId);
+  Entry& entry = slots[findSlot(tripId, hash)];
+  if (!entry.used) {
+    cycleMisses++;
+    totalMisses++;
+    return nullptr;
+  }
+
+  cycleHits++;
+  totalHits++;
+  entry.generation = generation;
+  return &entry.info;
+}
+
+bool TripCache::insert(const char* tripId, TrainDirection directionId, const char* routeId, const char* tripHeadsign) {
+  if (slots.empty()) {
+    slots.resize(TRIP_CACHE_SLOTS);
+  }
+
+  uint32_t hash = hashTripId(tripId);
+  size_t index = findSlot(tripId, hash);
+  if (!slots[index].used) {
+    if (count >= TRIP_CACHE_SIZE) {
+      // Make room by dropping trips that weren't referenced last cycle
+      evictOlderThan(generation - 1);
+      if (count >= TRIP_CACHE_SIZE) {
+        LINK_LOGW(LOG_TAG, "Trip cache full (%u trips), not caching trip %s", (unsigned)count, tripId);
+        return false;
+      }
+      index = findSlot(tripId, hash);
+    }
+    slots[index].used = true;
+    slots[index].hash = hash;
+    slots[index].tripId = tripId;
+    slots[index].info.directionId = directionId;
+    slots[index].info.routeId = routeId;
+    slots[index].info.tripHeadsign = tripHeadsign;
+    count++;
+  }
+
+  slots[index].generation = generation;
+  return true;
+}
+
+// Removes entries last referenced before keepGeneration. Open addressing can't simply clear a slot
+// without breaking probe chains, so the surviving entries are reinserted into a fresh table.
+void TripCache::evictOlderThan(uint32_t keepGeneration) {
+  size_t stale = 0;
+  for (const Entry& entry : slots) {
+    if (entry.used && entry.generation < keepGeneration) {
+      stale++;
+    }
+  }
+  if (stale == 0) {
+    return;
+  }
+
+  esp32_psram::VectorPSRAM<Entry> old(TRIP_CACHE_SLOTS);
+  old.swap(slots);
+  count = 0;
+  for (Entry& entry : old) {
+    if (entry.used && entry.generation >= keepGeneration) {
+      size_t index = findSlot(entry.tripId.c_str(), entry.hash);
+      slots[index] = std::move(entry);
+      count++;
+    }
+  }
+
+  LINK_LOGD(LOG_TAG, "Evicted %u trips, %u cached", (unsigned)stale, (unsigned)count);
+}
@@ -0,0 +1,168 @@
+#include "VehicleTable.h"
+#include "LogManager.h"
+#include "config.h"
+
+static const char* LOG_TAG = "VehicleTable";
+
+// Slot count is a power of two at twice the vehicle limit so probe chains stay short
+static const size_t VEHICLE_TABLE_SLOTS = VEHICLE_TABLE_SIZE * 2;
+
+// Compares what decides the train's LED: its state, stops, direction and line. The time offsets move on every
+// poll for every running train, so they're refreshed by copyTiming() without marking the train changed.
+static bool sameTrain(const TrainData& a, const StagedTrain& b) {
+  return a.state == b.state &&
+         a.closestStopOrdinal == b.closestStopOrdinal &&
+         a.nextStopOrdinal == b.nextStopOrdinal &&
+         a.direction == b.direction &&
+         a.line == b.line;
+}
+
+// The time offsets prediction ages between polls, and when they were current
+static void copyTiming(TrainData& to, const StagedTrain& from) {
+  to.closestStopTimeOffset = from.closestStopTimeOffset;
+  to.nextStopTimeOffset = from.nextStopTimeOffset;
+  to.snapshotMillis = from.snapshotMillis;
+}
+
+static void copyTrain(TrainData& to, const StagedTrain& from) {
+  to.closestStop = from.closestStop;
+  to.closestStopName = from.closestStopName;
+  to.closestStopOrdinal = from.closestStopOrdinal;
+  to.closestStopTimeOffset = from.closestStopTimeOffset;
+  to.nextStop = from.nextStop;
+  to.nextStopName = from.nextStopName;
+  to.nextStopOrdinal = from.nextStopOrdinal;
+  to.nextStopTimeOffset = from.nextStopTimeOffset;
+  to.tripId = from.tripId;
+  to.vehicleId = from.vehicleId;
+  to.direction = from.direction;
+  to.routeId = from.routeId;
+  to.tripHeadsign = from.tripHeadsign;
+  to.line = from.line;
+  to.state = from.state;
+  to.snapshotMillis = from.snapshotMillis;
+}
+
+uint32_t VehicleTable::hashVehicleId(const char* vehicleId) {
+  uint32_t hash = 2166136261u;  // FNV-1a offset basis
+  for (const char* c = vehicleId; *c; ++c) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+  return hash;
+}
+
+// Returns the slot holding vehicleId (found = true), or the slot to insert it into, preferring the first
+// tombstone passed along the probe chain.
+size_t VehicleTable::findSlot(const char* vehicleId, uint32_t hash, bool& found) const {
+  size_t mask = slots.size() - 1;
+  size_t index = hash & mask;
+  size_t firstTombstone = SIZE_MAX;
+  found = false;
+
+  while (slots[index].state != SlotState::EMPTY) {
+    if (slots[index].state == SlotState::TOMBSTONE) {
+      if (firstTombstone == SIZE_MAX) {
+        firstTombstone = index;
+      }
+    } else if (slots[index].hash == hash && slots[index].train.vehicleId == vehicleId) {
+      found = true;
+      return index;
+    }
+    index = (index + 1) & mask;
+  }
+
+  return firstTombstone != SIZE_MAX ? firstTombstone : index;
+}
+
+void VehicleTable::beginMerge() {
+  if (slots.empty()) {
+    slots.resize(VEHICLE_TABLE_SLOTS);
+  }
+  mergeSeq++;
+  changedCount = 0;
+  removedIds.clear();
+}
+
+VehicleUpsert VehicleTable::upsert(const StagedTrain& train) {
+  uint32_t hash = hashVehicleId(train.vehicleId);
+  bool found;
+  size_t index = findSlot(train.vehicleId, hash, found);
+  Entry& entry = slots[index];
+
+  if (found) {
+    if (entry.seenSeq == mergeSeq) {
+      return VehicleUpsert::DUPLICATE;
+    }
+    entry.seenSeq = mergeSeq;
+
+    if (sameTrain(entry.train, train)) {
+      copyTiming(entry.train, train);
+      return VehicleUpsert::UNCHANGED;
+    }
+
+    copyTrain(entry.train, train);
+    entry.changedSeq = mergeSeq;
+    changedCount++;
+    return VehicleUpsert::UPDATED;
+  }
+
+  if (liveCount >= VEHICLE_TABLE_SIZE) {
+    return VehicleUpsert::FULL;
+  }
+
+  if (entry.state == SlotState::TOMBSTONE) {
+    tombstoneCount--;
+  }
+  entry.state = SlotState::LIVE;
+  entry.hash = hash;
+  copyTrain(entry.train, train);
+  entry.seenSeq = mergeSeq;
+  entry.changedSeq = mergeSeq;
+  liveCount++;
+  changedCount++;
+  return VehicleUpsert::INSERTED;
+}
+
+bool VehicleTable::keep(const char* vehicleId) {
+  bool found;
+  size_t index = findSlot(vehicleId, hashVehicleId(vehicleId), found);
+  if (!found || slots[index].seenSeq == mergeSeq) {
+    return false;
+  }
+  slots[index].seenSeq = mergeSeq;
+  return true;
+}
+
+size_t VehicleTable::endMerge() {
+  for (Entry& entry : slots) {
+    if (entry.state == SlotState::LIVE && entry.seenSeq != mergeSeq) {
+      removedIds.push_back(entry.train.vehicleId);
+      entry.state = SlotState::TOMBSTONE;
+      liveCount--;
+      tombstoneCount++;
+    }
+  }
+
+  // Tombstones lengthen probe chains, so rebuild once they take up a quarter of the table
+  if (tombstoneCount > slots.size() / 4) {
+    rehash();
+  }
+
+  return removedIds.size();
+}
+
+void VehicleTable::rehash() {
+  esp32_psram::VectorPSRAM<Entry> old(VEHICLE_TABLE_SLOTS);
+  old.swap(slots);
+  tombstoneCount = 0;
+
+  for (Entry& entry : old) {
+    if (entry.state == SlotState::LIVE) {
+      bool found;
+      size_t index = findSlot(entry.train.vehicleId.c_str(), entry.hash, found);
+      slots[index] = std::move(entry);
+    }
+  }
+
+  LINK_LOGD(LOG_TAG, "Rehashed vehicle table, %u vehicles", (unsigned)liveCount);
+}
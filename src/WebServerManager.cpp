@@ -3,12 +3,25 @@
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 #include <Update.h>
+#include <esp_heap_caps.h>
 #include "LogManager.h"
 #include "FileSystemManager.h"
 #include "PreferencesManager.h"
 #include "PSRAMJsonAllocator.h"
+#include "MemoryPools.h"
+#include "MemoryMonitor.h"
+#include "PerfMonitor.h"
+#include "TraceRecorder.h"
+#include "Metrics.h"
+#include "FreshnessMonitor.h"
+#include "LoopEvents.h"
 #include "TrainDataManager.h"
 #include "LEDController.h"
+#include "colors.h"
+#include "LEDRenderer.h"
+#include "FrameMirror.h"
+#include "PixelStreamer.h"
+#include "PollScheduler.h"
 
 static const char* LOG_TAG = "WebServerManager";
 
@@ -24,6 +37,14 @@ void WebServerManager::setup() {
   server.on("/api/status", HTTP_GET, [this]() { this->handleStatusApi(); });
   server.on("/api/config", HTTP_GET, [this]() { this->handleConfigApi(); });
   server.on("/api/stations", HTTP_GET, [this]() { this->handleStationsApi(); });
+  server.on("/api/memory", HTTP_GET, [this]() { this->handleMemoryApi(); });
+  server.on("/api/perf", HTTP_GET, [this]() { this->handlePerfApi(); });
+  server.on("/api/perf/reset", HTTP_POST, [this]() { this->handlePerfReset(); });
+  server.on("/api/trace", HTTP_GET, [this]() { this->handleTraceApi(); });
+  server.on("/metrics", HTTP_GET, [this]() { this->handleMetrics(); });
+  server.on("/api/trace", HTTP_POST, [this]() { this->handleTraceControl(); });
+  server.on("/api/timelapse", HTTP_GET, [this]() { this->handleTimelapseApi(); });
+  server.on("/api/timelapse", HTTP_POST, [this]() { this->handleTimelapseControl(); });
   server.on("/update/firmware", HTTP_POST,
     [this]() { this->handleUpdateFirmware(); },
     [this]() { this->handleUpdateFirmwareUpload(); });
@@ -47,7 +68,11 @@ void WebServerManager::setup() {
 }
 
 void WebServerManager::handleClient() {
-  server.handleClient();
+  {
+    TRACE_SLOW_SCOPE("server.handleClient");
+    server.handleClient();
+  }
+  TRACE_SLOW_SCOPE("webSocket.loop");
   webSocket.loop();
 }
 
@@ -61,6 +86,7 @@ String WebServerManager::getMimeType(const String& path) {
 }
 
 void WebServerManager::handleFile() {
+  TRACE_SCOPE("handleFile");
   String path = server.uri();
 
   // Handle root path by serving index.html
@@ -88,9 +114,108 @@ void WebServerManager::handleFile() {
 }
 
 void WebServerManager::handleStatusApi() {
+  TRACE_SCOPE("handleStatusApi");
   JsonDocument doc(PSRAMJsonAllocator::instance());
   doc["hostname"] = preferencesManager.getHostname();
   doc["ipAddress"] = WiFi.localIP().toString();
+  doc["dataAgeAtDisplayMs"] = ledController.getDisplayedDataAgeMs();
+  doc["feedPeriodMs"] = pollScheduler.getFeedPeriodMs();
+  doc["nextPollDelayMs"] = pollScheduler.getLastDelayMs();
+  doc["apiCallsToday"] = pollScheduler.getApiCallsToday();
+
+  const TripCache& tripCache = trainDataManager.getTripCache();
+  uint32_t tripLookups = tripCache.getTotalHits() + tripCache.getTotalMisses();
+  doc["tripCacheSize"] = tripCache.size();
+  doc["tripCacheHitRate"] = tripLookups > 0 ? (float)tripCache.getTotalHits() / tripLookups : 0.0f;
+  doc["parseTimeUs"] = trainDataManager.getLastParseMicros();
+  doc["warmParseTimeUs"] = trainDataManager.getWarmParseMicros();
+  doc["coldParseTimeUs"] = trainDataManager.getColdParseMicros();
+
+  const CycleArena& cycleArena = trainDataManager.getCycleArena();
+  doc["arenaCapacity"] = cycleArena.getCapacity();
+  doc["arenaPeakBytes"] = cycleArena.getHighWater();
+  doc["arenaOverflows"] = cycleArena.getOverflowCount();
+  doc["largestFreeInternal"] = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  doc["largestFreePsram"] = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+  doc["tracingEnabled"] = traceRecorder.isEnabled();
+  doc["renderTimeUs"] = ledController.getLastRenderMicros();
+  doc["averageRenderTimeUs"] = ledController.getAverageRenderMicros();
+
+  JsonObject pools = doc["memoryPools"].to<JsonObject>();
+  for (int i = 0; i < static_cast<int>(MemoryPool::COUNT); i++) {
+    MemoryPool pool = static_cast<MemoryPool>(i);
+    const MemoryPoolStats& poolStats = MemoryPools::getStats(pool);
+    JsonObject poolObj = pools[MemoryPools::poolToString(pool)].to<JsonObject>();
+    poolObj["liveBytes"] = poolStats.liveBytes.load();
+    poolObj["peakBytes"] = poolStats.peakBytes.load();
+    poolObj["allocations"] = poolStats.allocations.load();
+    poolObj["fallbacks"] = poolStats.fallbacks.load();
+    poolObj["failures"] = poolStats.failures.load();
+  }
+
+  // Frames pushed to the strip by the render task, and ticks with nothing new to show
+  JsonObject renderObj = doc["render"].to<JsonObject>();
+  renderObj["framesShown"] = ledRenderer.getFramesShown();
+  renderObj["framesSkipped"] = ledRenderer.getFramesSkipped();
+  renderObj["lateFrames"] = ledRenderer.getLateFrames();
+  renderObj["brightness"] = ledRenderer.getBrightness();
+
+  // Frames mirrored to network stream targets
+  JsonObject streamObj = doc["stream"].to<JsonObject>();
+  streamObj["enabled"] = pixelStreamer.isEnabled();
+  streamObj["protocol"] = PixelStreamer::protocolToString(pixelStreamer.getProtocol());
+  streamObj["targets"] = pixelStreamer.getTargetCount();
+  streamObj["framesSent"] = pixelStreamer.getFramesSent();
+  streamObj["packetsSent"] = pixelStreamer.getPacketsSent();
+  streamObj["sendErrors"] = pixelStreamer.getSendErrors();
+
+  JsonObject layoutObj = doc["layout"].to<JsonObject>();
+  layoutObj["loaded"] = ledLayout.isLoaded();
+  layoutObj["ledCount"] = ledLayout.getLedCount();
+  layoutObj["rows"] = ledLayout.getRowCount();
+  layoutObj["stations"] = ledLayout.getStationCount();
+  layoutObj["outputs"] = ledLayout.getOutputCount();
+
+  // Loop task wakeups and time awake over the last stats window, for comparing idle CPU use
+  JsonObject loopObj = doc["loop"].to<JsonObject>();
+  loopObj["wakeupsPerSecond"] = loopEvents.getWakeupsPerSecond();
+  loopObj["busyPercent"] = loopEvents.getBusyPercent();
+  loopObj["trainDataEvents"] = loopEvents.getEventCount(LOOP_EVENT_TRAIN_DATA);
+  loopObj["networkEvents"] = loopEvents.getEventCount(LOOP_EVENT_NETWORK);
+  loopObj["frameEvents"] = loopEvents.getEventCount(LOOP_EVENT_FRAME);
+  loopObj["timeouts"] = loopEvents.getTimeoutCount();
+
+  // Age of the data along the pipeline, against the freshness target
+  JsonObject freshness = doc["freshness"].to<JsonObject>();
+  freshness["targetSeconds"] = preferencesManager.getFreshnessTarget();
+  freshness["targetBreached"] = freshnessMonitor.isTargetBreached();
+  FreshnessSummary displayAge = freshnessMonitor.getDisplayAgeSummary();
+  JsonObject displayObj = freshness["ageAtDisplay"].to<JsonObject>();
+  displayObj["samples"] = displayAge.samples;
+  displayObj["p50Ms"] = displayAge.p50Ms;
+  displayObj["p95Ms"] = displayAge.p95Ms;
+  displayObj["maxMs"] = displayAge.maxMs;
+  FreshnessSummary broadcastAge = freshnessMonitor.getBroadcastAgeSummary();
+  JsonObject broadcastObj = freshness["ageAtBroadcast"].to<JsonObject>();
+  broadcastObj["samples"] = broadcastAge.samples;
+  broadcastObj["p50Ms"] = broadcastAge.p50Ms;
+  broadcastObj["p95Ms"] = broadcastAge.p95Ms;
+  broadcastObj["maxMs"] = broadcastAge.maxMs;
+
+  // Latest snapshot's stamps as delays from the newest upstream update, null until that stage is reached
+  FreshnessStamps stamps = freshnessMonitor.getLatestStamps();
+  JsonObject latest = freshness["latest"].to<JsonObject>();
+  latest["mergeSeq"] = stamps.mergeSeq;
+  latest["upstreamTime"] = stamps.upstreamTime;
+  if (stamps.feedRefreshKnown) {
+    latest["fetchCompleteMs"] = stamps.fetchCompleteMillis - stamps.feedRefreshMillis;
+    if (stamps.ledShownMillis != 0) {
+      latest["ledShownMs"] = stamps.ledShownMillis - stamps.feedRefreshMillis;
+    }
+    if (stamps.broadcastMillis != 0) {
+      latest["broadcastMs"] = stamps.broadcastMillis - stamps.feedRefreshMillis;
+    }
+  }
 
   String response;
   serializeJson(doc, response);
@@ -98,12 +223,26 @@ void WebServerManager::handleStatusApi() {
 }
 
 void WebServerManager::handleConfigApi() {
+  TRACE_SCOPE("handleConfigApi");
   JsonDocument doc(PSRAMJsonAllocator::instance());
   doc["apiKey"] = preferencesManager.getApiKey();
   doc["hostname"] = preferencesManager.getHostname();
   doc["timezone"] = preferencesManager.getTimezone();
   doc["updateInterval"] = preferencesManager.getUpdateInterval();
   doc["atStationThreshold"] = preferencesManager.getAtStationThreshold();
+  doc["dailyApiBudget"] = preferencesManager.getDailyApiBudget();
+  doc["freshnessTarget"] = preferencesManager.getFreshnessTarget();
+  doc["renderRate"] = preferencesManager.getRenderRate();
+  doc["brightness"] = preferencesManager.getBrightness();
+  doc["nightBrightness"] = preferencesManager.getNightBrightness();
+  doc["nightStart"] = preferencesManager.getNightStart();
+  doc["nightEnd"] = preferencesManager.getNightEnd();
+  doc["streamProtocol"] = preferencesManager.getStreamProtocol();
+  doc["streamTargets"] = preferencesManager.getStreamTargets();
+  doc["streamRate"] = preferencesManager.getStreamRate();
+  doc["ingestMode"] = preferencesManager.getIngestMode();
+  doc["routeLines"] = preferencesManager.getRouteLines();
+  doc["apiBaseUrl"] = preferencesManager.getApiBaseUrl();
   doc["line1Color"] = preferencesManager.getLine1Color();
   doc["line2Color"] = preferencesManager.getLine2Color();
   doc["sharedColor"] = preferencesManager.getSharedColor();
@@ -114,14 +253,16 @@ void WebServerManager::handleConfigApi() {
 }
 
 void WebServerManager::handleStationsApi() {
+  TRACE_SCOPE("handleStationsApi");
   JsonDocument doc(PSRAMJsonAllocator::instance());
   JsonArray stations = doc.to<JsonArray>();
 
-  const std::map<String, StationLEDMapping>& stationMap = ledController.getStationMap();
-  for (const auto& station : stationMap) {
+  // In layout order, which follows the lines
+  for (size_t ordinal = 0; ordinal < ledLayout.getStationCount(); ordinal++) {
+    const String& name = ledLayout.getStation(ordinal).name;
     JsonObject stationObj = stations.add<JsonObject>();
-    stationObj["name"] = station.first;
-    String id = station.first;
+    stationObj["name"] = name;
+    String id = name;
     // Encode spaces as %20 since station names with spaces cannot be used as values in sl-option elements on the frontend
     id.replace(" ", "%20");
     stationObj["id"] = id;
@@ -132,7 +273,103 @@ void WebServerManager::handleStationsApi() {
   server.send(200, "application/json", response);
 }
 
+void WebServerManager::handleMemoryApi() {
+  TRACE_SCOPE("handleMemoryApi");
+  // Number of history points to return, older samples are merged into buckets to fit
+  long points = MEMORY_DEFAULT_POINTS;
+  if (server.hasArg("points")) {
+    points = server.arg("points").toInt();
+    if (points <= 0 || points > MEMORY_HISTORY_SIZE) {
+      points = MEMORY_HISTORY_SIZE;
+    }
+  }
+
+  String jsonResponse;
+  memoryMonitor.getHistoryAsJson(jsonResponse, points);
+  server.send(200, "application/json", jsonResponse);
+}
+
+void WebServerManager::handlePerfApi() {
+  TRACE_SCOPE("handlePerfApi");
+  String jsonResponse;
+  perfMonitor.getPerfAsJson(jsonResponse);
+  server.send(200, "application/json", jsonResponse);
+}
+
+void WebServerManager::handlePerfReset() {
+  perfMonitor.reset();
+  LINK_LOGI(LOG_TAG, "Performance histograms reset");
+  server.send(200, "text/plain", "OK");
+}
+
+void WebServerManager::handleTraceApi() {
+  String jsonResponse;
+  traceRecorder.getTraceAsJson(jsonResponse);
+  // Downloaded as a file so it can be opened directly in Perfetto or chrome://tracing
+  server.sendHeader("Content-Disposition", "attachment; filename=\"linklight-trace.json\"");
+  server.send(200, "application/json", jsonResponse);
+}
+
+void WebServerManager::handleTraceControl() {
+  if (!server.hasArg("enabled")) {
+    server.send(400, "text/plain", "Missing enabled parameter");
+    return;
+  }
+
+  traceRecorder.setEnabled(server.arg("enabled") == "true");
+  server.send(200, "text/plain", traceRecorder.isEnabled() ? "Tracing enabled" : "Tracing disabled");
+}
+
+void WebServerManager::handleTimelapseApi() {
+  TRACE_SCOPE("handleTimelapseApi");
+  TimelapseStats stats = timelapseRecorder.getStats(millis());
+  JsonDocument doc(PSRAMJsonAllocator::instance());
+  doc["capacityBytes"] = stats.capacity;
+  doc["usedBytes"] = stats.bytesUsed;
+  doc["writtenBytes"] = stats.bytesWritten;
+  doc["records"] = stats.records;
+  doc["keyframes"] = stats.keyframes;
+  doc["recordedSeconds"] = stats.spanSeconds;
+  doc["bytesPerDay"] = stats.bytesPerDay;
+  doc["averageRecordMicros"] = stats.averageRecordMicros;
+  doc["playing"] = ledController.isPlaying();
+  if (ledController.isPlaying()) {
+    doc["playbackSecondsAgo"] = ledController.getPlaybackSecondsAgo();
+  }
+
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Starts playback of the last "hours" at "speed" times real time, or stops it with stop=true
+void WebServerManager::handleTimelapseControl() {
+  if (server.arg("stop") == "true") {
+    ledController.stopPlayback();
+    server.send(200, "text/plain", "Playback stopped");
+    return;
+  }
+
+  float hours = server.hasArg("hours") ? server.arg("hours").toFloat() : 1.0f;
+  long speed = server.hasArg("speed") ? server.arg("speed").toInt() : TIMELAPSE_DEFAULT_SPEED;
+  if (hours <= 0 || hours > 24 * 7 || speed < 1 || speed > TIMELAPSE_MAX_SPEED) {
+    server.send(400, "text/plain", "hours must be up to 168 and speed 1-" + String(TIMELAPSE_MAX_SPEED));
+    return;
+  }
+  if (!ledController.startPlayback(hours, (uint16_t)speed)) {
+    server.send(409, "text/plain", "Nothing recorded yet");
+    return;
+  }
+  server.send(200, "text/plain", "Playback started");
+}
+
+void WebServerManager::handleMetrics() {
+  TRACE_SCOPE("handleMetrics");
+  metrics.writePrometheus(server);
+}
+
 void WebServerManager::handleSaveConfig() {
+  TRACE_SCOPE("handleSaveConfig");
   // Validate and sanitize inputs
   if (server.hasArg("apiKey")) {
     String apiKey = server.arg("apiKey");
@@ -179,11 +416,11 @@ void WebServerManager::handleSaveConfig() {
     preferencesManager.setTimezone(timezone);
   }
   
-  // Handle update interval with validation (15-60 seconds)
+  // Handle update interval with validation (15-120 seconds)
   if (server.hasArg("updateInterval")) {
     int interval = server.arg("updateInterval").toInt();
-    // Validate range: 15-60 seconds
-    if (interval >= 15 && interval <= 60) {
+    // Validate range: 15-120 seconds. Positions are dead-reckoned between polls, so longer intervals still look current.
+    if (interval >= 15 && interval <= 120) {
       preferencesManager.setUpdateInterval(interval);
     } else {
       // Use default if out of range
@@ -203,6 +440,163 @@ void WebServerManager::handleSaveConfig() {
     }
   }
   
+  // Handle daily API budget with validation (0 disables the budget)
+  if (server.hasArg("dailyApiBudget")) {
+    long budget = server.arg("dailyApiBudget").toInt();
+    // Validate range: 0-100000 calls per day
+    if (budget >= 0 && budget <= 100000) {
+      preferencesManager.setDailyApiBudget(budget);
+    } else {
+      // Use default if out of range
+      preferencesManager.setDailyApiBudget(DEFAULT_DAILY_API_BUDGET);
+    }
+  }
+  
+  // Handle data freshness target with validation (0 disables the warning)
+  if (server.hasArg("freshnessTarget")) {
+    long target = server.arg("freshnessTarget").toInt();
+    // Validate range: 0-600 seconds
+    if (target >= 0 && target <= 600) {
+      preferencesManager.setFreshnessTarget(target);
+    } else {
+      // Use default if out of range
+      preferencesManager.setFreshnessTarget(DEFAULT_FRESHNESS_TARGET);
+    }
+  }
+  
+  // Handle LED frame rate with validation
+  if (server.hasArg("renderRate")) {
+    long rate = server.arg("renderRate").toInt();
+    // Validate range: 1-60 frames per second
+    if (rate >= 1 && rate <= 60) {
+      preferencesManager.setRenderRate(rate);
+    } else {
+      // Use default if out of range
+      preferencesManager.setRenderRate(DEFAULT_RENDER_RATE);
+    }
+  }
+  
+  // Handle brightness with validation
+  if (server.hasArg("brightness")) {
+    long brightness = server.arg("brightness").toInt();
+    // Validate range: 1-100 percent, so the strip can't be turned off by accident
+    if (brightness >= 1 && brightness <= 100) {
+      preferencesManager.setBrightness(brightness);
+    } else {
+      // Use default if out of range
+      preferencesManager.setBrightness(DEFAULT_BRIGHTNESS);
+    }
+  }
+  
+  // Handle night brightness with validation (0 turns the strip off at night)
+  if (server.hasArg("nightBrightness")) {
+    long brightness = server.arg("nightBrightness").toInt();
+    // Validate range: 0-100 percent
+    if (brightness >= 0 && brightness <= 100) {
+      preferencesManager.setNightBrightness(brightness);
+    } else {
+      // Use default if out of range
+      preferencesManager.setNightBrightness(DEFAULT_NIGHT_BRIGHTNESS);
+    }
+  }
+  
+  // Handle night start and end hours with validation
+  if (server.hasArg("nightStart")) {
+    long hour = server.arg("nightStart").toInt();
+    // Validate range: 0-23
+    if (hour >= 0 && hour <= 23) {
+      preferencesManager.setNightStart(hour);
+    } else {
+      // Use default if out of range
+      preferencesManager.setNightStart(DEFAULT_NIGHT_START);
+    }
+  }
+  
+  if (server.hasArg("nightEnd")) {
+    long hour = server.arg("nightEnd").toInt();
+    // Validate range: 0-23
+    if (hour >= 0 && hour <= 23) {
+      preferencesManager.setNightEnd(hour);
+    } else {
+      // Use default if out of range
+      preferencesManager.setNightEnd(DEFAULT_NIGHT_END);
+    }
+  }
+  
+  // Handle frame streaming, anything unrecognized turns it off
+  if (server.hasArg("streamProtocol")) {
+    String streamProtocol = server.arg("streamProtocol");
+    if (streamProtocol == STREAM_PROTOCOL_DDP || streamProtocol == STREAM_PROTOCOL_E131) {
+      preferencesManager.setStreamProtocol(streamProtocol);
+    } else {
+      preferencesManager.setStreamProtocol(STREAM_PROTOCOL_OFF);
+    }
+  }
+  
+  if (server.hasArg("streamTargets")) {
+    String streamTargets = server.arg("streamTargets");
+    streamTargets.trim();
+    // Limit length to prevent excessive storage use
+    if (streamTargets.length() > MAX_PREFERENCE_LENGTH) {
+      streamTargets = streamTargets.substring(0, MAX_PREFERENCE_LENGTH);
+    }
+    preferencesManager.setStreamTargets(streamTargets);
+  }
+  
+  if (server.hasArg("streamRate")) {
+    long rate = server.arg("streamRate").toInt();
+    // Validate range: 1-60 frames per second
+    if (rate >= 1 && rate <= 60) {
+      preferencesManager.setStreamRate(rate);
+    } else {
+      // Use default if out of range
+      preferencesManager.setStreamRate(DEFAULT_STREAM_RATE);
+    }
+  }
+  
+  // Handle ingest mode, anything unrecognized falls back to per-route requests
+  if (server.hasArg("ingestMode")) {
+    String ingestMode = server.arg("ingestMode");
+    if (ingestMode == INGEST_MODE_AGENCY) {
+      preferencesManager.setIngestMode(INGEST_MODE_AGENCY);
+    } else {
+      preferencesManager.setIngestMode(INGEST_MODE_ROUTE);
+    }
+  }
+  
+  // Handle route to line mapping
+  if (server.hasArg("routeLines")) {
+    String routeLines = server.arg("routeLines");
+    routeLines.trim();
+    // Limit length to prevent excessive storage use
+    if (routeLines.length() > MAX_PREFERENCE_LENGTH) {
+      routeLines = routeLines.substring(0, MAX_PREFERENCE_LENGTH);
+    }
+    // Use default if empty
+    if (routeLines.isEmpty()) {
+      routeLines = DEFAULT_ROUTE_LINES;
+    }
+    preferencesManager.setRouteLines(routeLines);
+  }
+  
+  // Handle API base URL, e.g. to point at a local server hosting the sample fixtures
+  if (server.hasArg("apiBaseUrl")) {
+    String apiBaseUrl = server.arg("apiBaseUrl");
+    apiBaseUrl.trim();
+    // Limit length to prevent excessive storage use
+    if (apiBaseUrl.length() > MAX_PREFERENCE_LENGTH) {
+      apiBaseUrl = apiBaseUrl.substring(0, MAX_PREFERENCE_LENGTH);
+    }
+    while (apiBaseUrl.endsWith("/")) {
+      apiBaseUrl.remove(apiBaseUrl.length() - 1);
+    }
+    // Use default if empty or not an HTTP URL
+    if (!apiBaseUrl.startsWith("http://") && !apiBaseUrl.startsWith("https://")) {
+      apiBaseUrl = DEFAULT_API_BASE_URL;
+    }
+    preferencesManager.setApiBaseUrl(apiBaseUrl);
+  }
+  
   // Handle Line 1 color
   if (server.hasArg("line1Color")) {
     String line1Color = server.arg("line1Color");
@@ -231,11 +625,22 @@ void WebServerManager::handleSaveConfig() {
   }
   
   preferencesManager.save();
+
+  // Apply new line colors to the trains already on the strip
+  ColorManager::refreshPalette();
+  ledController.refreshColors();
+
+  // Point the stream at any new targets
+  pixelStreamer.configure();
+
+  // Poll right away so new settings (e.g. an API key) take effect without waiting out a long back-off
+  pollScheduler.wake();
   
   server.send(200, "text/plain", "OK");
 }
 
 void WebServerManager::handleTestStation() {
+  TRACE_SCOPE("handleTestStation");
   // Get the station name from the request
   if (!server.hasArg("stationName")) {
     server.send(400, "text/plain", "Missing stationName parameter");
@@ -253,6 +658,7 @@ void WebServerManager::handleTestStation() {
 }
 
 void WebServerManager::handleLogsData() {
+  TRACE_SCOPE("handleLogsData");
   String jsonResponse;
   logManager.getLogsAsJson(jsonResponse);
   server.send(200, "application/json", jsonResponse);
@@ -338,21 +744,33 @@ void WebServerManager::handleUpdateFilesystemUpload() {
 
 void WebServerManager::sendTrainData(int clientNum) {
   String jsonResponse;
-  trainDataManager.getTrainDataAsJson(jsonResponse);
   if (clientNum == -1) {
     if (webSocket.connectedClients() == 0) {
       return;
     }
-    webSocket.broadcastTXT(jsonResponse);
+    PERF_SCOPE(PerfStage::WS_BROADCAST);
+    // Every connected client has the last broadcast, so only what changed since then needs sending.
+    // If broadcasts were skipped while nobody was connected this falls back to the full list.
+    if (!trainDataManager.getTrainDataDeltaAsJson(jsonResponse, sentTrainDataSeq)) {
+      return;
+    }
+    broadcastText(jsonResponse);
+    freshnessMonitor.recordBroadcast();
   } else {
-    webSocket.sendTXT(static_cast<uint8_t>(clientNum), jsonResponse);
+    // New clients start from the full list
+    trainDataManager.getTrainDataAsJson(jsonResponse);
+    sendText(static_cast<uint8_t>(clientNum), jsonResponse);
   }
 }
 
 void WebServerManager::handleWebSocketEvent(uint8_t clientNum, WStype_t type, uint8_t * payload, size_t length) {
+  TRACE_SCOPE("handleWebSocketEvent");
   switch(type) {
     case WStype_DISCONNECTED:
       LINK_LOGD(LOG_TAG, "WebSocket client #%u disconnected", clientNum);
+      memorySubscribers &= ~(1UL << clientNum);
+      frameSubscribers &= ~(1UL << clientNum);
+      frameMirror.setWanted(frameSubscribers != 0);
       break;
       
     case WStype_CONNECTED: {
@@ -370,7 +788,7 @@ void WebServerManager::handleWebSocketEvent(uint8_t clientNum, WStype_t type, ui
       // Handle incoming text messages
       LINK_LOGD(LOG_TAG, "WebSocket message from client #%u: %s", clientNum, payload);
       {
-        JsonDocument doc(PSRAMJsonAllocator::instance());
+        JsonDocument doc(PSRAMJsonAllocator::instance(JsonPurpose::WS_INBOUND));
         DeserializationError error = deserializeJson(doc, payload, length);
         if (!error) {
           const char* type = doc["type"] | "";
@@ -378,6 +796,26 @@ void WebServerManager::handleWebSocketEvent(uint8_t clientNum, WStype_t type, ui
             const char* vehicleId = doc["vehicleId"] | "";
             preferencesManager.setFocusedVehicleId(String(vehicleId));
             LINK_LOGD(LOG_TAG, "Focused vehicle ID set to: %s", vehicleId);
+          } else if (strcmp(type, "subscribe") == 0 || strcmp(type, "unsubscribe") == 0) {
+            const char* topic = doc["topic"] | "";
+            if (strcmp(topic, "memory") == 0) {
+              if (strcmp(type, "subscribe") == 0) {
+                memorySubscribers |= 1UL << clientNum;
+              } else {
+                memorySubscribers &= ~(1UL << clientNum);
+              }
+            } else if (strcmp(topic, "frames") == 0) {
+              if (strcmp(type, "subscribe") == 0) {
+                int fps = constrain(doc["fps"] | FRAME_MIRROR_DEFAULT_FPS, 1, FRAME_MIRROR_MAX_FPS);
+                frameIntervalMs[clientNum] = 1000 / fps;
+                frameSentMillis[clientNum] = millis() - frameIntervalMs[clientNum];
+                frameSentSeq[clientNum] = 0;  // Nothing sent yet, so the frame on the strip goes out next
+                frameSubscribers |= 1UL << clientNum;
+              } else {
+                frameSubscribers &= ~(1UL << clientNum);
+              }
+              frameMirror.setWanted(frameSubscribers != 0);
+            }
           }
         }
       }
@@ -399,7 +837,7 @@ void WebServerManager::broadcastLog(const LogEntry& entry) {
   
   String jsonResponse;
   logManager.getLogEntryAsJson(entry, jsonResponse);
-  webSocket.broadcastTXT(jsonResponse);
+  broadcastText(jsonResponse);
 }
 
 void WebServerManager::sendLogData(int clientNum) {
@@ -409,21 +847,101 @@ void WebServerManager::sendLogData(int clientNum) {
     if (webSocket.connectedClients() == 0) {
       return;
     }
-    webSocket.broadcastTXT(jsonResponse);
+    broadcastText(jsonResponse);
   } else {
-    webSocket.sendTXT(static_cast<uint8_t>(clientNum), jsonResponse);
+    sendText(static_cast<uint8_t>(clientNum), jsonResponse);
   }
 }
 
 void WebServerManager::sendLEDState(int clientNum) {
   String jsonResponse;
-  ledController.getLEDStateAsJson(jsonResponse);
   if (clientNum == -1) {
     if (webSocket.connectedClients() == 0) {
       return;
     }
-    webSocket.broadcastTXT(jsonResponse);
+    PERF_SCOPE(PerfStage::WS_BROADCAST);
+    ledController.getLEDStateAsJson(jsonResponse);
+    broadcastText(jsonResponse);
   } else {
-    webSocket.sendTXT(static_cast<uint8_t>(clientNum), jsonResponse);
+    ledController.getLEDStateAsJson(jsonResponse);
+    sendText(static_cast<uint8_t>(clientNum), jsonResponse);
+  }
+}
+
+void WebServerManager::sendMemoryState() {
+  // Only clients that asked for the memory topic get live samples
+  if (memorySubscribers == 0) {
+    return;
+  }
+
+  String jsonResponse;
+  memoryMonitor.getLiveAsJson(jsonResponse);
+  for (uint8_t clientNum = 0; clientNum < WEBSOCKETS_SERVER_CLIENT_MAX; clientNum++) {
+    if (memorySubscribers & (1UL << clientNum)) {
+      sendText(clientNum, jsonResponse);
+    }
+  }
+}
+
+// The WebSocket header is written into the room in front of the frame, so the frame is sent without a copy
+static_assert(FRAME_MIRROR_HEADER_ROOM == WEBSOCKETS_MAX_HEADER_SIZE, "Mirror buffers need room for a WebSocket header");
+
+void WebServerManager::sendFrames() {
+  if (frameSubscribers == 0) {
+    return;
+  }
+
+  uint16_t ledCount = 0;
+  uint32_t seq = 0;
+  MirrorBuffer* buffer = frameMirror.acquire(ledCount, seq);
+  if (buffer != nullptr) {
+    uint32_t now = millis();
+    size_t length = ledCount * sizeof(RgbColor);
+    for (uint8_t clientNum = 0; clientNum < WEBSOCKETS_SERVER_CLIENT_MAX; clientNum++) {
+      // Only frames that changed since the client's last one, and no faster than the rate it asked for
+      if (!(frameSubscribers & (1UL << clientNum)) || frameSentSeq[clientNum] == seq ||
+          now - frameSentMillis[clientNum] < frameIntervalMs[clientNum]) {
+        continue;
+      }
+      if (webSocket.sendBIN(clientNum, buffer->header, length, true)) {
+        metrics.recordWebSocketSend(length, 1);
+      }
+      frameSentSeq[clientNum] = seq;
+      frameSentMillis[clientNum] = now;
+    }
+  }
+  frameMirror.release();
+}
+
+uint32_t WebServerManager::getFrameWaitMs() {
+  uint32_t seq = frameMirror.getSeq();
+  if (frameSubscribers == 0 || seq == 0) {
+    return UINT32_MAX;
+  }
+
+  uint32_t now = millis();
+  uint32_t wait = UINT32_MAX;
+  for (uint8_t clientNum = 0; clientNum < WEBSOCKETS_SERVER_CLIENT_MAX; clientNum++) {
+    if (!(frameSubscribers & (1UL << clientNum)) || frameSentSeq[clientNum] == seq) {
+      continue;
+    }
+    uint32_t elapsed = now - frameSentMillis[clientNum];
+    uint32_t due = elapsed >= frameIntervalMs[clientNum] ? 0 : frameIntervalMs[clientNum] - elapsed;
+    if (due < wait) {
+      wait = due;
+    }
+  }
+  return wait;
+}
+
+void WebServerManager::broadcastText(String& message) {
+  int clients = webSocket.connectedClients();
+  webSocket.broadcastTXT(message);
+  metrics.recordWebSocketSend(message.length(), clients);
+}
+
+void WebServerManager::sendText(uint8_t clientNum, String& message) {
+  if (webSocket.sendTXT(clientNum, message)) {
+    metrics.recordWebSocketSend(message.length(), 1);
   }
 }
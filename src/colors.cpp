@@ -1,6 +1,9 @@
 #include "colors.h"
 #include "PreferencesManager.h"
 
+LinePalette ColorManager::palettes[2];
+std::atomic<const LinePalette*> ColorManager::activePalette{&ColorManager::palettes[0]};
+
 RgbColor ColorManager::hexToRgb(const String& hexColor) {
   // Remove '#' if present
   String hex = hexColor;
@@ -22,17 +25,11 @@ RgbColor ColorManager::hexToRgb(const String& hexColor) {
   return RgbColor(r, g, b);
 }
 
-RgbColor ColorManager::getLine1Color() {
-  String hexColor = preferencesManager.getLine1Color();
-  return hexToRgb(hexColor);
-}
-
-RgbColor ColorManager::getLine2Color() {
-  String hexColor = preferencesManager.getLine2Color();
-  return hexToRgb(hexColor);
-}
-
-RgbColor ColorManager::getSharedLineColor() {
-  String hexColor = preferencesManager.getSharedColor();
-  return hexToRgb(hexColor);
+void ColorManager::refreshPalette() {
+  // Only the loop task refreshes, so writing the slot that isn't active can't race another refresh
+  LinePalette* next = activePalette.load() == &palettes[0] ? &palettes[1] : &palettes[0];
+  next->line1 = hexToRgb(preferencesManager.getLine1Color());
+  next->line2 = hexToRgb(preferencesManager.getLine2Color());
+  next->shared = hexToRgb(preferencesManager.getSharedColor());
+  activePalette.store(next, std::memory_order_release);
 }
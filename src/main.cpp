@@ -6,10 +6,19 @@
 #include "OTAManager.h"
 #include "WebServerManager.h"
 #include "LEDController.h"
+#include "LEDLayout.h"
+#include "colors.h"
+#include "LEDRenderer.h"
+#include "PixelStreamer.h"
 #include "PreferencesManager.h"
 #include "FileSystemManager.h"
 #include "TrainDataManager.h"
 #include "NTPManager.h"
+#include "PollScheduler.h"
+#include "MemoryMonitor.h"
+#include "TraceRecorder.h"
+#include "LoopEvents.h"
+#include <algorithm>
 
 static const char* LOG_TAG = "LinkLight";
 static TaskHandle_t loopTaskHandle = nullptr;
@@ -29,18 +38,21 @@ void dumpMemoryStats()
 }
 
 void trainUpdateTask(void* parameter) {
-  TaskHandle_t notifyTarget = static_cast<TaskHandle_t>(parameter);
   while (true) {
     dumpMemoryStats();
 
-    trainDataManager.updateTrainPositions();
+    {
+      TRACE_SCOPE("updateTrainPositions");
+      trainDataManager.updateTrainPositions();
+    }
 
     dumpMemoryStats();
 
-    xTaskNotifyGive(notifyTarget);
+    loopEvents.signal(LOOP_EVENT_TRAIN_DATA);
 
-    unsigned long updateIntervalMs = preferencesManager.getUpdateInterval() * 1000;
-    vTaskDelay(pdMS_TO_TICKS(updateIntervalMs));
+    // Pick the next poll time from the snapshot just fetched rather than sleeping a fixed interval
+    uint32_t delayMs = pollScheduler.nextPollDelayMs(trainDataManager.getPollSnapshot());
+    pollScheduler.waitForNextPoll(delayMs);
   }
 }
 
@@ -50,14 +62,17 @@ void setup() {
   // Initialize log manager early to capture all logs
   logManager.setup();
 
+  // Initialize LittleFS, then load the LED layout from it so the strip can be set up at the right length
+  fileSystemManager.setup();
+  ledLayout.load();
+
   // Initialize LEDs
   ledController.setup();
 
-  // Initialize LittleFS
-  fileSystemManager.setup();
-  
   // Load saved preferences
   preferencesManager.load();
+  ColorManager::refreshPalette();
+  pixelStreamer.configure();
   
   // Setup WiFi
   wifiManagerComponent.setup();
@@ -71,8 +86,9 @@ void setup() {
   // Setup web server
   webServerManager.setup();
   
-  // Show the startup animation
+  // Show the startup animation, then hand the strip to the render task
   ledController.startupAnimation();
+  ledRenderer.start();
 
   // Initialize the train data mutex
   trainDataManager.dataMutex = xSemaphoreCreateMutex();
@@ -81,37 +97,82 @@ void setup() {
     return;
   }
 
-  // Capture the loop task handle so the Core 0 task can notify it
+  // Capture the loop task handle so other tasks can raise loop events on it
   loopTaskHandle = xTaskGetCurrentTaskHandle();
+  loopEvents.begin();
 
-  // Start the train update task on Core 0, passing the loop task handle for notifications
-  if (xTaskCreatePinnedToCore(trainUpdateTask, "TrainUpdate", 8192, loopTaskHandle, 1, NULL, 0) != pdPASS) {
+  // Start the train update task on Core 0
+  TaskHandle_t trainUpdateTaskHandle = nullptr;
+  if (xTaskCreatePinnedToCore(trainUpdateTask, "TrainUpdate", 8192, nullptr, 1, &trainUpdateTaskHandle, 0) != pdPASS) {
     LINK_LOGE(LOG_TAG, "Failed to create train update task");
     return;
   }
 
+  // Let the poll scheduler wake the train update task early, e.g. after a configuration change
+  pollScheduler.setTask(trainUpdateTaskHandle);
+
+  // Record stack high-water marks of both tasks in the memory history
+  memoryMonitor.registerTask("loop", loopTaskHandle);
+  memoryMonitor.registerTask("TrainUpdate", trainUpdateTaskHandle);
+
   LINK_LOGI(LOG_TAG, "LinkLight Ready!");
 }
 
 void loop() {
-  // Handle OTA updates
-  otaManager.handle();
-  
-  // Handle web server requests
-  webServerManager.handleClient();
+  // Sleep until new train data arrives, a server socket is readable, a frame is shown while clients mirror the
+  // strip, or the next prediction tick, playback step or held-back mirror frame is due
+  static unsigned long lastPredictionMillis = 0;
+  static uint32_t playbackWaitMs = UINT32_MAX;
+  unsigned long sincePrediction = millis() - lastPredictionMillis;
+  uint32_t untilPrediction = sincePrediction >= PREDICTION_TICK_INTERVAL ? 0 : PREDICTION_TICK_INTERVAL - sincePrediction;
+  uint32_t waitMs = std::min<uint32_t>(untilPrediction, LOOP_MAX_WAIT);
+  waitMs = std::min<uint32_t>(waitMs, playbackWaitMs);
+  uint32_t events = loopEvents.wait(std::min<uint32_t>(waitMs, webServerManager.getFrameWaitMs()));
+
+  // Service OTA and web clients when a socket is readable, and on timeouts so library timeouts still run
+  if ((events & LOOP_EVENT_NETWORK) || events == 0) {
+    {
+      TRACE_SLOW_SCOPE("otaManager.handle");
+      otaManager.handle();
+    }
+    webServerManager.handleClient();
+    if (events & LOOP_EVENT_NETWORK) {
+      loopEvents.networkHandled();
+    }
+  }
   
   // When the Core 0 train update task signals new data is ready, broadcast and display it
-  if (ulTaskNotifyTake(pdTRUE, 0) > 0) {
+  if (events & LOOP_EVENT_TRAIN_DATA) {
+    TRACE_SCOPE("publishTrainData");
     // Broadcast updated train data to connected WebSocket clients
     webServerManager.sendTrainData();
     
-    // Display current train positions on LEDs
-    ledController.displayTrainPositions();
-    
-    // Broadcast updated LED state to connected WebSocket clients
-    webServerManager.sendLEDState();
+    // Display current train positions on LEDs, and broadcast the LED state if any train moved
+    if (ledController.displayTrainPositions()) {
+      webServerManager.sendLEDState();
+    }
+  }
+
+  // Between polls, advance trains along the strip from their last known offsets
+  if (millis() - lastPredictionMillis >= PREDICTION_TICK_INTERVAL) {
+    TRACE_SCOPE("refreshPredictedPositions");
+    lastPredictionMillis = millis();
+    if (ledController.refreshPredictedPositions()) {
+      webServerManager.sendLEDState();
+    }
+  }
+
+  // Advance any timelapse playback. Live trains are still tracked and recorded underneath.
+  playbackWaitMs = ledController.updatePlayback();
+
+  // Send the strip's latest frame to mirroring clients, each at its own rate
+  if ((events & LOOP_EVENT_FRAME) || webServerManager.getFrameWaitMs() == 0) {
+    webServerManager.sendFrames();
+  }
+
+  // Record memory history and push live samples to subscribed WebSocket clients
+  if (memoryMonitor.handle()) {
+    webServerManager.sendMemoryState();
   }
-    
-  delay(10);
 }
 
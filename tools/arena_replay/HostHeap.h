@@ -0,0 +1,27 @@
+// Host stand-ins for the MemoryPools, heap_caps and LogManager calls CycleArena makes, so the arena_replay
+// environment can build it unchanged. tools/arena_replay/main.cpp implements them over its model of the PSRAM
+// heap.
+
+#ifndef HOSTHEAP_H
+#define HOSTHEAP_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+enum class MemoryPool {
+  BULK_PSRAM
+};
+
+class MemoryPools {
+public:
+  static void* allocate(MemoryPool pool, size_t size, bool* fellBack = nullptr);
+  static void* reallocate(MemoryPool pool, void* ptr, size_t newSize, bool* fellBack = nullptr);
+  static void deallocate(MemoryPool pool, void* ptr);
+};
+
+size_t heap_caps_get_allocated_size(void* ptr);
+
+#define LINK_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define LINK_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+
+#endif // HOSTHEAP_H
@@ -0,0 +1,367 @@
+// Host replay of a day of update cycles against a model of the PSRAM heap, built by the arena_replay PlatformIO
+// environment:
+//
+//   pio run -e arena_replay && .pio/build/arena_replay/program [hours] [pollSeconds]
+//
+// Runs the same day of polls twice, once allocating each cycle's memory from CycleArena and once straight from
+// the heap as the firmware did before the arena, and prints how the heap's largest free block holds up. The
+// heap is a first-fit allocator with coalescing over 2 MB, like the ESP-IDF 4.4 heap in the Arduino core,
+// standing in for the part of PSRAM the rest of the firmware leaves free.
+//
+// Each cycle parses one response per line the way ArduinoJson does: slot pools of JSON_POOL_BYTES, a pool list
+// that doubles, and strings that start at 31 bytes, double as they're read and shrink to fit. Then the trains
+// are staged with six strings each and the document is freed. Trains running follow a weekday timetable, with
+// none between 01:00 and 05:00. Between the parse steps other tasks allocate the way they do on the device:
+// trip cache strings that live as long as their trip, and web responses that live for up to two cycles. Those
+// land in the heap in both runs.
+//
+// Fragmentation is the share of free memory outside the largest free block, checked after every cycle. Exits
+// with 1 if, with the arena, the largest free block ends the day below 95% of what it was after the first hour,
+// the heap fragmented more than without the arena, or the arena overflowed into the heap.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
+#include "CycleArena.h"
+#include "HostHeap.h"
+#include "config.h"
+
+static const size_t HEAP_SIZE = 2 * 1024 * 1024;
+static const size_t HEAP_ALIGNMENT = 8;
+static const size_t JSON_POOL_BYTES = 2048;  // 256 slots of 8 bytes
+static const size_t JSON_SLOTS_PER_TRAIN = 40;
+static const int JSON_STRINGS_PER_TRAIN = 8;
+static const int STAGED_STRINGS_PER_TRAIN = 6;
+static const size_t STAGED_TRAIN_BYTES = 64;  // sizeof(StagedTrain) on the ESP32
+static const int ROUTE_COUNT = 2;
+
+// First-fit heap with coalescing over a fixed block of memory
+class SimHeap {
+public:
+  SimHeap() : memory(HEAP_SIZE) { addFree(0, HEAP_SIZE); }
+
+  void* allocate(size_t size) {
+    size_t needed = (size + HEAP_ALIGNMENT - 1) / HEAP_ALIGNMENT * HEAP_ALIGNMENT;
+    if (needed == 0) {
+      needed = HEAP_ALIGNMENT;
+    }
+    auto first = freeByOffset.begin();
+    while (first != freeByOffset.end() && first->second < needed) {
+      ++first;
+    }
+    if (first == freeByOffset.end()) {
+      return nullptr;
+    }
+    size_t offset = first->first;
+    size_t blockSize = first->second;
+    removeFree(offset, blockSize);
+    if (blockSize > needed) {
+      addFree(offset + needed, blockSize - needed);
+    }
+    used[offset] = needed;
+    freeBytes -= needed;
+    return memory.data() + offset;
+  }
+
+  void deallocate(void* ptr) {
+    size_t offset = static_cast<uint8_t*>(ptr) - memory.data();
+    auto block = used.find(offset);
+    size_t size = block->second;
+    used.erase(block);
+    freeBytes += size;
+
+    // Merge with the free blocks on either side
+    auto next = freeByOffset.find(offset + size);
+    if (next != freeByOffset.end()) {
+      size_t nextSize = next->second;
+      removeFree(next->first, nextSize);
+      size += nextSize;
+    }
+    auto previous = freeByOffset.lower_bound(offset);
+    if (previous != freeByOffset.begin()) {
+      --previous;
+      if (previous->first + previous->second == offset) {
+        offset = previous->first;
+        size += previous->second;
+        removeFree(previous->first, previous->second);
+      }
+    }
+    addFree(offset, size);
+  }
+
+  void* reallocate(void* ptr, size_t size) {
+    if (ptr == nullptr) {
+      return allocate(size);
+    }
+    size_t oldSize = allocatedSize(ptr);
+    void* newPtr = allocate(size);
+    if (newPtr != nullptr) {
+      memcpy(newPtr, ptr, oldSize < size ? oldSize : size);
+      deallocate(ptr);
+    }
+    return newPtr;
+  }
+
+  size_t allocatedSize(void* ptr) const { return used.at(static_cast<uint8_t*>(ptr) - memory.data()); }
+  size_t largestFree() const { return freeBySize.empty() ? 0 : freeBySize.rbegin()->first; }
+  size_t freeBlocks() const { return freeByOffset.size(); }
+  size_t totalFree() const { return freeBytes; }
+
+private:
+  void addFree(size_t offset, size_t size) {
+    freeByOffset[offset] = size;
+    freeBySize.insert(std::make_pair(size, offset));
+  }
+
+  void removeFree(size_t offset, size_t size) {
+    freeByOffset.erase(offset);
+    freeBySize.erase(std::make_pair(size, offset));
+  }
+
+  std::vector<uint8_t> memory;
+  std::map<size_t, size_t> freeByOffset;
+  std::set<std::pair<size_t, size_t>> freeBySize;
+  std::map<size_t, size_t> used;
+  size_t freeBytes = HEAP_SIZE;
+};
+
+static SimHeap* heap = nullptr;
+
+void* MemoryPools::allocate(MemoryPool, size_t size, bool* fellBack) {
+  if (fellBack != nullptr) {
+    *fellBack = false;
+  }
+  return heap->allocate(size);
+}
+
+void* MemoryPools::reallocate(MemoryPool, void* ptr, size_t newSize, bool* fellBack) {
+  if (fellBack != nullptr) {
+    *fellBack = false;
+  }
+  return heap->reallocate(ptr, newSize);
+}
+
+void MemoryPools::deallocate(MemoryPool, void* ptr) {
+  if (ptr != nullptr) {
+    heap->deallocate(ptr);
+  }
+}
+
+size_t heap_caps_get_allocated_size(void* ptr) {
+  return heap->allocatedSize(ptr);
+}
+
+static uint32_t randomState = 12345;
+
+static int randomBetween(int low, int high) {
+  randomState = randomState * 1103515245u + 12345u;
+  return low + (int)((randomState >> 16) % (uint32_t)(high - low + 1));
+}
+
+// Where the cycle's memory comes from: the arena, or the heap when arena is null
+struct CycleMemory {
+  CycleArena* arena;
+
+  void* allocate(size_t size) { return arena != nullptr ? arena->allocate(size) : heap->allocate(size); }
+  void* reallocate(void* ptr, size_t size) {
+    return arena != nullptr ? arena->reallocate(ptr, size) : heap->reallocate(ptr, size);
+  }
+  void deallocate(void* ptr) {
+    if (arena != nullptr) {
+      arena->deallocate(ptr);
+    } else {
+      heap->deallocate(ptr);
+    }
+  }
+};
+
+// Allocations other tasks make while a cycle runs, freed on a later cycle
+struct OtherAllocation {
+  void* ptr;
+  uint32_t freeCycle;
+};
+
+struct Day {
+  uint32_t pollSeconds;
+  std::vector<OtherAllocation> others;
+
+  // Trains running on a route at the given time of day, from the headways and run times of each line
+  int trainsOnRoute(int route, uint32_t second) const {
+    int hour = (int)(second / 3600);
+    if (hour >= 1 && hour < 5) {
+      return 0;
+    }
+    int headway = (hour >= 6 && hour < 9) || (hour >= 15 && hour < 19) ? 8 : hour >= 9 && hour < 15 ? 10 : 15;
+    int runMinutes = route == 0 ? 90 : 45;
+    return 2 * ((runMinutes + headway - 1) / headway);
+  }
+
+  void otherTaskAllocates(uint32_t cycle, int minSize, int maxSize, uint32_t lifetimeCycles) {
+    void* ptr = heap->allocate((size_t)randomBetween(minSize, maxSize));
+    if (ptr != nullptr) {
+      others.push_back({ptr, cycle + lifetimeCycles});
+    }
+  }
+
+  void freeOthers(uint32_t cycle) {
+    for (size_t i = 0; i < others.size();) {
+      if (others[i].freeCycle <= cycle) {
+        heap->deallocate(others[i].ptr);
+        others[i] = others.back();
+        others.pop_back();
+      } else {
+        i++;
+      }
+    }
+  }
+
+  // A string read by ArduinoJson: 31 bytes to start, doubled as it grows, then shrunk to fit
+  static void* readString(CycleMemory& memory, size_t length) {
+    size_t capacity = 31;
+    void* ptr = memory.allocate(capacity);
+    while (capacity < length + 1) {
+      capacity = capacity * 2 + 1;
+      ptr = memory.reallocate(ptr, capacity);
+    }
+    return memory.reallocate(ptr, length + 1);
+  }
+
+  void runCycle(CycleMemory& memory, uint32_t cycle) {
+    uint32_t second = cycle * pollSeconds;
+    uint32_t tripCycles = 90 * 60 / pollSeconds;
+    std::vector<void*> staged;
+    void* stagingList = nullptr;
+
+    for (int route = 0; route < ROUTE_COUNT; route++) {
+      int trains = trainsOnRoute(route, second);
+      std::vector<void*> strings;
+      std::vector<void*> pools;
+      size_t poolListCapacity = 4;
+      void* poolList = memory.allocate(poolListCapacity * sizeof(void*));
+      size_t slotsLeft = 0;
+
+      for (int train = 0; train < trains; train++) {
+        if (slotsLeft < JSON_SLOTS_PER_TRAIN) {
+          if (pools.size() == poolListCapacity) {
+            poolListCapacity *= 2;
+            poolList = memory.reallocate(poolList, poolListCapacity * sizeof(void*));
+          }
+          pools.push_back(memory.allocate(JSON_POOL_BYTES));
+          slotsLeft = JSON_POOL_BYTES / 8;
+        }
+        slotsLeft -= JSON_SLOTS_PER_TRAIN;
+        for (int i = 0; i < JSON_STRINGS_PER_TRAIN; i++) {
+          strings.push_back(readString(memory, (size_t)randomBetween(4, 48)));
+        }
+
+        // The web task answers a request now and then while the poll is being parsed
+        if (randomBetween(0, 9) == 0) {
+          otherTaskAllocates(cycle, 256, 8192, (uint32_t)randomBetween(1, 2));
+        }
+      }
+
+      // New trips are cached while the response is parsed and kept until they finish
+      if (trains > 0 && randomBetween(0, 3) == 0) {
+        otherTaskAllocates(cycle, 16, 48, tripCycles);
+        otherTaskAllocates(cycle, 16, 48, tripCycles);
+      }
+
+      if (stagingList == nullptr) {
+        stagingList = memory.allocate(STAGED_TRAIN_BYTES * VEHICLE_TABLE_SIZE);
+      }
+      for (int train = 0; train < trains * STAGED_STRINGS_PER_TRAIN; train++) {
+        staged.push_back(memory.allocate((size_t)randomBetween(4, 40)));
+      }
+
+      // The document goes out of scope once its trains are staged
+      for (void* ptr : strings) {
+        memory.deallocate(ptr);
+      }
+      for (void* ptr : pools) {
+        memory.deallocate(ptr);
+      }
+      memory.deallocate(poolList);
+    }
+
+    // Merged into the vehicle table, then the staged trains are dropped
+    for (void* ptr : staged) {
+      memory.deallocate(ptr);
+    }
+    memory.deallocate(stagingList);
+    if (memory.arena != nullptr) {
+      memory.arena->reset();
+    }
+    freeOthers(cycle);
+  }
+};
+
+struct ReplayResult {
+  size_t largestAfterFirstHour = 0;
+  size_t largestAtEnd = 0;
+  size_t freeBlocksAtEnd = 0;
+  double worstFragmentation = 0;  // Largest share of the free memory not in the largest free block
+  uint32_t overflows = 0;
+  size_t arenaPeak = 0;
+};
+
+static ReplayResult replay(bool useArena, uint32_t hours, uint32_t pollSeconds) {
+  SimHeap simHeap;
+  heap = &simHeap;
+  randomState = 12345;
+  CycleArena arena(CYCLE_ARENA_SIZE);
+  CycleMemory memory = {useArena ? &arena : nullptr};
+  Day day;
+  day.pollSeconds = pollSeconds;
+
+  ReplayResult result;
+  uint32_t cycles = hours * 3600 / pollSeconds;
+  uint32_t firstHour = 3600 / pollSeconds;
+  for (uint32_t cycle = 0; cycle < cycles; cycle++) {
+    day.runCycle(memory, cycle);
+    if (cycle == firstHour) {
+      result.largestAfterFirstHour = simHeap.largestFree();
+    }
+    double fragmentation = 1.0 - (double)simHeap.largestFree() / simHeap.totalFree();
+    if (cycle >= firstHour && fragmentation > result.worstFragmentation) {
+      result.worstFragmentation = fragmentation;
+    }
+  }
+  result.largestAtEnd = simHeap.largestFree();
+  result.freeBlocksAtEnd = simHeap.freeBlocks();
+  result.overflows = arena.getOverflowCount();
+  result.arenaPeak = arena.getHighWater();
+  heap = nullptr;
+  return result;
+}
+
+static void printResult(const char* name, const ReplayResult& result) {
+  printf("%-9s largest free block %7u after the first hour, %7u at the end (%3u free blocks), "
+         "worst fragmentation %4.1f%%\n", name, (unsigned)result.largestAfterFirstHour, (unsigned)result.largestAtEnd,
+         (unsigned)result.freeBlocksAtEnd, result.worstFragmentation * 100);
+}
+
+int main(int argc, char** argv) {
+  uint32_t hours = argc > 1 ? (uint32_t)atoi(argv[1]) : 24;
+  uint32_t pollSeconds = argc > 2 ? (uint32_t)atoi(argv[2]) : DEFAULT_UPDATE_INTERVAL;
+  if (hours < 2 || pollSeconds < MIN_POLL_INTERVAL) {
+    fprintf(stderr, "Usage: %s [hours >= 2] [pollSeconds >= %d]\n", argv[0], MIN_POLL_INTERVAL);
+    return 1;
+  }
+
+  printf("Replaying %u hours of polls every %u s against a %u KB heap\n", hours, pollSeconds,
+         (unsigned)(HEAP_SIZE / 1024));
+  ReplayResult withArena = replay(true, hours, pollSeconds);
+  ReplayResult withoutArena = replay(false, hours, pollSeconds);
+  printResult("Arena", withArena);
+  printResult("Heap only", withoutArena);
+  printf("Arena peak %u of %u bytes, %u overflows into the heap\n", (unsigned)withArena.arenaPeak,
+         (unsigned)CYCLE_ARENA_SIZE, withArena.overflows);
+
+  bool failed = withArena.largestAtEnd < withArena.largestAfterFirstHour / 100 * 95 || withArena.overflows > 0 ||
+                withArena.worstFragmentation > withoutArena.worstFragmentation;
+  printf("%s\n", failed ? "Arena replay check failed" : "Arena replay check passed");
+  return failed ? 1 : 0;
+}
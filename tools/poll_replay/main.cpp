@@ -0,0 +1,241 @@
+// Host replay of a simulated service day through the poll scheduler, built by the poll_replay PlatformIO
+// environment:
+//
+//   pio run -e poll_replay && .pio/build/poll_replay/program [updateInterval] [dailyBudget] [feedPeriod]
+//
+// Builds a day of Line 1 and Line 2 trips in both directions (service from 05:00 to about 01:00, shorter
+// headways at the peaks), and an upstream feed that refreshes every feedPeriod seconds (20 by default) with
+// each train's position as of that refresh. Each scheduler then polls it through the day: a fixed
+// updateInterval, as the firmware did before the adaptive scheduler, and PollPolicy with and without the
+// daily budget. Every second the LED each train would be shown on from the last poll is compared with the
+// LED it should be on, using the same at-station threshold as the firmware and no dead reckoning.
+//
+// Prints, for each scheduler, the API calls made, the share of train-seconds shown on the right LED and the
+// mean age of the data on display while trains are running. Exits with 1 if the adaptive scheduler went over
+// the budget or made more calls than the fixed interval without showing the trains more accurately.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "PollPolicy.h"
+#include "config.h"
+
+static const uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+static const int DWELL_SECONDS = PREDICTED_DWELL_SECONDS;
+static const int ROUTE_COUNT = 2;  // One trips-for-route request per line each poll
+
+// Station counts as on the real lines, with a fixed but uneven run time between each pair of stations
+struct SimLine {
+  int stations;
+  std::vector<int> runSeconds;
+};
+
+// One trip from the first station to the last, with its arrival time at each (seconds since midnight)
+struct SimTrip {
+  int line;
+  int direction;
+  std::vector<uint32_t> arrivals;
+
+  uint32_t start() const { return arrivals.front(); }
+  uint32_t end() const { return arrivals.back() + DWELL_SECONDS; }
+
+  // The LED the firmware would show the trip on at time t, -1 if it isn't running. secondsToArrival is set to
+  // the seconds until the train crosses the at-station threshold, or -1 if it's already at a station.
+  int led(uint32_t t, int* secondsToArrival = nullptr) const {
+    if (t < start() || t >= end()) {
+      return -1;
+    }
+    size_t next = 1;
+    while (next < arrivals.size() && arrivals[next] <= t) {
+      next++;
+    }
+    int station = (int)next - 1;
+    bool atStation = t < arrivals[station] + DWELL_SECONDS || next == arrivals.size();
+    if (!atStation) {
+      int offset = (int)(arrivals[next] - t);
+      if (offset < AT_STATION_THRESHOLD) {
+        station = (int)next;
+        atStation = true;
+      } else {
+        station = (int)next;
+        if (secondsToArrival != nullptr) {
+          *secondsToArrival = offset - AT_STATION_THRESHOLD;
+        }
+      }
+    }
+    if (atStation && secondsToArrival != nullptr) {
+      *secondsToArrival = -1;
+    }
+    return ((line * 2 + direction) * 64 + station) * 2 + (atStation ? 1 : 0);
+  }
+};
+
+static uint32_t randomState = 12345;
+
+static int randomBetween(int low, int high) {
+  randomState = randomState * 1103515245u + 12345u;
+  return low + (int)((randomState >> 16) % (uint32_t)(high - low + 1));
+}
+
+// Minutes between departures at the given hour of the day
+static int headwayMinutes(int hour) {
+  if ((hour >= 6 && hour < 9) || (hour >= 15 && hour < 19)) {
+    return 8;
+  }
+  return hour >= 9 && hour < 15 ? 10 : 15;
+}
+
+static std::vector<SimTrip> buildDay() {
+  SimLine lines[2] = {{25, {}}, {10, {}}};
+  for (SimLine& line : lines) {
+    for (int i = 0; i < line.stations - 1; i++) {
+      line.runSeconds.push_back(randomBetween(80, 240));
+    }
+  }
+
+  std::vector<SimTrip> trips;
+  for (int l = 0; l < 2; l++) {
+    for (int direction = 0; direction < 2; direction++) {
+      for (uint32_t departure = 5 * 3600; departure < 24 * 3600 + 30 * 60;
+           departure += headwayMinutes((departure / 3600) % 24) * 60) {
+        SimTrip trip;
+        trip.line = l;
+        trip.direction = direction;
+        uint32_t t = departure;
+        trip.arrivals.push_back(t);
+        for (int i = 0; i < lines[l].stations - 1; i++) {
+          int segment = direction == 0 ? i : lines[l].stations - 2 - i;
+          // Trains run a little early or late against the timetable
+          t += DWELL_SECONDS + lines[l].runSeconds[segment] + randomBetween(-20, 20);
+          trip.arrivals.push_back(t);
+        }
+        // Trips running past midnight are left out, the replay covers a single day
+        if (trip.end() < SECONDS_PER_DAY) {
+          trips.push_back(trip);
+        }
+      }
+    }
+  }
+  return trips;
+}
+
+// A feed refresh as the firmware would receive it: the trains running and where they were at that time
+struct FeedView {
+  uint32_t refreshMs;
+  size_t trainCount = 0;
+  int soonestArrivalSeconds = -1;
+};
+
+struct ReplayResult {
+  unsigned int apiCalls = 0;
+  uint64_t trainSeconds = 0;
+  uint64_t correctTrainSeconds = 0;
+  uint64_t ageSum = 0;
+  uint64_t ageSamples = 0;
+};
+
+// Replays the day through PollPolicy, or through a fixed interval when adaptive is false
+static ReplayResult replay(const std::vector<SimTrip>& trips, bool adaptive, uint32_t updateInterval,
+                           unsigned int dailyBudget, uint32_t feedPeriodMs, uint32_t feedPhaseMs) {
+  PollPolicy policy;
+  policy.startDay();
+  ReplayResult result;
+  std::vector<int> shown(trips.size(), -1);
+  uint32_t shownRefreshMs = 0;
+  bool anyShown = false;
+  uint32_t nextPollMs = 0;
+
+  for (uint32_t second = 0; second < SECONDS_PER_DAY; second++) {
+    while (nextPollMs <= second * 1000) {
+      uint32_t pollMs = nextPollMs;
+      uint32_t refreshMs = pollMs < feedPhaseMs ? 0 : feedPhaseMs + (pollMs - feedPhaseMs) / feedPeriodMs * feedPeriodMs;
+      FeedView view;
+      view.refreshMs = refreshMs;
+      for (size_t i = 0; i < trips.size(); i++) {
+        int secondsToArrival = -1;
+        shown[i] = trips[i].led(refreshMs / 1000, &secondsToArrival);
+        if (shown[i] >= 0) {
+          view.trainCount++;
+          if (secondsToArrival >= 0 && (view.soonestArrivalSeconds < 0 || secondsToArrival < view.soonestArrivalSeconds)) {
+            view.soonestArrivalSeconds = secondsToArrival;
+          }
+        }
+      }
+      shownRefreshMs = refreshMs;
+      anyShown = true;
+      result.apiCalls += ROUTE_COUNT;
+
+      uint32_t delayMs;
+      if (adaptive) {
+        PollSnapshot snapshot;
+        snapshot.trainCount = view.trainCount;
+        snapshot.soonestArrivalSeconds = view.soonestArrivalSeconds;
+        snapshot.apiCalls = ROUTE_COUNT;
+        snapshot.feedRefreshKnown = view.trainCount > 0;
+        snapshot.feedRefreshMillis = refreshMs;
+        PollLimits limits;
+        limits.baseIntervalSeconds = updateInterval;
+        limits.dailyApiBudget = dailyBudget;
+        limits.secondsLeftInDay = SECONDS_PER_DAY - pollMs / 1000;
+        delayMs = policy.nextDelayMs(snapshot, limits, pollMs);
+      } else {
+        delayMs = updateInterval * 1000;
+      }
+      nextPollMs = pollMs + delayMs;
+    }
+
+    bool running = false;
+    for (size_t i = 0; i < trips.size(); i++) {
+      int actual = trips[i].led(second);
+      if (actual < 0 && shown[i] < 0) {
+        continue;
+      }
+      running = true;
+      result.trainSeconds++;
+      if (actual == shown[i]) {
+        result.correctTrainSeconds++;
+      }
+    }
+    if (running && anyShown) {
+      result.ageSum += second - shownRefreshMs / 1000;
+      result.ageSamples++;
+    }
+  }
+  return result;
+}
+
+static void printResult(const char* name, const ReplayResult& result) {
+  printf("%-28s %6u API calls, %5.1f%% of train-seconds on the right LED, mean data age %4.1f s\n", name,
+         result.apiCalls, 100.0 * result.correctTrainSeconds / result.trainSeconds,
+         result.ageSamples > 0 ? (double)result.ageSum / result.ageSamples : 0.0);
+}
+
+int main(int argc, char** argv) {
+  uint32_t updateInterval = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_UPDATE_INTERVAL;
+  unsigned int dailyBudget = argc > 2 ? (unsigned int)atoi(argv[2]) : DEFAULT_DAILY_API_BUDGET;
+  uint32_t feedPeriod = argc > 3 ? (uint32_t)atoi(argv[3]) : 20;
+  if (updateInterval < MIN_POLL_INTERVAL || feedPeriod * 1000 < FEED_MIN_PERIOD || feedPeriod * 1000 > FEED_MAX_PERIOD) {
+    fprintf(stderr, "Usage: %s [updateInterval >= %d] [dailyBudget] [feedPeriod %d-%d]\n", argv[0], MIN_POLL_INTERVAL,
+            FEED_MIN_PERIOD / 1000, FEED_MAX_PERIOD / 1000);
+    return 1;
+  }
+
+  std::vector<SimTrip> trips = buildDay();
+  uint32_t feedPhaseMs = 7300;  // Not a whole number of seconds, so polls don't line up with refreshes by chance
+  printf("Simulated day: %zu trips, feed refreshed every %u s, update interval %u s, budget %u calls\n",
+         trips.size(), feedPeriod, updateInterval, dailyBudget);
+
+  ReplayResult fixed = replay(trips, false, updateInterval, 0, feedPeriod * 1000, feedPhaseMs);
+  ReplayResult unlimited = replay(trips, true, updateInterval, 0, feedPeriod * 1000, feedPhaseMs);
+  ReplayResult budgeted = replay(trips, true, updateInterval, dailyBudget, feedPeriod * 1000, feedPhaseMs);
+  printResult("Fixed interval", fixed);
+  printResult("Adaptive, no budget", unlimited);
+  printResult("Adaptive, daily budget", budgeted);
+
+  double fixedAccuracy = (double)fixed.correctTrainSeconds / fixed.trainSeconds;
+  double budgetedAccuracy = (double)budgeted.correctTrainSeconds / budgeted.trainSeconds;
+  bool failed = (dailyBudget > 0 && budgeted.apiCalls > dailyBudget + ROUTE_COUNT) ||
+                (budgeted.apiCalls > fixed.apiCalls && budgetedAccuracy <= fixedAccuracy);
+  printf("%s\n", failed ? "Replay check failed" : "Replay check passed");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+// Host listener for the frame stream, built by the stream_listener PlatformIO environment:
+//
+//   pio run -e stream_listener && .pio/build/stream_listener/program <ddp|e131> [ledCount] [seconds] [maxFps]
+//
+// Listens on the protocol's port for the given number of seconds, checks every packet header against
+// StreamProtocol.h, puts the frames back together and checks each is ledCount pixels, that no frames were
+// lost and that they didn't arrive faster than maxFps on average. Point the device's stream targets at this
+// computer to run it. Prints the frames, keepalives (frames identical to the one before) and a checksum of
+// the last frame, and exits with 1 if anything was wrong or no frames arrived.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "config.h"
+#include "StreamProtocol.h"
+
+static uint16_t readBigEndian16(const uint8_t* in) {
+  return (uint16_t)((in[0] << 8) | in[1]);
+}
+
+static uint32_t readBigEndian32(const uint8_t* in) {
+  return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+struct StreamCheck {
+  size_t frameBytes = 0;
+  std::vector<uint8_t> frame;      // Being put back together
+  std::vector<uint8_t> lastFrame;  // Last complete frame
+  size_t received = 0;             // Bytes of the current frame so far
+  uint32_t frames = 0;
+  uint32_t keepalives = 0;
+  uint32_t lostFrames = 0;
+  uint32_t errors = 0;
+  int lastSequence = -1;
+  std::chrono::steady_clock::time_point firstFrame;
+  std::chrono::steady_clock::time_point lastFrameTime;
+
+  void error(const char* message) {
+    if (errors < 10) {
+      fprintf(stderr, "%s\n", message);
+    }
+    errors++;
+  }
+
+  // Sequences count 1-15 for DDP and 0-255 for E1.31, so a jump of more than one is a lost frame
+  void checkSequence(int sequence, int modulo, int first) {
+    if (lastSequence >= 0) {
+      int expected = lastSequence + 1 >= first + modulo ? first : lastSequence + 1;
+      if (sequence != expected) {
+        lostFrames += (uint32_t)((sequence - expected + modulo) % modulo);
+      }
+    }
+    lastSequence = sequence;
+  }
+
+  void frameComplete() {
+    if (received != frameBytes) {
+      char message[96];
+      snprintf(message, sizeof(message), "Frame %u had %zu bytes, expected %zu", frames, received, frameBytes);
+      error(message);
+    } else {
+      if (frames > 0 && frame == lastFrame) {
+        keepalives++;
+      }
+      lastFrame = frame;
+    }
+    lastFrameTime = std::chrono::steady_clock::now();
+    if (frames == 0) {
+      firstFrame = lastFrameTime;
+    }
+    frames++;
+    received = 0;
+  }
+
+  void ddpPacket(const uint8_t* packet, size_t length) {
+    if (length < DDP_HEADER_SIZE || (packet[0] & 0xC0) != DDP_FLAGS_VERSION1 || packet[2] != DDP_TYPE_RGB24) {
+      error("Malformed DDP header");
+      return;
+    }
+    uint32_t offset = readBigEndian32(packet + 4);
+    uint16_t dataLength = readBigEndian16(packet + 8);
+    if (dataLength != length - DDP_HEADER_SIZE || dataLength > DDP_MAX_DATA || offset != received ||
+        offset + dataLength > frameBytes) {
+      error("DDP packet out of place or the wrong length");
+      received = 0;
+      return;
+    }
+    memcpy(frame.data() + offset, packet + DDP_HEADER_SIZE, dataLength);
+    received += dataLength;
+    if (packet[0] & DDP_FLAGS_PUSH) {
+      checkSequence(packet[1] & 0x0F, 15, 1);
+      frameComplete();
+    }
+  }
+
+  void e131Packet(const uint8_t* packet, size_t length) {
+    static const uint8_t ACN_PACKET_IDENTIFIER[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+    if (length < E131_HEADER_SIZE || memcmp(packet + 4, ACN_PACKET_IDENTIFIER, sizeof(ACN_PACKET_IDENTIFIER)) != 0 ||
+        readBigEndian32(packet + 18) != 0x00000004 || readBigEndian32(packet + 40) != 0x00000002 ||
+        packet[117] != 0x02 || packet[125] != 0) {
+      error("Malformed E1.31 header");
+      return;
+    }
+    size_t slots = readBigEndian16(packet + 123) - 1;
+    size_t universeBytes = E131_UNIVERSE_PIXELS * 3;
+    size_t offset = (size_t)(readBigEndian16(packet + 113) - STREAM_E131_UNIVERSE) * universeBytes;
+    if (slots != length - E131_HEADER_SIZE || readBigEndian16(packet + 38) != (0x7000 | (length - 38)) ||
+        offset != received || offset + slots > frameBytes) {
+      error("E1.31 packet out of place or the wrong length");
+      received = 0;
+      return;
+    }
+    memcpy(frame.data() + offset, packet + E131_HEADER_SIZE, slots);
+    received += slots;
+    // A frame ends with its last universe, whose sequence stands for the frame
+    if (received == frameBytes) {
+      checkSequence(packet[111], 256, 0);
+      frameComplete();
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  bool ddp = argc > 1 && strcmp(argv[1], STREAM_PROTOCOL_DDP) == 0;
+  if (argc < 2 || (!ddp && strcmp(argv[1], STREAM_PROTOCOL_E131) != 0)) {
+    fprintf(stderr, "Usage: %s <ddp|e131> [ledCount] [seconds] [maxFps]\n", argv[0]);
+    return 1;
+  }
+  int ledCount = argc > 2 ? atoi(argv[2]) : DEFAULT_LED_COUNT;
+  int seconds = argc > 3 ? atoi(argv[3]) : 10;
+  int maxFps = argc > 4 ? atoi(argv[4]) : DEFAULT_STREAM_RATE;
+  if (ledCount < 1 || ledCount > MAX_LED_COUNT || seconds < 1 || maxFps < 1) {
+    fprintf(stderr, "ledCount must be 1-%d, seconds and maxFps at least 1\n", MAX_LED_COUNT);
+    return 1;
+  }
+
+  int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(ddp ? DDP_PORT : E131_PORT);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (sock < 0 || bind(sock, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    perror("Can't listen");
+    return 1;
+  }
+  printf("Listening for %s on port %u for %d seconds\n", argv[1], ntohs(address.sin_port), seconds);
+
+  StreamCheck check;
+  check.frameBytes = (size_t)ledCount * 3;
+  check.frame.resize(check.frameBytes);
+  uint32_t packets = 0;
+  uint8_t packet[2048];
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(sock, &readable);
+    struct timeval timeout = {0, 100000};
+    if (select(sock + 1, &readable, nullptr, nullptr, &timeout) <= 0) {
+      continue;
+    }
+    ssize_t length = recv(sock, packet, sizeof(packet), 0);
+    if (length <= 0) {
+      continue;
+    }
+    packets++;
+    if (ddp) {
+      check.ddpPacket(packet, (size_t)length);
+    } else {
+      check.e131Packet(packet, (size_t)length);
+    }
+  }
+  close(sock);
+
+  double span = std::chrono::duration<double>(check.lastFrameTime - check.firstFrame).count();
+  double fps = check.frames > 1 && span > 0 ? (check.frames - 1) / span : 0;
+  uint32_t checksum = 2166136261u;
+  for (uint8_t byte : check.lastFrame) {
+    checksum = (checksum ^ byte) * 16777619u;
+  }
+  printf("Packets: %u, frames: %u (%u keepalives), lost frames: %u, errors: %u\n",
+         packets, check.frames, check.keepalives, check.lostFrames, check.errors);
+  printf("Average rate: %.1f fps, last frame checksum: %08x\n", fps, checksum);
+
+  // A little over maxFps allows for packets bunching up on the network
+  bool failed = check.frames == 0 || check.errors > 0 || check.lostFrames > 0 || fps > maxFps * 1.1;
+  printf("%s\n", failed ? "Stream check failed" : "Stream check passed");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+// Host check and profiler for the LED frame pipeline, built by the native PlatformIO environment:
+//
+//   pio run -e native && .pio/build/native/program frames.rgb [seconds] [fps] [brightness]
+//
+// Simulates trains stepping along the strip and runs every frame through the same FramePipeline as the
+// firmware, with RecordingPixelOutput writing the frames to a file as raw RGB (STRIP_LENGTH * 3 bytes per
+// frame) in place of the strip. Prints how long each frame took, then lets the last target settle and checks
+// the output shows exactly the corrected target. Exits with 1 if it doesn't.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "FramePipeline.h"
+#include "RecordingPixelOutput.h"
+
+static const int STRIP_LENGTH = 160;  // As in data/layout.json
+static const int TRAIN_COUNT = 12;
+static const uint32_t STEP_INTERVAL_MS = 2000;  // Much faster than real trains, to keep the engine busy
+
+// Running totals of frame times
+struct FrameTiming {
+  double totalMicros = 0;
+  double maxMicros = 0;
+
+  void add(std::chrono::steady_clock::time_point start) {
+    double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    totalMicros += micros;
+    if (micros > maxMicros) {
+      maxMicros = micros;
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <output.rgb> [seconds] [fps] [brightness 0-255]\n", argv[0]);
+    return 1;
+  }
+  uint32_t seconds = argc > 2 ? (uint32_t)atoi(argv[2]) : 60;
+  uint32_t fps = argc > 3 ? (uint32_t)atoi(argv[3]) : 60;
+  int brightness = argc > 4 ? atoi(argv[4]) : 255;
+  if (seconds == 0 || fps == 0) {
+    fprintf(stderr, "seconds and fps must be positive\n");
+    return 1;
+  }
+
+  FILE* output = fopen(argv[1], "wb");
+  if (output == nullptr) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  uint8_t level = (uint8_t)(brightness < 0 ? 0 : brightness > 255 ? 255 : brightness);
+  FramePipeline<RecordingPixelOutput> pipeline(1, output);
+  pipeline.begin(STRIP_LENGTH);
+  pipeline.setBrightness(level);
+  LEDFrame target;
+  int positions[TRAIN_COUNT];
+  for (int i = 0; i < TRAIN_COUNT; i++) {
+    positions[i] = i * STRIP_LENGTH / TRAIN_COUNT;
+  }
+
+  uint32_t frameMs = 1000 / fps;
+  uint32_t frameCount = seconds * fps;
+  uint32_t sinceStepMs = STEP_INTERVAL_MS;
+  FrameTiming timing;
+
+  for (uint32_t n = 0; n < frameCount; n++) {
+    if (sinceStepMs >= STEP_INTERVAL_MS) {
+      sinceStepMs = 0;
+      target.fill(RgbColor(0, 0, 0));
+      for (int i = 0; i < TRAIN_COUNT; i++) {
+        positions[i] = (positions[i] + 1) % STRIP_LENGTH;
+        target.pixels[positions[i]] = i % 2 == 0 ? RgbColor(0x28, 0x81, 0x3F) : RgbColor(0x00, 0x7C, 0xAD);
+      }
+      // Every other LED is a station, as on the real strip
+      for (int i = 0; i < STRIP_LENGTH; i++) {
+        target.flags[i] = i % 2 == 1 ? LED_FLAG_STATION : 0;
+      }
+      pipeline.setTarget(target);
+    }
+    sinceStepMs += frameMs;
+
+    // Every frame is shown, so the file has one per tick
+    auto start = std::chrono::steady_clock::now();
+    pipeline.render(frameMs, true);
+    timing.add(start);
+  }
+
+  // Once the transitions finish, the output should be the target through the correction tables
+  while (pipeline.isAnimating()) {
+    pipeline.render(frameMs, true);
+  }
+  fclose(output);
+
+  ColorCorrection reference;
+  reference.setBrightness(level);
+  const RecordingPixelOutput& recorded = pipeline.getOutput();
+  int mismatches = 0;
+  for (int i = 0; i < STRIP_LENGTH; i++) {
+    if (recorded.getPixel(i) != reference.apply(target.pixels[i])) {
+      mismatches++;
+    }
+  }
+
+  printf("%u frames of %d LEDs at %u fps written to %s\n", recorded.getShowCount(), STRIP_LENGTH, fps, argv[1]);
+  printf("Frame time: mean %.2f us, max %.2f us\n", timing.totalMicros / frameCount, timing.maxMicros);
+  if (mismatches > 0) {
+    printf("Settled frame: %d LEDs differ from the target\n", mismatches);
+    return 1;
+  }
+  printf("Settled frame: matches the target\n");
+  return 0;
+}